@@ -0,0 +1,41 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 out_tex_coord;
+smooth in float out_tex_coord_affine;
+flat in float out_fade;
+in float out_fog_distance;
+
+uniform sampler2D our_texture;
+
+// Same fog as test.frag
+uniform vec3 fog_color;
+uniform float fog_start;
+uniform float fog_end;
+
+vec4 apply_fog(vec4 color)
+{
+    float fog = clamp((out_fog_distance - fog_start) / max(fog_end - fog_start, 0.001), 0.0, 1.0);
+    return vec4(mix(color.rgb, fog_color, fog), color.a);
+}
+
+// Screen space noise in [0, 1). During the crossfade a tree keeps the pixels below its
+// fade and its impostor the ones above, so together they cover every pixel once.
+float dither()
+{
+    return fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+}
+
+void main()
+{
+    if (dither() >= out_fade) discard;
+
+    vec2 affine_tex_coords = out_tex_coord / out_tex_coord_affine;
+    vec4 color = texture(our_texture, affine_tex_coords);
+
+    // Leaves are cut out, so they don't hide what's behind them through the depth buffer
+    if (color.a < 0.5) discard;
+
+    FragColor = apply_fog(color);
+}
\ No newline at end of file
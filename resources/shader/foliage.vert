@@ -0,0 +1,60 @@
+#version 330 core
+
+layout (location = 0) in vec3 a_pos;
+layout (location = 1) in vec2 a_normal;
+layout (location = 2) in vec2 a_tex_coord;
+layout (location = 3) in vec4 a_instance_position_yaw;
+layout (location = 4) in vec2 a_instance_scale_rank;
+
+out vec2 out_tex_coord;
+smooth out float out_tex_coord_affine;
+out float out_fog_distance;
+flat out float out_fade;
+
+uniform vec2 screen_size;
+uniform mat4 model_view;
+uniform mat4 projection;
+
+// Trees fade out between these view distances while their impostors fade in
+uniform float impostor_start;
+uniform float impostor_end;
+
+void main()
+{
+    vec2 res = vec2(screen_size.x / 10, screen_size.y / 10); // Resolution used for vertex wobble
+
+    float instance_distance = length((model_view * vec4(a_instance_position_yaw.xyz, 1.0)).xyz);
+    out_fade = clamp((impostor_end - instance_distance) / max(impostor_end - impostor_start, 0.001), 0.0, 1.0);
+
+    // Entirely replaced by the impostor, move it behind the far plane
+    if (out_fade == 0.0)
+    {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+
+    // Place the instance, rotating around y the same way glm::rotate does
+    float c = cos(a_instance_position_yaw.w);
+    float s = sin(a_instance_position_yaw.w);
+    vec3 scaled = a_pos * a_instance_scale_rank.x;
+    vec3 placed = vec3(c * scaled.x + s * scaled.z, scaled.y, -s * scaled.x + c * scaled.z) + a_instance_position_yaw.xyz;
+
+    vec4 vertex_view_m = model_view * vec4(placed, 1.0);
+    vec4 vertex_projected = projection * vertex_view_m;
+
+    // Simulating vertex wobble
+    vertex_projected.xyz = vertex_projected.xyz / vertex_projected.w;
+    vertex_projected.xy = floor(res * vertex_projected.xy) / res;
+    vertex_projected.xyz *= vertex_projected.w;
+
+    gl_Position = vertex_projected;
+
+    // Simulating affine mapping
+    float dist = length(vertex_view_m);
+    float affine = dist + ((vertex_projected.w * 8.0) / dist) * 0.5;
+
+    out_tex_coord = a_tex_coord * affine;
+    out_tex_coord_affine = affine;
+
+    out_fog_distance = length(vertex_view_m.xyz);
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 out_tex_coord;
+in vec2 out_next_tex_coord;
+flat in float out_angle_blend;
+flat in float out_fade;
+in float out_fog_distance;
+
+uniform sampler2D our_texture;
+
+// Same fog as test.frag
+uniform vec3 fog_color;
+uniform float fog_start;
+uniform float fog_end;
+
+vec4 apply_fog(vec4 color)
+{
+    float fog = clamp((out_fog_distance - fog_start) / max(fog_end - fog_start, 0.001), 0.0, 1.0);
+    return vec4(mix(color.rgb, fog_color, fog), color.a);
+}
+
+// Same noise as foliage.frag, keeping the pixels the tree mesh drops
+float dither()
+{
+    return fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+}
+
+void main()
+{
+    if (1.0 - dither() >= out_fade) discard;
+
+    vec4 color = mix(texture(our_texture, out_tex_coord), texture(our_texture, out_next_tex_coord), out_angle_blend);
+    if (color.a < 0.5) discard;
+
+    FragColor = apply_fog(color);
+}
\ No newline at end of file
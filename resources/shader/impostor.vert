@@ -0,0 +1,82 @@
+#version 330 core
+
+layout (location = 0) in vec2 a_corner;
+layout (location = 2) in vec2 a_tex_coord;
+layout (location = 3) in vec4 a_instance_position_yaw;
+layout (location = 4) in vec2 a_instance_scale_rank;
+
+// Atlas coordinates in the pictures of the two angles closest to the camera
+out vec2 out_tex_coord;
+out vec2 out_next_tex_coord;
+flat out float out_angle_blend;
+flat out float out_fade;
+out float out_fog_distance;
+
+uniform vec2 screen_size;
+uniform mat4 model_view;
+uniform mat4 view;           // only its rotation is used
+uniform mat4 projection;
+
+uniform float impostor_start;
+uniform float impostor_end;
+uniform float impostor_angles;
+uniform float impostor_padding;
+
+const float TWO_PI = 6.28318530718;
+
+void main()
+{
+    vec2 res = vec2(screen_size.x / 10, screen_size.y / 10); // Resolution used for vertex wobble
+
+    // World space around the camera, which keeps the tree upright without the large
+    // world positions: the camera sits at the origin
+    mat3 view_rotation = mat3(view);
+    vec3 base_view = (model_view * vec4(a_instance_position_yaw.xyz, 1.0)).xyz;
+    vec3 base = transpose(view_rotation) * base_view;
+
+    // Fades in as the tree mesh fades out, see foliage.frag
+    float instance_distance = length(base_view);
+    out_fade = 1.0 - clamp((impostor_end - instance_distance) / max(impostor_end - impostor_start, 0.001), 0.0, 1.0);
+
+    if (out_fade == 0.0)
+    {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+
+    // Only turn around y, so the trees stay upright when looking up or down
+    vec2 to_camera = -base.xz;
+    to_camera = dot(to_camera, to_camera) > 0.0 ? normalize(to_camera) : vec2(0.0, 1.0);
+
+    float scale = a_instance_scale_rank.x;
+    vec3 right = vec3(to_camera.y, 0.0, -to_camera.x);
+    vec3 placed = base + right * a_corner.x * scale + vec3(0.0, a_corner.y * scale, 0.0);
+
+    vec4 vertex_view_m = vec4(view_rotation * placed, 1.0);
+    vec4 vertex_projected = projection * vertex_view_m;
+
+    // Simulating vertex wobble
+    vertex_projected.xyz = vertex_projected.xyz / vertex_projected.w;
+    vertex_projected.xy = floor(res * vertex_projected.xy) / res;
+    vertex_projected.xyz *= vertex_projected.w;
+
+    gl_Position = vertex_projected;
+
+    out_fog_distance = length(vertex_view_m.xyz);
+
+    // Direction to the camera in the tree's own space, undoing the instance's yaw
+    float c = cos(a_instance_position_yaw.w);
+    float s = sin(a_instance_position_yaw.w);
+    vec2 local = vec2(c * to_camera.x - s * to_camera.y, s * to_camera.x + c * to_camera.y);
+
+    // Picture n was baked with the tree turned by n steps, which shows it from this angle
+    float steps = mod(atan(-local.x, local.y) / TWO_PI * impostor_angles, impostor_angles);
+    float tile = floor(steps);
+    float next_tile = mod(tile + 1.0, impostor_angles);
+
+    out_angle_blend = steps - tile;
+
+    vec2 inner = impostor_padding + a_tex_coord * (1.0 - 2.0 * impostor_padding);
+    out_tex_coord = vec2((tile + inner.x) / impostor_angles, inner.y);
+    out_next_tex_coord = vec2((next_tile + inner.x) / impostor_angles, inner.y);
+}
\ No newline at end of file
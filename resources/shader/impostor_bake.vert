@@ -0,0 +1,24 @@
+#version 330 core
+
+layout (location = 0) in vec3 a_pos;
+layout (location = 1) in vec2 a_normal;
+layout (location = 2) in vec2 a_tex_coord;
+
+out vec2 out_tex_coord;
+smooth out float out_tex_coord_affine;
+out float out_fog_distance;
+flat out float out_fade;
+
+uniform mat4 model_view;
+uniform mat4 projection;
+
+// No wobble, affine mapping or fog, the impostor quads add those when they are drawn
+void main()
+{
+    gl_Position = projection * model_view * vec4(a_pos, 1.0);
+
+    out_tex_coord = a_tex_coord;
+    out_tex_coord_affine = 1.0;
+    out_fade = 1.0;
+    out_fog_distance = 0.0;
+}
\ No newline at end of file
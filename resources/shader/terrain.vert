@@ -0,0 +1,72 @@
+#version 330 core
+
+layout (location = 0) in vec2 a_grid;
+layout (location = 3) in vec4 a_node;     // xz origin in the tile, size, subdivision
+layout (location = 4) in vec2 a_morph;    // distances where morphing starts and ends
+
+out vec2 out_tex_coord;
+smooth out float out_tex_coord_affine;
+out float out_fog_distance;
+
+uniform vec2 screen_size;
+uniform mat4 model_view;
+uniform mat4 projection;
+
+uniform sampler2D height_map;
+uniform float tile_size;
+uniform float height_resolution;
+
+uniform float grid_size;
+uniform vec3 camera_position;   // in tile space
+uniform float texture_scale;
+uniform vec2 texture_offset;    // tile origin modulo texture_scale, keeps texture coordinates small
+
+float sample_height(vec2 position)
+{
+    // Texel centres, the first and last texel sit on the tile edges
+    vec2 uv = (position / tile_size * (height_resolution - 1.0) + 0.5) / height_resolution;
+    return texture(height_map, uv).r;
+}
+
+void main()
+{
+    vec2 res = vec2(screen_size.x / 10, screen_size.y / 10); // Resolution used for vertex wobble
+
+    // Vertex index on the grid of the node's level, dropping the extra vertices of
+    // nodes drawn finer than their level
+    float subdivision = a_node.w;
+    float cell = a_node.z / grid_size * subdivision;
+
+    vec2 index = round(a_grid * grid_size);
+    index = (index - mod(index, subdivision)) / subdivision;
+
+    vec2 flat_position = a_node.xy + index * cell;
+    float dist = distance(camera_position, vec3(flat_position.x, sample_height(flat_position), flat_position.y));
+
+    // Towards the end of the level's range the odd vertices slide onto their even
+    // neighbours, which turns the grid into the one of the next coarser level
+    float morph = clamp((dist - a_morph.x) / (a_morph.y - a_morph.x), 0.0, 1.0);
+    index -= mod(index, 2.0) * morph;
+
+    vec2 position = a_node.xy + index * cell;
+    vec4 vertex = vec4(position.x, sample_height(position), position.y, 1.0);
+
+    vec4 vertex_view_m = model_view * vertex;
+    vec4 vertex_projected = projection * vertex_view_m;
+
+    // Simulating vertex wobble
+    vertex_projected.xyz = vertex_projected.xyz / vertex_projected.w;
+    vertex_projected.xy = floor(res * vertex_projected.xy) / res;
+    vertex_projected.xyz *= vertex_projected.w;
+
+    gl_Position = vertex_projected;
+
+    // Simulating affine mapping
+    float dist_view = length(vertex_view_m);
+    float affine = dist_view + ((vertex_projected.w * 8.0) / dist_view) * 0.5;
+
+    out_tex_coord = (position + texture_offset) / texture_scale * affine;
+    out_tex_coord_affine = affine;
+
+    out_fog_distance = length(vertex_view_m.xyz);
+}
\ No newline at end of file
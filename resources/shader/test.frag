@@ -4,12 +4,24 @@ out vec4 FragColor;
 
 in vec2 out_tex_coord;
 smooth in float out_tex_coord_affine;
+in float out_fog_distance;
 
 uniform sampler2D our_texture;
 
+// Linear fog, everything is fog_color from fog_end on
+uniform vec3 fog_color;
+uniform float fog_start;
+uniform float fog_end;
+
+vec4 apply_fog(vec4 color)
+{
+    float fog = clamp((out_fog_distance - fog_start) / max(fog_end - fog_start, 0.001), 0.0, 1.0);
+    return vec4(mix(color.rgb, fog_color, fog), color.a);
+}
+
 void main()
 {
     vec2 affine_tex_coords = out_tex_coord / out_tex_coord_affine;
 
-    FragColor = texture(our_texture, affine_tex_coords);
+    FragColor = apply_fog(texture(our_texture, affine_tex_coords));
 }
\ No newline at end of file
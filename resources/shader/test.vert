@@ -6,17 +6,23 @@ layout (location = 2) in vec2 a_tex_coord;
 
 out vec2 out_tex_coord;
 smooth out float out_tex_coord_affine;
+out float out_fog_distance;
 
 uniform vec2 screen_size;
-uniform mat4 model_transform;
-uniform mat4 view;
+// Per draw, streamed by systems::submit() and bound at DRAW_DATA_BINDING. model_view is
+// multiplied on the CPU in double precision with the camera at the origin, so positions
+// far from the world origin keep their precision. The other shaders' model_view is the same.
+layout (std140) uniform DrawData
+{
+    mat4 model_view;
+};
 uniform mat4 projection;
 
 void main()
 {
     vec2 res = vec2(screen_size.x / 10, screen_size.y / 10); // Resolution used for vertex wobble
 
-    vec4 vertex_view_m = view * model_transform * vec4(a_pos, 1.0);
+    vec4 vertex_view_m = model_view * vec4(a_pos, 1.0);
     vec4 vertex_projected = projection * vertex_view_m;
 
     // Simulating vertex wobble
@@ -32,4 +38,6 @@ void main()
 
     out_tex_coord = a_tex_coord * affine;
     out_tex_coord_affine = affine;
+
+    out_fog_distance = length(vertex_view_m.xyz);
 }
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "asset_loader.hpp"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "image_registry.hpp"
+
+/* #region LoadGroup */
+
+void LoadGroup::cancel()
+{
+    cancelled = true;
+}
+
+bool LoadGroup::is_cancelled() const
+{
+    return cancelled.load();
+}
+
+bool LoadGroup::is_done() const
+{
+    return running.load() == 0;
+}
+
+float LoadGroup::get_progress() const
+{
+    uint32_t count = step_count.load();
+    return count == 0 ? 1.0f : std::min((float) steps_done.load() / count, 1.0f);
+}
+
+uint32_t LoadGroup::get_steps_done() const
+{
+    return steps_done.load();
+}
+
+uint32_t LoadGroup::get_step_count() const
+{
+    return step_count.load();
+}
+
+void LoadGroup::rethrow_error()
+{
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if (error) std::rethrow_exception(error);
+}
+
+void LoadGroup::add_steps(uint32_t count)
+{
+    step_count.fetch_add(count);
+}
+
+void LoadGroup::finish_steps(uint32_t count)
+{
+    steps_done.fetch_add(count);
+}
+
+void LoadGroup::begin_load()
+{
+    running.fetch_add(1);
+}
+
+void LoadGroup::end_load(std::exception_ptr load_error)
+{
+    if (load_error)
+    {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = load_error;
+    }
+
+    running.fetch_sub(1);
+}
+
+/* #endregion */
+
+/* #region loads */
+
+static UploadThread* upload_thread = nullptr;
+
+void asset_loader::set_upload_thread(UploadThread* uploads)
+{
+    upload_thread = uploads;
+}
+
+// Runs `upload` on the upload thread if there is one, otherwise on the GL thread, and
+// continues on the GL thread once the result can be drawn. A cancel that comes in during
+// the upload doesn't stop the load here, its caller still registers what was created.
+static Task<void> run_upload(std::function<void()> upload, std::shared_ptr<LoadGroup> group)
+{
+    if (upload_thread != nullptr)
+    {
+        co_await upload_thread->upload(std::move(upload));
+    }
+    else
+    {
+        co_await group->resume_on(JOB_GL_THREAD);
+        upload();
+    }
+}
+
+// Two steps, decoding and uploading
+Task<uint32_t> asset_loader::load_texture(std::string file_name, std::shared_ptr<LoadGroup> group)
+{
+    group->add_steps(2);
+
+    co_await group->resume_on(JOB_GL_THREAD);
+
+    if (image_registry::is_loaded(file_name))
+    {
+        group->finish_steps(2);
+        co_return image_registry::get_texture(file_name);
+    }
+
+    co_await group->resume_on(JOB_BACKGROUND);
+
+    ImageData image = image_registry::decode_texture(file_name);
+    group->finish_steps(1);
+
+    uint32_t texture = 0;
+    co_await run_upload([&]() { texture = image_registry::create_texture(image); }, group);
+
+    // Gives the texture another load registered in the meantime, if there is one
+    texture = image_registry::register_texture(image, texture);
+    group->finish_steps(1);
+
+    co_return texture;
+}
+
+// Two steps of its own, parsing and uploading, plus those of its textures
+Task<const ModelData*> asset_loader::load_model(std::string file_name, std::shared_ptr<LoadGroup> group)
+{
+    group->add_steps(2);
+
+    co_await group->resume_on(JOB_GL_THREAD);
+
+    if (mesh_registry::is_loaded(file_name))
+    {
+        group->finish_steps(2);
+        co_return &mesh_registry::get_model(file_name);
+    }
+
+    co_await group->resume_on(JOB_BACKGROUND);
+
+    std::shared_ptr<const ModelSource> source = mesh_registry::decode_model(file_name);
+    group->finish_steps(1);
+
+    std::set<std::string> texture_names;
+    for (const MeshData& mesh : source->meshes) texture_names.insert(mesh.texture_name);
+
+    std::vector<Task<uint32_t>> textures;
+    for (const std::string& texture_name : texture_names)
+    {
+        textures.push_back(load_texture(texture_name, group));
+    }
+
+    co_await when_all(std::move(textures));
+
+    // The last texture load finished on the GL thread, so this continues there with all
+    // of them registered
+    ModelData data;
+    data.bounds = source->bounds;
+    data.collision = source->collision;
+
+    for (const MeshData& mesh_data : source->meshes)
+    {
+        Mesh mesh;
+        mesh.vertices = mesh_data.vertices;
+        mesh.indices = mesh_data.indices;
+        mesh.texture = image_registry::get_texture(mesh_data.texture_name);
+
+        data.meshes.push_back(std::move(mesh));
+    }
+
+    co_await run_upload([&]() {
+        for (Mesh& mesh : data.meshes) mesh.create_buffers();
+    }, group);
+
+    for (Mesh& mesh : data.meshes) mesh.create_vertex_array();
+
+    const ModelData& model = mesh_registry::register_model(file_name, std::move(data));
+    group->finish_steps(1);
+
+    co_return &model;
+}
+
+Task<void> asset_loader::load_level(LevelData level, std::shared_ptr<LoadGroup> group)
+{
+    std::vector<Task<const ModelData*>> models;
+    for (uint32_t mesh : level.meshes)
+    {
+        models.push_back(load_model(level.get_string(mesh), group));
+    }
+
+    std::vector<Task<uint32_t>> textures;
+    for (uint32_t texture : level.textures)
+    {
+        textures.push_back(load_texture(level.get_string(texture), group));
+    }
+
+    co_await when_all(std::move(models));
+    co_await when_all(std::move(textures));
+}
+
+/* #endregion */
+
+static DetachedTask run_load(std::shared_ptr<LoadGroup> group, Task<void> task)
+{
+    std::exception_ptr error;
+
+    try
+    {
+        co_await std::move(task);
+    }
+    catch (const LoadCancelled&)
+    {
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    group->end_load(error);
+}
+
+void asset_loader::start(std::shared_ptr<LoadGroup> group, Task<void> task)
+{
+    group->begin_load();
+    run_load(group, std::move(task));
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "task.hpp"
+#include "level.hpp"
+#include "mesh_registry.hpp"
+#include "upload_thread.hpp"
+
+// Thrown out of the loads of a cancelled group, at their next thread switch
+struct LoadCancelled : std::runtime_error
+{
+    LoadCancelled() : std::runtime_error("Load cancelled") {}
+};
+
+// Progress and cancellation of a set of loads, shared by the loads and whoever waits for
+// them, like a loading screen or the streamer.
+class LoadGroup
+{
+public:
+    LoadGroup() = default;
+
+    LoadGroup(const LoadGroup&) = delete;
+    LoadGroup& operator = (const LoadGroup&) = delete;
+
+    // The loads stop at their next thread switch. What they already uploaded stays loaded.
+    void cancel();
+    bool is_cancelled() const;
+
+    // Whether every load started with asset_loader::start() finished, failed or stopped
+    bool is_done() const;
+
+    // Finished steps over the steps known so far. Every load adds its steps when it
+    // starts, so the value can go down while new loads are found.
+    float get_progress() const;
+    uint32_t get_steps_done() const;
+    uint32_t get_step_count() const;
+
+    // Rethrows the first error of a load. Cancelling isn't one.
+    void rethrow_error();
+
+    // Like resume_on(), but throws LoadCancelled once the group is cancelled
+    auto resume_on(JobAffinity affinity)
+    {
+        struct Awaiter
+        {
+            LoadGroup& group;
+            JobAffinity affinity;
+
+            bool await_ready() noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                jobs::run([handle]() { handle.resume(); }, nullptr, affinity);
+            }
+
+            void await_resume()
+            {
+                if (group.is_cancelled()) throw LoadCancelled();
+            }
+        };
+
+        return Awaiter { *this, affinity };
+    }
+
+    // Used by the loads themselves
+    void add_steps(uint32_t count);
+    void finish_steps(uint32_t count);
+    void begin_load();
+    void end_load(std::exception_ptr error);
+
+private:
+    std::atomic<bool> cancelled { false };
+    std::atomic<uint32_t> running { 0 };
+    std::atomic<uint32_t> steps_done { 0 };
+    std::atomic<uint32_t> step_count { 0 };
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+};
+
+// Asynchronous counterparts of the blocking loads in mesh_registry and image_registry.
+// Files are read and decoded on the job workers and uploaded on the GL thread or the
+// upload thread, and the results are registered like the blocking loads do, so a Model created afterwards finds
+// everything loaded. The registries are only ever touched on the GL thread.
+namespace asset_loader
+{
+    // Buffers and textures go up on `uploads` instead of the GL thread, which only
+    // registers them. nullptr uploads on the GL thread again.
+    void set_upload_thread(UploadThread* uploads);
+
+    Task<uint32_t> load_texture(std::string file_name, std::shared_ptr<LoadGroup> group);
+
+    // The textures of the model are decoded in parallel
+    Task<const ModelData*> load_model(std::string file_name, std::shared_ptr<LoadGroup> group);
+
+    // Every model and texture the level refers to, so level::instantiate() doesn't block
+    Task<void> load_level(LevelData level, std::shared_ptr<LoadGroup> group);
+
+    // Runs `task` in the background as one of the loads of `group`. Its result is only
+    // registered, errors are kept for LoadGroup::rethrow_error().
+    void start(std::shared_ptr<LoadGroup> group, Task<void> task);
+
+    template<typename T>
+    void start(std::shared_ptr<LoadGroup> group, Task<T> task)
+    {
+        start(group, [](Task<T> task) -> Task<void> { co_await std::move(task); }(std::move(task)));
+    }
+}
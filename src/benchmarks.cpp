@@ -0,0 +1,1281 @@
+#include "benchmarks.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+#include <gtc/matrix_transform.hpp>
+
+#include "bvh.hpp"
+#include "frame_pacer.hpp"
+#include "jobs.hpp"
+#include "upload_thread.hpp"
+#include "stream_buffer.hpp"
+#include "mesh_pool.hpp"
+#include "instance_culling.hpp"
+#include "occlusion_culler.hpp"
+#include "systems.hpp"
+#include "scene.hpp"
+#include "model.hpp"
+#include "collision.hpp"
+#include "node_arena.hpp"
+#include "route.hpp"
+#include "foliage.hpp"
+#include "image_registry.hpp"
+#include "draw_distance.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static double milliseconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void benchmarks::foliage_generation(uint32_t chunk_count)
+{
+    FoliageConfig config;
+    ModelSource tree = foliage::extract_tree(*mesh_registry::decode_model(foliage::SOURCE_MODEL));
+
+    Route route(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), 8, 100);
+    std::vector<RouteChunk> chunks;
+    std::vector<std::vector<glm::vec3>> nearby_centerlines;
+
+    for (uint32_t i = 0; i < chunk_count; i++)
+    {
+        chunks.push_back(route.get_chunk(i));
+        nearby_centerlines.push_back(route.get_nearby_centerline(i));
+    }
+
+    uint32_t hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (uint32_t thread_count : { 1u, hardware_threads })
+    {
+        std::vector<size_t> counts(thread_count, 0);
+        std::vector<std::thread> threads;
+
+        Clock::time_point start = Clock::now();
+
+        for (uint32_t t = 0; t < thread_count; t++)
+        {
+            threads.emplace_back([&, t]() {
+                for (uint32_t i = t; i < chunks.size(); i += thread_count)
+                {
+                    AABB bounds = AABB::empty();
+                    counts[t] += foliage::scatter(chunks[i], nearby_centerlines[i], config, tree.bounds, bounds).size();
+                }
+            });
+        }
+
+        for (std::thread& thread : threads) thread.join();
+
+        double elapsed = milliseconds_since(start);
+
+        size_t total = 0;
+        for (size_t count : counts) total += count;
+
+        std::printf("foliage generation, %u threads: %zu instances over %.0f m in %.2f ms, %.0f instances/ms\n",
+            thread_count, total, chunks.back().start_distance + chunks.back().length, elapsed, total / elapsed);
+    }
+}
+
+void benchmarks::foliage_rendering(const FoliageShaders& shaders, uint32_t instance_count, uint32_t frames)
+{
+    ModelSource tree = foliage::extract_tree(*mesh_registry::decode_model(foliage::SOURCE_MODEL));
+
+    std::vector<Mesh> meshes;
+    size_t triangles = 0;
+
+    for (MeshData& mesh : tree.meshes)
+    {
+        triangles += mesh.indices.size() / 3;
+        meshes.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), image_registry::get_or_load_texture(mesh.texture_name)));
+    }
+
+    Impostor impostor(meshes.data(), meshes.size(), tree.bounds, shaders.impostor_bake);
+
+    // A square forest below the camera, so every instance is inside the frustum
+    uint32_t side = (uint32_t) std::ceil(std::sqrt((double) instance_count));
+    float spacing = 2.0f;
+
+    std::vector<Instance> instances;
+    for (uint32_t i = 0; i < instance_count; i++)
+    {
+        glm::vec3 position((i % side - side * 0.5f) * spacing, 0.0f, (i / side - side * 0.5f) * spacing);
+        instances.push_back(Instance { position, (float) i, 1.0f, 0.0f });
+    }
+
+    // The second batch switches to impostors right in front of the camera
+    InstanceBatch mesh_batch(meshes.data(), meshes.size(), instances);
+    InstanceBatch impostor_batch(meshes.data(), meshes.size(), std::move(instances));
+    impostor_batch.set_impostor(&impostor, shaders.impostors, 0.0f, 0.001f);
+
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    int width = viewport[2], height = viewport[3];
+
+    float extent = side * spacing;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float) width / height, 1.0f, extent * 4.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, extent * 1.3f, 0.01f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    for (Shader* shader : { shaders.meshes, shaders.impostors })
+    {
+        shader->use();
+        shader->set_mat4("projection", projection);
+        shader->set_mat4("view", view);
+        shader->set_vec2("screen_size", glm::vec2(width, height));
+
+        // The shaders still pay for the fog, it only starts past the forest
+        DrawDistances fog;
+        fog.fog_start = extent * 4.0f;
+        fog.fog_end = extent * 8.0f;
+        fog.set_fog(shader);
+    }
+
+    struct Pass
+    {
+        const char* name;
+        const InstanceBatch* batch;
+        uint32_t layers;
+        size_t triangles;
+    };
+
+    for (const Pass& pass : { Pass { "meshes", &mesh_batch, INSTANCE_MESHES, triangles }, Pass { "impostors", &impostor_batch, INSTANCE_IMPOSTORS, 2 } })
+    {
+        // Warm up, the first frames pay for shader compilation and uploads
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            pass.batch->draw(shaders.meshes, view, instance_count, pass.layers);
+            glFinish();
+        }
+
+        Clock::time_point start = Clock::now();
+
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            pass.batch->draw(shaders.meshes, view, instance_count, pass.layers);
+            glFinish();
+        }
+
+        double frame_ms = milliseconds_since(start) / frames;
+
+        std::printf("foliage rendering, %s: %u instances of %zu triangles, %.2f ms per frame, %.2f ms per million instances\n",
+            pass.name, instance_count, pass.triangles, frame_ms, frame_ms / (instance_count / 1000000.0));
+    }
+
+    mesh_batch.destroy_batch();
+    impostor_batch.destroy_batch();
+    impostor.destroy_impostor();
+    for (Mesh& mesh : meshes) mesh.destroy_mesh();
+}
+
+void benchmarks::bvh_queries(uint32_t ray_count)
+{
+    std::shared_ptr<const ModelSource> source = mesh_registry::decode_model(Route::get_tile_model(TILE_CURVE_LEFT));
+
+    // A grid of curve tiles, about the triangle count of a few streamed chunks
+    const int GRID = 8;
+    const float SPACING = 25.0f;
+
+    std::vector<glm::mat4> placements;
+
+    for (int x = 0; x < GRID; x++)
+    {
+        for (int z = 0; z < GRID; z++)
+        {
+            placements.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(x * SPACING, 0.0f, z * SPACING)));
+        }
+    }
+
+    // Rays start above the grid and point down at it, the four rays of a packet start
+    // within a metre of each other, like the wheels of a car
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> across(0.0f, GRID * SPACING);
+    std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+
+    std::vector<RayPacket> packets((ray_count + RayPacket::SIZE - 1) / RayPacket::SIZE);
+
+    for (RayPacket& packet : packets)
+    {
+        glm::vec3 origin(across(random), 10.0f, across(random));
+        glm::vec3 direction(jitter(random), -1.0f, jitter(random));
+
+        for (uint32_t lane = 0; lane < RayPacket::SIZE; lane++)
+        {
+            packet.rays[lane].origin = origin + glm::vec3(jitter(random), 0.0f, jitter(random));
+            packet.rays[lane].direction = direction;
+            packet.rays[lane].max_distance = 100.0f;
+        }
+    }
+
+    for (BVHFormat format : { BVH_FLOAT, BVH_QUANTIZED })
+    {
+        const char* name = format == BVH_FLOAT ? "float" : "quantized";
+
+        TriangleBVH bvh;
+        for (const glm::mat4& placement : placements)
+        {
+            for (const MeshData& mesh : source->meshes) bvh.add_mesh(mesh.vertices, mesh.indices, placement);
+        }
+
+        Clock::time_point start = Clock::now();
+        bvh.build(format);
+        double build_ms = milliseconds_since(start);
+
+        std::printf("bvh %s: %u triangles, %u nodes, %zu bytes, built in %.2f ms\n",
+            name, bvh.get_triangle_count(), bvh.get_node_count(), bvh.get_memory_bytes(), build_ms);
+
+        // One at a time
+        std::vector<RayHit> scalar_hits(packets.size() * RayPacket::SIZE);
+        size_t hit_count = 0;
+
+        start = Clock::now();
+
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            for (uint32_t lane = 0; lane < RayPacket::SIZE; lane++)
+            {
+                RayHit& hit = scalar_hits[i * RayPacket::SIZE + lane];
+                hit_count += bvh.intersect(packets[i].rays[lane], hit);
+            }
+        }
+
+        double scalar_ms = milliseconds_since(start);
+
+        // In packets, which have to find the same hits
+        for (RayPacket& packet : packets)
+        {
+            for (RayHit& hit : packet.hits) hit = RayHit();
+        }
+
+        start = Clock::now();
+        for (RayPacket& packet : packets) bvh.intersect(packet);
+        double packet_ms = milliseconds_since(start);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            for (uint32_t lane = 0; lane < RayPacket::SIZE; lane++)
+            {
+                const RayHit& scalar = scalar_hits[i * RayPacket::SIZE + lane];
+                const RayHit& packet = packets[i].hits[lane];
+
+                if (scalar.triangle != packet.triangle && std::abs(scalar.distance - packet.distance) > 1e-4f) mismatches++;
+            }
+        }
+
+        size_t rays = packets.size() * RayPacket::SIZE;
+
+        std::printf("bvh %s rays: %zu rays, %zu hits, %.0f rays/s one at a time, %.0f rays/s in packets, %zu mismatches\n",
+            name, rays, hit_count, rays * 1000.0 / scalar_ms, rays * 1000.0 / packet_ms, mismatches);
+
+        // Wheel sized spheres resting on the road
+        std::vector<SphereContact> contacts;
+        size_t contact_count = 0;
+
+        start = Clock::now();
+
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            const RayHit& hit = scalar_hits[i * RayPacket::SIZE];
+            if (!hit.is_hit()) continue;
+
+            const Ray& ray = packets[i].rays[0];
+            glm::vec3 center = ray.origin + ray.direction * hit.distance + glm::vec3(0.0f, 0.3f, 0.0f);
+
+            contacts.clear();
+            bvh.overlap_sphere(center, 0.35f, contacts);
+            contact_count += contacts.size();
+        }
+
+        double sphere_ms = milliseconds_since(start);
+
+        std::printf("bvh %s spheres: %zu queries, %zu contacts, %.0f queries/ms\n",
+            name, packets.size(), contact_count, packets.size() / sphere_ms);
+    }
+}
+
+void benchmarks::frame_pacing(GLFWwindow* window, uint32_t frames)
+{
+    struct Mode
+    {
+        const char* name;
+        FramePacingConfig config;
+    };
+
+    FramePacingConfig vsync, adaptive, uncapped, limited, low_latency, vsync_low_latency;
+    adaptive.present_mode = PRESENT_ADAPTIVE;
+    uncapped.present_mode = PRESENT_UNCAPPED;
+    limited.present_mode = PRESENT_UNCAPPED;
+    limited.max_fps = 60.0;
+    low_latency = limited;
+    low_latency.low_latency = true;
+    vsync_low_latency.low_latency = true;
+
+    for (const Mode& mode : { Mode { "vsync", vsync }, Mode { "adaptive", adaptive }, Mode { "uncapped", uncapped },
+        Mode { "limited to 60", limited }, Mode { "limited to 60, low latency", low_latency }, Mode { "vsync, low latency", vsync_low_latency } })
+    {
+        FramePacer pacer(mode.config);
+
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            pacer.begin_frame();
+            glfwPollEvents();
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glfwSwapBuffers(window);
+
+            pacer.end_frame();
+        }
+
+        const FrameTimeStats& stats = pacer.get_stats();
+
+        std::printf("frame pacing, %s (%s): %.2f ms per frame, deviation %.3f ms, worst %.2f ms, input latency %.2f ms\n",
+            mode.name, FramePacer::get_mode_name(pacer.get_present_mode()), stats.mean_ms, stats.deviation_ms, stats.worst_ms, stats.input_latency_ms);
+    }
+}
+
+void benchmarks::job_scheduling(uint32_t job_count)
+{
+    JobStats before = jobs::get_stats();
+
+    // Scheduling overhead alone. Jobs are queued in batches well below the 4096 a deque
+    // holds, so none of them spill into the shared queue.
+    const uint32_t batch_size = 1024;
+
+    auto run_empty_jobs = [job_count, batch_size]() {
+        JobCounter counter;
+        Clock::time_point start = Clock::now();
+
+        for (uint32_t i = 0; i < job_count; i += batch_size)
+        {
+            for (uint32_t j = i; j < std::min(i + batch_size, job_count); j++)
+            {
+                jobs::run([]() {}, &counter);
+            }
+            jobs::wait(counter);
+        }
+
+        return milliseconds_since(start);
+    };
+
+    double deque_elapsed = run_empty_jobs();
+
+    std::printf("jobs, %u workers: %u empty jobs through this thread's deque in %.2f ms, %.0f ns per job\n",
+        jobs::get_worker_count(), job_count, deque_elapsed, deque_elapsed * 1000000.0 / job_count);
+
+    // Threads outside the pool queue through the shared locked queue instead
+    double shared_elapsed = 0.0;
+    std::thread outside([&]() { shared_elapsed = run_empty_jobs(); });
+    outside.join();
+
+    std::printf("jobs, %u empty jobs through the shared queue in %.2f ms, %.0f ns per job\n",
+        job_count, shared_elapsed, shared_elapsed * 1000000.0 / job_count);
+
+    // Sums a sequence big enough to be worth splitting, the result is checked so the work stays
+    const uint32_t count = 1 << 24;
+
+    std::vector<uint32_t> values(count);
+    for (uint32_t i = 0; i < count; i++) values[i] = i * 2654435761u;
+
+    uint64_t expected = 0;
+    Clock::time_point single_start = Clock::now();
+    for (uint32_t value : values) expected += value;
+    double single = milliseconds_since(single_start);
+
+    std::printf("jobs, parallel sum of %u values, 1 thread: %.2f ms\n", count, single);
+
+    for (uint32_t grain_size : { 1u << 10, 1u << 14, 1u << 18, 1u << 22 })
+    {
+        std::atomic<uint64_t> sum { 0 };
+        Clock::time_point start = Clock::now();
+
+        jobs::parallel_for(count, grain_size, [&](uint32_t begin, uint32_t end) {
+            uint64_t partial = 0;
+            for (uint32_t i = begin; i < end; i++) partial += values[i];
+
+            sum.fetch_add(partial, std::memory_order_relaxed);
+        });
+
+        double elapsed = milliseconds_since(start);
+
+        std::printf("jobs, parallel sum, grain %u: %.2f ms, %.2fx%s\n",
+            grain_size, elapsed, single / elapsed, sum.load() == expected ? "" : " (wrong sum)");
+    }
+
+    // Every job of the chain is only queued once the one before it finished
+    const uint32_t chain_length = 10000;
+
+    std::vector<JobCounter> chain(chain_length);
+    Clock::time_point chain_start = Clock::now();
+
+    jobs::run([]() {}, &chain[0]);
+    for (uint32_t i = 1; i < chain_length; i++)
+    {
+        jobs::run_after(chain[i - 1], []() {}, &chain[i]);
+    }
+    jobs::wait(chain.back());
+
+    double chain_elapsed = milliseconds_since(chain_start);
+
+    JobStats after = jobs::get_stats();
+
+    std::printf("jobs, chain of %u dependent jobs: %.2f ms, %.0f ns per dependency\n",
+        chain_length, chain_elapsed, chain_elapsed * 1000000.0 / chain_length);
+    std::printf("jobs, %llu jobs run, %llu stolen\n",
+        (unsigned long long) (after.jobs_run - before.jobs_run), (unsigned long long) (after.steals - before.steals));
+}
+
+static void check_stress(bool condition, const char* what)
+{
+    if (!condition) throw std::runtime_error(std::string("Job stress run failed: ") + what + ".");
+}
+
+void benchmarks::job_stress(uint32_t rounds)
+{
+    std::mt19937 random(1234);
+    uint32_t max_threads = 0;
+
+    Clock::time_point start = Clock::now();
+
+    for (uint32_t round = 0; round < rounds; round++)
+    {
+        // parallel_for inside parallel_for, at random sizes and grains
+        uint32_t outer = 1 + random() % 64, outer_grain = 1 + random() % 8;
+        uint32_t inner = 1 + random() % 4096, inner_grain = 1 + random() % 512;
+        std::atomic<uint64_t> sum { 0 };
+
+        jobs::parallel_for(outer, outer_grain, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                jobs::parallel_for(inner, inner_grain, [&, i](uint32_t inner_begin, uint32_t inner_end) {
+                    uint64_t partial = 0;
+                    for (uint32_t j = inner_begin; j < inner_end; j++) partial += (uint64_t) i * inner + j;
+
+                    sum.fetch_add(partial, std::memory_order_relaxed);
+                });
+            }
+        });
+
+        uint64_t total = (uint64_t) outer * inner;
+        check_stress(sum.load() == total * (total - 1) / 2, "nested parallel_for missed or repeated a range");
+
+        // A chain of run_after, every step has to come after all the ones before it
+        uint32_t chain_length = 1 + random() % 64;
+        std::vector<JobCounter> chain(chain_length);
+        std::atomic<uint32_t> steps { 0 }, out_of_order { 0 };
+
+        jobs::run([&]() { if (steps.fetch_add(1) != 0) out_of_order.fetch_add(1); }, &chain[0]);
+        for (uint32_t i = 1; i < chain_length; i++)
+        {
+            jobs::run_after(chain[i - 1], [&, i]() { if (steps.fetch_add(1) != i) out_of_order.fetch_add(1); }, &chain[i]);
+        }
+
+        // Jobs that start jobs and wait for them, a few levels deep
+        uint32_t fan_out = 2 + random() % 3, depth = 1 + random() % 4;
+        std::atomic<uint32_t> leaves { 0 };
+
+        std::function<void(uint32_t)> spawn = [&](uint32_t level) {
+            if (level == 0)
+            {
+                leaves.fetch_add(1);
+                return;
+            }
+
+            JobCounter children;
+            for (uint32_t i = 0; i < fan_out; i++)
+            {
+                jobs::run([&spawn, level]() { spawn(level - 1); }, &children);
+            }
+            jobs::wait(children);
+        };
+
+        JobCounter tree;
+        jobs::run([&]() { spawn(depth); }, &tree);
+
+        // Threads outside the pool queuing and waiting all at once, while the rest runs
+        uint32_t thread_count = 2 + random() % 3, jobs_per_thread = 1 + random() % 256;
+        std::atomic<uint32_t> outside_runs { 0 };
+        std::vector<std::thread> threads;
+
+        for (uint32_t i = 0; i < thread_count; i++)
+        {
+            threads.emplace_back([&]() {
+                JobCounter counter;
+                for (uint32_t j = 0; j < jobs_per_thread; j++)
+                {
+                    jobs::run([&]() { outside_runs.fetch_add(1); }, &counter);
+                }
+                jobs::wait(counter);
+            });
+        }
+
+        jobs::wait(chain.back());
+        jobs::wait(tree);
+        for (std::thread& thread : threads) thread.join();
+
+        uint32_t expected_leaves = 1;
+        for (uint32_t i = 0; i < depth; i++) expected_leaves *= fan_out;
+
+        check_stress(steps.load() == chain_length && out_of_order.load() == 0, "a run_after job ran before its dependency");
+        check_stress(leaves.load() == expected_leaves, "a job waiting inside a job returned early");
+        check_stress(outside_runs.load() == thread_count * jobs_per_thread, "a job queued from outside the pool was lost");
+
+        max_threads = std::max(max_threads, thread_count);
+    }
+
+    std::printf("jobs, stress: %u random rounds of nested parallel_for, run_after chains, waits inside jobs and up to %u outside threads in %.2f ms, all results correct\n",
+        rounds, max_threads, milliseconds_since(start));
+}
+
+void benchmarks::upload_spikes(GLFWwindow* window, uint32_t frames)
+{
+    const uint32_t upload_interval = 10;
+
+    ImageData image;
+    image.file_name = "upload benchmark";
+    image.width = 1024;
+    image.height = 1024;
+    image.pixels.assign((size_t) image.width * image.height * 4, 128);
+
+    std::vector<Vertex> vertices(1 << 16);
+    std::vector<uint32_t> indices;
+
+    for (uint32_t i = 0; i < vertices.size(); i++)
+    {
+        vertices[i] = Vertex { glm::vec3((float) (i % 256), 0.0f, (float) (i / 256)), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f, 0.0f) };
+        indices.push_back(i);
+        indices.push_back((i + 1) % vertices.size());
+        indices.push_back((i + 256) % vertices.size());
+    }
+
+    // Frame times are only honest without vsync, and with the GL work of the frame done
+    glfwSwapInterval(0);
+
+    for (bool threaded : { false, true })
+    {
+        std::unique_ptr<UploadThread> uploads;
+        if (threaded) uploads = std::make_unique<UploadThread>(window);
+
+        struct Uploaded
+        {
+            uint32_t texture = 0;
+            Mesh mesh;
+        };
+
+        std::vector<Uploaded> uploaded;
+        std::vector<double> frame_times;
+
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            Clock::time_point start = Clock::now();
+
+            if (frame % upload_interval == 0)
+            {
+                std::shared_ptr<Uploaded> upload = std::make_shared<Uploaded>();
+                upload->mesh.vertices = vertices;
+                upload->mesh.indices = indices;
+                upload->mesh.texture = 0;
+
+                if (threaded)
+                {
+                    uploads->submit([upload, &image]() {
+                        upload->texture = image_registry::create_texture(image);
+                        upload->mesh.create_buffers();
+                    }, [upload, &uploaded]() {
+                        upload->mesh.create_vertex_array();
+                        uploaded.push_back(*upload);
+                    });
+                }
+                else
+                {
+                    upload->texture = image_registry::create_texture(image);
+                    upload->mesh.initialize_mesh();
+                    uploaded.push_back(*upload);
+                }
+            }
+
+            if (uploads) uploads->publish();
+
+            glfwPollEvents();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glfwSwapBuffers(window);
+            glFinish();
+
+            frame_times.push_back(milliseconds_since(start));
+        }
+
+        if (uploads)
+        {
+            while (uploads->get_stats().pending > 0) uploads->publish();
+            uploads->stop();
+        }
+
+        for (Uploaded& upload : uploaded)
+        {
+            glDeleteTextures(1, &upload.texture);
+            upload.mesh.destroy_mesh();
+        }
+
+        double mean = 0.0, worst = 0.0;
+        for (double time : frame_times)
+        {
+            mean += time;
+            worst = std::max(worst, time);
+        }
+        mean /= frame_times.size();
+
+        uint32_t spikes = 0;
+        for (double time : frame_times) spikes += time > mean * 2.0;
+
+        std::printf("uploads, %s: %u uploads, %.2f ms per frame, worst %.2f ms, %u frames over twice the mean\n",
+            threaded ? "upload thread" : "drawing thread", (uint32_t) uploaded.size(), mean, worst, spikes);
+    }
+}
+
+void benchmarks::stream_buffers(GLFWwindow* window, const Shader* shader, uint32_t draw_count, uint32_t frames)
+{
+    // One small triangle, the cost measured is the per draw data and not the pixels
+    const glm::vec3 triangle[3] = { glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.01f, 0.0f, 0.0f), glm::vec3(0.0f, 0.01f, 0.0f) };
+
+    uint32_t VAO, VBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*) 0);
+
+    std::vector<DrawData> draw_data(draw_count);
+    for (uint32_t i = 0; i < draw_count; i++)
+    {
+        draw_data[i].model_view = glm::translate(glm::mat4(1.0f), glm::vec3((float) (i % 100) * 0.02f - 1.0f, (float) (i / 100 % 100) * 0.02f - 1.0f, -1.0f));
+    }
+
+    shader->use();
+    shader->set_uniform_block("DrawData", DRAW_DATA_BINDING);
+    shader->set_mat4("view", glm::mat4(1.0f));
+    shader->set_mat4("projection", glm::mat4(1.0f));
+
+    size_t stride = std::max(StreamBuffer::get_uniform_alignment(), sizeof(DrawData));
+
+    glfwSwapInterval(0);
+
+    enum Method { SUB_DATA, ORPHANED, PERSISTENT };
+
+    for (Method method : { SUB_DATA, ORPHANED, PERSISTENT })
+    {
+        if (method == PERSISTENT && glBufferStorage == nullptr)
+        {
+            std::printf("stream buffers, persistent: not supported by the context\n");
+            continue;
+        }
+
+        // glBufferSubData into one small buffer, each update has to wait for or copy
+        // around the draw before it that still reads the old contents
+        uint32_t sub_data_buffer = 0;
+        std::unique_ptr<StreamBuffer> stream;
+
+        if (method == SUB_DATA)
+        {
+            glGenBuffers(1, &sub_data_buffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, sub_data_buffer);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(DrawData), nullptr, GL_DYNAMIC_DRAW);
+            glBindBufferBase(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, sub_data_buffer);
+        }
+        else
+        {
+            stream = std::make_unique<StreamBuffer>(GL_UNIFORM_BUFFER, (draw_count + 1) * stride, method == PERSISTENT);
+        }
+
+        double submit_ms = 0.0, frame_ms = 0.0, wait_ms = 0.0;
+
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            Clock::time_point start = Clock::now();
+
+            glfwPollEvents();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            if (method == SUB_DATA)
+            {
+                for (uint32_t i = 0; i < draw_count; i++)
+                {
+                    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(DrawData), &draw_data[i]);
+                    glDrawArrays(GL_TRIANGLES, 0, 3);
+                }
+            }
+            else
+            {
+                stream->begin_frame((draw_count + 1) * stride);
+
+                size_t first = 0;
+                for (uint32_t i = 0; i < draw_count; i++)
+                {
+                    StreamAllocation allocation = stream->allocate(sizeof(DrawData), stride);
+                    std::memcpy(allocation.data, &draw_data[i], sizeof(DrawData));
+                    if (i == 0) first = allocation.offset;
+                }
+
+                stream->flush();
+
+                for (uint32_t i = 0; i < draw_count; i++)
+                {
+                    glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, stream->get_buffer(), first + i * stride, sizeof(DrawData));
+                    glDrawArrays(GL_TRIANGLES, 0, 3);
+                }
+
+                stream->end_frame();
+                wait_ms += stream->get_stats().wait_ms;
+            }
+
+            submit_ms += milliseconds_since(start);
+
+            // Swapped without finishing, so the persistent regions overlap frames in flight
+            glfwSwapBuffers(window);
+            frame_ms += milliseconds_since(start);
+        }
+
+        glFinish();
+
+        if (stream) stream->destroy();
+        if (sub_data_buffer != 0) glDeleteBuffers(1, &sub_data_buffer);
+
+        const char* names[] = { "glBufferSubData", "orphaned", "persistent" };
+        std::printf("stream buffers, %s: %u draws, %.2f ms writing and drawing, %.2f ms per frame, %.2f ms waiting for regions\n",
+            names[method], draw_count, submit_ms / frames, frame_ms / frames, wait_ms / frames);
+    }
+
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+}
+
+void benchmarks::indirect_draws(GLFWwindow* window, Shader* shader, Shader* indirect, uint32_t mesh_count, uint32_t frames)
+{
+    const uint32_t texture_count = 8;
+
+    std::vector<uint32_t> textures;
+    for (uint32_t i = 0; i < texture_count; i++)
+    {
+        ImageData image;
+        image.width = 16;
+        image.height = 16;
+        image.pixels.assign(16 * 16 * 4, (unsigned char) (i * 30));
+        textures.push_back(image_registry::create_texture(image));
+    }
+
+    // Boxes of different sizes, a mesh each like the pieces of a level
+    auto make_meshes = [&]() {
+        std::vector<Mesh> meshes(mesh_count);
+
+        for (uint32_t i = 0; i < mesh_count; i++)
+        {
+            glm::vec3 size = glm::vec3(0.2f + (i % 7) * 0.05f, 0.2f + (i % 5) * 0.05f, 0.2f);
+
+            for (uint32_t corner = 0; corner < 8; corner++)
+            {
+                glm::vec3 position = size * glm::vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+                meshes[i].vertices.push_back(Vertex { position, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(position.x, position.y) });
+            }
+
+            meshes[i].indices = { 0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3 };
+            meshes[i].texture = textures[i % texture_count];
+            meshes[i].initialize_mesh();
+        }
+
+        return meshes;
+    };
+
+    std::vector<Mesh> separate_meshes = make_meshes();
+
+    if (!mesh_pool::init(16 * 1024 * 1024, 16 * 1024 * 1024))
+    {
+        std::printf("indirect draws: the context has no glMultiDrawElementsIndirect, only drawing one at a time\n");
+    }
+
+    std::vector<Mesh> pooled_meshes = make_meshes();
+
+    shader->use();
+    shader->set_uniform_block("DrawData", DRAW_DATA_BINDING);
+
+    for (Shader* s : { shader, indirect })
+    {
+        s->use();
+        s->set_mat4("view", glm::mat4(1.0f));
+        s->set_mat4("projection", glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f));
+        s->set_vec2("screen_size", glm::vec2(800.0f, 600.0f));
+    }
+
+    StreamBuffer draw_data(GL_UNIFORM_BUFFER, 1024 * 1024);
+
+    glfwSwapInterval(0);
+
+    for (uint32_t method = 0; method < 3; method++)
+    {
+        const char* names[] = { "separate buffers", "pooled, one at a time", "multi-draw indirect" };
+
+        if (method > 0 && !mesh_pool::is_enabled()) break;
+
+        const std::vector<Mesh>& meshes = method == 0 ? separate_meshes : pooled_meshes;
+        shader->indirect_variant = method == 2 ? indirect : nullptr;
+
+        DrawList draw_list;
+        for (uint32_t i = 0; i < mesh_count; i++)
+        {
+            DrawItem item;
+            item.mesh_ref = MeshRef { &meshes[i], 1, shader };
+            item.model_view = glm::translate(glm::mat4(1.0f), glm::vec3((float) (i % 100) - 50.0f, (float) (i / 100 % 50) - 25.0f, -60.0f));
+            draw_list.push_back(item);
+        }
+
+        double submit_ms = 0.0, frame_ms = 0.0;
+
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            Clock::time_point start = Clock::now();
+
+            glfwPollEvents();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            systems::submit(draw_list, draw_data);
+            submit_ms += milliseconds_since(start);
+
+            glfwSwapBuffers(window);
+            glFinish();
+            frame_ms += milliseconds_since(start);
+
+            mesh_pool::end_frame();
+        }
+
+        const SubmitStats& submitted = systems::get_submit_stats();
+        std::printf("indirect draws, %s: %u meshes, %.2f ms submitting, %.2f ms per frame, %u draw calls\n",
+            names[method], mesh_count, submit_ms / frames, frame_ms / frames, submitted.multi_draws + submitted.single_draws);
+    }
+
+    shader->indirect_variant = nullptr;
+
+    draw_data.destroy();
+    for (Mesh& mesh : separate_meshes) mesh.destroy_mesh();
+    for (Mesh& mesh : pooled_meshes) mesh.destroy_mesh();
+    mesh_pool::shutdown();
+    glDeleteTextures(texture_count, textures.data());
+}
+
+void benchmarks::gpu_culling(const FoliageShaders& shaders, uint32_t instance_count, uint32_t frames)
+{
+    ModelSource tree = foliage::extract_tree(*mesh_registry::decode_model(foliage::SOURCE_MODEL));
+
+    std::vector<Mesh> meshes;
+    for (MeshData& mesh : tree.meshes)
+    {
+        meshes.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), image_registry::get_or_load_texture(mesh.texture_name)));
+    }
+
+    Impostor impostor(meshes.data(), meshes.size(), tree.bounds, shaders.impostor_bake);
+
+    // A square forest with the camera in its middle, looking along the ground
+    uint32_t side = (uint32_t) std::ceil(std::sqrt((double) instance_count));
+    float spacing = 3.0f;
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<Instance> instances;
+    for (uint32_t i = 0; i < instance_count; i++)
+    {
+        glm::vec3 position((i % side - side * 0.5f) * spacing, 0.0f, (i / side - side * 0.5f) * spacing);
+        instances.push_back(Instance { position, unit(random) * 6.28f, 0.8f + unit(random) * 0.4f, unit(random) });
+    }
+
+    const float impostor_start = 40.0f, impostor_end = 60.0f;
+
+    // Created before and after culling is enabled, batches decide when they are made
+    InstanceBatch drawn_batch(meshes.data(), meshes.size(), instances);
+    drawn_batch.set_impostor(&impostor, shaders.impostors, impostor_start, impostor_end);
+
+    bool culling = instance_culling::init();
+    std::unique_ptr<InstanceBatch> culled_batch;
+
+    if (culling)
+    {
+        culled_batch = std::make_unique<InstanceBatch>(meshes.data(), meshes.size(), instances);
+        culled_batch->set_impostor(&impostor, shaders.impostors, impostor_start, impostor_end);
+    }
+    else
+    {
+        std::printf("gpu culling: the context has no compute shaders, only drawing every instance\n");
+    }
+
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    int width = viewport[2], height = viewport[3];
+
+    float extent = side * spacing;
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float) width / height, 0.1f, extent);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 2.0f, 0.3f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    for (Shader* shader : { shaders.meshes, shaders.impostors })
+    {
+        shader->use();
+        shader->set_mat4("projection", projection);
+        shader->set_mat4("view", view);
+        shader->set_vec2("screen_size", glm::vec2(width, height));
+
+        DrawDistances fog;
+        fog.fog_start = extent;
+        fog.fog_end = extent * 2.0f;
+        fog.set_fog(shader);
+    }
+
+    uint32_t layers = INSTANCE_MESHES | INSTANCE_IMPOSTORS;
+
+    for (const InstanceBatch* batch : { &drawn_batch, culled_batch.get() })
+    {
+        if (batch == nullptr) continue;
+
+        // Warm up, the first frames pay for shader compilation and uploads
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            instance_culling::begin_frame(projection);
+            batch->draw(shaders.meshes, view, instance_count, layers);
+            glFinish();
+        }
+
+        Clock::time_point start = Clock::now();
+
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            instance_culling::begin_frame(projection);
+            batch->draw(shaders.meshes, view, instance_count, layers);
+            glFinish();
+        }
+
+        double frame_ms = milliseconds_since(start) / frames;
+
+        if (batch == &drawn_batch)
+        {
+            std::printf("gpu culling, every instance: %u instances, %.2f ms per frame\n", instance_count, frame_ms);
+        }
+        else
+        {
+            std::printf("gpu culling, culled: %u instances, %.2f ms per frame, %u meshes and %u impostors drawn\n", instance_count, frame_ms,
+                batch->read_culled_count(INSTANCE_MESHES), batch->read_culled_count(INSTANCE_IMPOSTORS));
+        }
+    }
+
+    // The same test as cull_instances.comp on the CPU, without writing anything out. It
+    // times what the compute pass saves and checks what it counted.
+    Frustum frustum = Frustum::from_matrix(projection * view);
+    glm::vec2 bound = drawn_batch.get_bound();
+    uint32_t mesh_count = 0, impostor_count = 0;
+
+    Clock::time_point start = Clock::now();
+
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        mesh_count = impostor_count = 0;
+
+        for (const Instance& instance : instances)
+        {
+            glm::vec3 center = instance.position + glm::vec3(0.0f, bound.x * instance.scale, 0.0f);
+            bool inside = true;
+
+            for (const glm::vec4& plane : frustum.planes)
+            {
+                inside = inside && glm::dot(glm::vec3(plane), center) + plane.w >= -bound.y * instance.scale;
+            }
+
+            if (!inside) continue;
+
+            float distance = glm::length(glm::vec3(view * glm::vec4(instance.position, 1.0f)));
+            mesh_count += distance < impostor_end;
+            impostor_count += distance > impostor_start;
+        }
+    }
+
+    std::printf("gpu culling, the same test on the CPU: %.2f ms per frame for %u instances, %u meshes and %u impostors\n",
+        milliseconds_since(start) / frames, instance_count, mesh_count, impostor_count);
+
+    bool mismatch = culled_batch && (culled_batch->read_culled_count(INSTANCE_MESHES) != mesh_count
+        || culled_batch->read_culled_count(INSTANCE_IMPOSTORS) != impostor_count);
+
+    drawn_batch.destroy_batch();
+    if (culled_batch) culled_batch->destroy_batch();
+    instance_culling::shutdown();
+    impostor.destroy_impostor();
+    for (Mesh& mesh : meshes) mesh.destroy_mesh();
+
+    if (mismatch) throw std::runtime_error("GPU culling kept other instances than the same test on the CPU.");
+}
+
+void benchmarks::occlusion_culling(uint32_t object_count, uint32_t frames)
+{
+    auto hills = [](float x, float z) {
+        return 12.0f * std::sin(x / 60.0f) * std::cos(z / 80.0f) + 6.0f * std::sin(z / 25.0f + x / 45.0f);
+    };
+
+    // Far from the origin like the end of the road, occluders are camera relative
+    glm::dvec3 origin(80000.0, 0.0, -20000.0);
+    glm::dvec3 camera = origin + glm::dvec3(0.0, hills(0.0f, 0.0f) + 1.8, 0.0);
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 2000.0f);
+    glm::dmat4 view = glm::lookAt(camera, camera + glm::dvec3(1.0, -0.05, 0.3), glm::dvec3(0.0, 1.0, 0.0));
+
+    // Terrain like Terrain::add_occluders makes it, 17 heights per 256 m tile out to 400 m
+    const uint32_t side = 51;
+    const float spacing = 16.0f;
+
+    std::vector<glm::vec3> terrain_vertices;
+    std::vector<uint32_t> terrain_indices;
+
+    for (uint32_t z = 0; z < side; z++)
+    {
+        for (uint32_t x = 0; x < side; x++)
+        {
+            float world_x = (x - side / 2.0f) * spacing, world_z = (z - side / 2.0f) * spacing;
+            terrain_vertices.push_back(glm::vec3(glm::dvec3(origin) + glm::dvec3(world_x, hills(world_x, world_z), world_z) - camera));
+
+            if (x + 1 < side && z + 1 < side)
+            {
+                uint32_t corner = z * side + x;
+                terrain_indices.insert(terrain_indices.end(), { corner, corner + side, corner + 1, corner + 1, corner + side, corner + side + 1 });
+            }
+        }
+    }
+
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // The trees close enough to occlude, as a trunk and a crown each
+    std::vector<glm::dmat4> trees;
+    for (uint32_t i = 0; i < 300; i++)
+    {
+        float x = (unit(random) - 0.5f) * 80.0f, z = (unit(random) - 0.5f) * 80.0f;
+        if (x * x + z * z < 9.0f) continue;
+
+        trees.push_back(glm::translate(glm::dmat4(1.0), origin + glm::dvec3(x, hills(x, z), z)));
+    }
+
+    AABB trunk { glm::vec3(-0.15f, 0.0f, -0.15f), glm::vec3(0.15f, 4.0f, 0.15f) };
+    AABB crown { glm::vec3(-1.2f, 4.0f, -1.2f), glm::vec3(1.2f, 8.0f, 1.2f) };
+
+    std::vector<AABB> objects;
+    for (uint32_t i = 0; i < object_count; i++)
+    {
+        float x = (unit(random) - 0.5f) * 800.0f, z = (unit(random) - 0.5f) * 800.0f;
+        float size = 1.0f + unit(random) * 6.0f;
+
+        glm::vec3 base = glm::vec3(origin + glm::dvec3(x, hills(x, z), z));
+        objects.push_back(AABB { base - glm::vec3(size, 0.0f, size), base + glm::vec3(size, size * 2.0f, size) });
+    }
+
+    // Only what frustum culling leaves is tested, like systems::cull does
+    Frustum frustum = Frustum::from_matrix(glm::mat4(glm::dmat4(projection) * view));
+
+    OcclusionCuller culler;
+    double add_ms = 0.0, rasterize_ms = 0.0, wait_ms = 0.0, test_ms = 0.0;
+    OcclusionStats last;
+
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        Clock::time_point start = Clock::now();
+
+        culler.begin_frame(projection, view);
+        culler.add_triangles(terrain_vertices.data(), terrain_vertices.size(), terrain_indices.data(), terrain_indices.size());
+
+        for (const glm::dmat4& tree : trees)
+        {
+            culler.add_box(trunk, tree);
+            culler.add_box(crown, tree);
+        }
+
+        add_ms += milliseconds_since(start);
+        culler.rasterize();
+
+        for (const AABB& object : objects)
+        {
+            if (frustum.intersects(object)) culler.is_occluded(object);
+        }
+
+        last = culler.get_stats();
+        rasterize_ms += last.rasterize_ms;
+        wait_ms += last.wait_ms;
+        test_ms += last.test_ms;
+    }
+
+    std::printf("occlusion: %u occluder triangles, %u rasterized into %ux%u\n", last.occluder_triangles, last.rasterized_triangles, culler.get_width(), culler.get_height());
+    std::printf("occlusion: adding %.3f ms, rasterizing %.3f ms on %u workers, waited %.3f ms per frame\n", add_ms / frames, rasterize_ms / frames, jobs::get_worker_count(), wait_ms / frames);
+    std::printf("occlusion: %u of %u objects in the frustum hidden (%.1f%%), tests %.3f ms per frame, %.0f ns each\n", last.occluded, last.tested,
+        last.tested > 0 ? 100.0 * last.occluded / last.tested : 0.0, test_ms / frames, last.tested > 0 ? test_ms / frames * 1000000.0 / last.tested : 0.0);
+}
+
+// World space position of every vertex the node draws, and its triangles as indices into them
+static void append_drawn_vertices(const Spatial& node, std::vector<glm::dvec3>& vertices, std::vector<uint32_t>& indices)
+{
+    const MeshRef* mesh_ref = get_registry().try_get<MeshRef>(node.get_entity());
+    if (mesh_ref == nullptr) return;
+
+    glm::dmat4 world = node.get_transformation_matrix();
+
+    for (uint32_t i = 0; i < mesh_ref->mesh_count; i++)
+    {
+        const Mesh& mesh = mesh_ref->meshes[i];
+        uint32_t base = vertices.size();
+
+        for (const Vertex& vertex : mesh.vertices)
+        {
+            vertices.push_back(glm::dvec3(world * glm::dvec4(glm::dvec3(vertex.position), 1.0)));
+        }
+
+        for (uint32_t index : mesh.indices) indices.push_back(base + index);
+    }
+}
+
+void benchmarks::static_baking(Shader* shader)
+{
+    Registry& registry = get_registry();
+
+    // Rotated and scaled unevenly at two levels. The nodes below the root are owned by
+    // the arena, so baking destroys them and only the batch is left to draw and hit.
+    NodeArena arena;
+    Scene* root = arena.get(arena.create_scene());
+    Scene* inner = arena.get(arena.create_scene());
+
+    root->set_position(40.0, 3.0, -25.0);
+    root->set_rotation(0.4f, 1.1f, -0.3f);
+    root->set_scale(2.0f, 0.5f, 1.5f);
+
+    inner->set_position(3.0, -2.0, 5.0);
+    inner->set_rotation(-0.7f, 0.2f, 0.9f);
+    inner->set_scale(0.8f, 1.6f, 1.2f);
+    root->add_scene(inner);
+
+    Model* cube = arena.get(arena.create_model("test_cube.obj", shader));
+    cube->set_position(4.0, 1.0, 0.0);
+    cube->set_rotation(0.0f, 0.5f, 0.0f);
+    cube->set_scale(1.5f, 1.5f, 1.5f);
+    root->add_model(cube);
+
+    Model* road = arena.get(arena.create_model("road_straight.obj", shader));
+    road->set_rotation(0.0f, -0.3f, 0.2f);
+    road->set_scale(0.5f, 1.0f, 0.25f);
+    inner->add_model(road);
+
+    Model* inner_cube = arena.get(arena.create_model("test_cube.obj", shader));
+    inner_cube->set_position(-2.0, 0.0, 3.0);
+    inner_cube->set_rotation(1.2f, 0.0f, 0.4f);
+    inner->add_model(inner_cube);
+
+    // What is drawn and hit before baking
+    std::vector<glm::dvec3> expected;
+    std::vector<uint32_t> triangles;
+    append_drawn_vertices(*cube, expected, triangles);
+    append_drawn_vertices(*road, expected, triangles);
+    append_drawn_vertices(*inner_cube, expected, triangles);
+
+    AABB bounds = AABB::empty();
+    for (const glm::dvec3& vertex : expected) bounds.expand(glm::vec3(vertex));
+
+    glm::dvec3 center = glm::dvec3(bounds.get_center());
+    float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_int_distribution<size_t> pick(0, triangles.size() / 3 - 1);
+    std::uniform_real_distribution<double> weight(0.1, 1.0);
+
+    const uint32_t ray_count = 10000;
+    std::vector<glm::dvec3> origins(ray_count);
+    std::vector<glm::vec3> directions(ray_count);
+    std::vector<CollisionHit> expected_hits(ray_count);
+
+    systems::update_transforms(registry);
+
+    for (uint32_t i = 0; i < ray_count; i++)
+    {
+        // From around the subtree towards the inside of one of its triangles, away from
+        // edges where a rounding difference could turn a hit into a miss
+        size_t triangle = pick(random);
+        glm::dvec3 weights = glm::dvec3(weight(random), weight(random), weight(random));
+        weights /= weights.x + weights.y + weights.z;
+
+        glm::dvec3 point = glm::dvec3(0.0);
+        for (uint32_t corner = 0; corner < 3; corner++) point += expected[triangles[triangle * 3 + corner]] * weights[corner];
+
+        glm::vec3 offset = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+        glm::vec3 target = glm::vec3(point - center);
+
+        // Past the point, so a hit on the far side of the subtree counts too
+        origins[i] = center + glm::dvec3(offset * radius * 2.0f);
+        directions[i] = (target - offset * radius * 2.0f) * 1.5f;
+
+        collision::raycast(registry, origins[i], directions[i], 1.0f, expected_hits[i]);
+    }
+
+    root->bake_static();
+
+    if (arena.get_model_count() != 0 || arena.get_scene_count() != 1)
+        throw std::runtime_error("Static baking left nodes of the subtree behind.");
+
+    // Every vertex has to be drawn where it was, in any order
+    std::vector<glm::dvec3> baked;
+    std::vector<uint32_t> baked_triangles;
+    append_drawn_vertices(*root, baked, baked_triangles);
+
+    auto by_x = [](const glm::dvec3& a, const glm::dvec3& b) { return a.x < b.x; };
+    std::sort(baked.begin(), baked.end(), by_x);
+
+    const double tolerance = 1e-3;
+    size_t misplaced = 0;
+
+    for (const glm::dvec3& vertex : expected)
+    {
+        auto it = std::lower_bound(baked.begin(), baked.end(), vertex - glm::dvec3(tolerance), by_x);
+        bool found = false;
+
+        for (; it != baked.end() && it->x <= vertex.x + tolerance && !found; it++)
+        {
+            found = glm::length(*it - vertex) <= tolerance;
+        }
+
+        if (!found) misplaced++;
+    }
+
+    // And every ray has to hit the same point
+    systems::update_transforms(registry);
+
+    uint32_t hit_count = 0, mismatched_rays = 0;
+
+    for (uint32_t i = 0; i < ray_count; i++)
+    {
+        CollisionHit hit;
+        collision::raycast(registry, origins[i], directions[i], 1.0f, hit);
+
+        // Glancing hits on long rays move a little with rounding, so relative to the ray
+        bool moved = hit.is_hit() && glm::length(hit.point - expected_hits[i].point) > 1e-4 * glm::length(directions[i]);
+        if (hit.is_hit() != expected_hits[i].is_hit() || moved) mismatched_rays++;
+
+        hit_count += expected_hits[i].is_hit();
+    }
+
+    std::printf("static baking: %zu vertices, %zu baked, %zu misplaced, %u rays with %u hits, %u mismatched\n",
+        expected.size(), baked.size(), misplaced, ray_count, hit_count, mismatched_rays);
+
+    if (baked.size() != expected.size() || misplaced > 0 || mismatched_rays > 0)
+        throw std::runtime_error("A baked scene doesn't draw or collide like the subtree it replaced.");
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+
+#include "foliage.hpp"
+#include "shader.hpp"
+
+// Declared here so the header can come before glad
+struct GLFWwindow;
+
+// Measurements run from the command line instead of the game loop.
+namespace benchmarks
+{
+    // Scatters the foliage of `chunk_count` route chunks, once on one thread and once on
+    // every hardware thread, and prints instances per millisecond.
+    void foliage_generation(uint32_t chunk_count);
+
+    // Draws `instance_count` trees for `frames` frames, once as meshes and once as
+    // impostors, and prints the GPU cost per million instances. Needs a current GL context.
+    void foliage_rendering(const FoliageShaders& shaders, uint32_t instance_count, uint32_t frames);
+
+    // Builds collision BVHs over a grid of road tiles in both node formats and prints
+    // build time, size, and rays per second traced one at a time and in packets of four.
+    void bvh_queries(uint32_t ray_count);
+
+    // Presents `frames` empty frames in every frame pacing mode and prints the mean and
+    // deviation of the frame time and the input latency of each.
+    void frame_pacing(GLFWwindow* window, uint32_t frames);
+
+    // Runs `job_count` empty jobs, a parallel sum at several grain sizes, and a chain of
+    // dependent jobs on the job system, and prints the cost per job, the speedup over one
+    // thread and the latency of a dependency. Empty jobs are timed through a pool
+    // thread's deque and through the shared queue apart. Needs jobs::init().
+    void job_scheduling(uint32_t job_count);
+
+    // Runs `rounds` of randomly sized nested parallel_for, run_after chains, jobs waiting
+    // for the jobs they start and several threads outside the pool queuing at once, and
+    // checks every result. Throws on the first wrong one. Needs jobs::init().
+    void job_stress(uint32_t rounds);
+
+    // Draws `frames` empty frames while a texture and a mesh the size of a streamed chunk
+    // go up every few frames, once on the drawing thread and once on the upload thread,
+    // and prints the mean and worst frame time of each. Needs a current GL context.
+    void upload_spikes(GLFWwindow* window, uint32_t frames);
+
+    // Draws `draw_count` triangles a frame for `frames` frames with `shader`, which has
+    // the DrawData block, writing each draw's DrawData with glBufferSubData, through an
+    // orphaned stream buffer and through a persistent one. Prints the CPU time of
+    // writing and drawing and the whole frame time of each. Needs a current GL context.
+    void stream_buffers(GLFWwindow* window, const Shader* shader, uint32_t draw_count, uint32_t frames);
+
+    // Submits `mesh_count` small meshes with eight textures for `frames` frames, with
+    // buffers of their own, pooled but drawn one at a time, and pooled with multi-draw
+    // indirect. Prints the CPU time of submitting, the frame time and the draw calls of
+    // each. `shader` has the DrawData block, `indirect` is its indirect variant. Needs a
+    // current GL context and initializes the mesh pool itself.
+    void indirect_draws(GLFWwindow* window, Shader* shader, Shader* indirect, uint32_t mesh_count, uint32_t frames);
+
+    // Draws a forest of `instance_count` trees around a camera standing in it for
+    // `frames` frames, every instance and then culled on the GPU, and prints the frame
+    // time, how many instances survived and what testing them one by one costs the CPU.
+    // Throws if the GPU kept other counts than the CPU test. Needs a current GL context
+    // and initializes instance_culling itself.
+    void gpu_culling(const FoliageShaders& shaders, uint32_t instance_count, uint32_t frames);
+
+    // Rasterizes hilly terrain and the trees around a camera standing among them into
+    // the occlusion buffer for `frames` frames, tests `object_count` bounds scattered
+    // over the hills against it, and prints the cost of both and how many were hidden.
+    // Needs jobs::init().
+    void occlusion_culling(uint32_t object_count, uint32_t frames);
+
+    // Bakes a rotated and unevenly scaled subtree of models with `shader` and checks that
+    // every vertex is drawn where it was and that rays hit the same points as before.
+    // Throws on any difference. Needs a current GL context.
+    void static_baking(Shader* shader);
+}
@@ -0,0 +1,104 @@
+#include "bounds.hpp"
+
+#include <cfloat>
+
+#include <common.hpp>
+#include <geometric.hpp>
+#include <gtc/matrix_transform.hpp>
+
+void AABB::expand(const glm::vec3 &point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void AABB::expand(const AABB &aabb)
+{
+    min = glm::min(min, aabb.min);
+    max = glm::max(max, aabb.max);
+}
+
+glm::vec3 AABB::get_center() const
+{
+    return (min + max) * 0.5f;
+}
+
+glm::vec3 AABB::get_extents() const
+{
+    return (max - min) * 0.5f;
+}
+
+float AABB::distance_to(const glm::vec3 &point) const
+{
+    return glm::length(point - glm::clamp(point, min, max));
+}
+
+float AABB::farthest_distance_to(const glm::vec3 &point) const
+{
+    return glm::length(glm::max(glm::abs(point - min), glm::abs(point - max)));
+}
+
+AABB AABB::transformed(const glm::mat4 &matrix) const
+{
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(get_center(), 1.0f));
+    glm::vec3 extents = get_extents();
+
+    // Project the extents onto the absolute basis vectors of the matrix
+    glm::vec3 new_extents;
+    for (int i = 0; i < 3; i++)
+    {
+        new_extents[i] = glm::abs(matrix[0][i]) * extents.x
+            + glm::abs(matrix[1][i]) * extents.y
+            + glm::abs(matrix[2][i]) * extents.z;
+    }
+
+    return AABB { center - new_extents, center + new_extents };
+}
+
+AABB AABB::empty()
+{
+    return AABB { glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX), glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+}
+
+Frustum Frustum::from_matrix(const glm::mat4 &m)
+{
+    Frustum frustum;
+
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    frustum.planes[0] = row3 + row0;
+    frustum.planes[1] = row3 - row0;
+    frustum.planes[2] = row3 + row1;
+    frustum.planes[3] = row3 - row1;
+    frustum.planes[4] = row3 + row2;
+    frustum.planes[5] = row3 - row2;
+
+    for (int i = 0; i < 6; i++)
+    {
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+    }
+
+    return frustum;
+}
+
+bool Frustum::intersects(const AABB &aabb) const
+{
+    glm::vec3 center = aabb.get_center();
+    glm::vec3 extents = aabb.get_extents();
+
+    for (int i = 0; i < 6; i++)
+    {
+        glm::vec3 normal = glm::vec3(planes[i]);
+        float radius = glm::dot(extents, glm::abs(normal));
+
+        if (glm::dot(normal, center) + planes[i].w < -radius)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
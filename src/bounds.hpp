@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vec3.hpp>
+#include <vec4.hpp>
+#include <mat4x4.hpp>
+
+struct AABB
+{
+    glm::vec3 min = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 max = glm::vec3(0.0f, 0.0f, 0.0f);
+
+    void expand(const glm::vec3 &point);
+    void expand(const AABB &aabb);
+
+    glm::vec3 get_center() const;
+    glm::vec3 get_extents() const;
+
+    // Zero for points inside the box.
+    float distance_to(const glm::vec3 &point) const;
+    float farthest_distance_to(const glm::vec3 &point) const;
+
+    AABB transformed(const glm::mat4 &matrix) const;
+
+    // Returns an inverted box, so the first expand() snaps to that point.
+    static AABB empty();
+};
+
+struct Frustum
+{
+    // left, right, bottom, top, near, far. xyz is the inward normal, w the distance.
+    glm::vec4 planes[6];
+
+    static Frustum from_matrix(const glm::mat4 &view_projection);
+
+    bool intersects(const AABB &aabb) const;
+};
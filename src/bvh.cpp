@@ -0,0 +1,692 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include <common.hpp>
+#include <geometric.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_SSE
+#include <emmintrin.h>
+#endif
+
+// Past this depth nodes are halved instead of split by cost, which bounds the depth of
+// any tree well below the traversal stack
+static const uint32_t MAX_SAH_DEPTH = 64;
+static const uint32_t TRAVERSAL_STACK = 128;
+
+static_assert(sizeof(BVHNode) == 32, "BVH nodes should stay two per cache line");
+static_assert(sizeof(QuantizedBVHNode) == 16, "Quantized BVH nodes should stay four per cache line");
+
+static const uint32_t QUANTIZED_COUNT_SHIFT = 28;
+static const uint32_t QUANTIZED_FIRST_MASK = (1u << QUANTIZED_COUNT_SHIFT) - 1;
+
+static float surface_area(const glm::vec3& min, const glm::vec3& max)
+{
+    glm::vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+/* #region build */
+
+void TriangleBVH::add_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const glm::mat4& matrix)
+{
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        glm::vec3 a = glm::vec3(matrix * glm::vec4(vertices[indices[i]].position, 1.0f));
+        glm::vec3 b = glm::vec3(matrix * glm::vec4(vertices[indices[i + 1]].position, 1.0f));
+        glm::vec3 c = glm::vec3(matrix * glm::vec4(vertices[indices[i + 2]].position, 1.0f));
+
+        triangles.push_back(Triangle { a, b - a, c - a });
+        triangle_ids.push_back(triangle_ids.size());
+    }
+}
+
+void TriangleBVH::build(BVHFormat format)
+{
+    this->format = format;
+
+    nodes.clear();
+    quantized_nodes.clear();
+    bounds = AABB::empty();
+
+    if (triangles.empty()) return;
+
+    if (format == BVH_QUANTIZED && triangles.size() > QUANTIZED_FIRST_MASK)
+    {
+        throw std::runtime_error("Too many triangles for a quantized BVH.");
+    }
+
+    std::vector<AABB> triangle_bounds(triangles.size());
+    std::vector<glm::vec3> centroids(triangles.size());
+
+    for (size_t i = 0; i < triangles.size(); i++)
+    {
+        const Triangle& triangle = triangles[i];
+
+        AABB box = AABB::empty();
+        box.expand(triangle.v0);
+        box.expand(triangle.v0 + triangle.edge1);
+        box.expand(triangle.v0 + triangle.edge2);
+
+        triangle_bounds[i] = box;
+        centroids[i] = box.get_center();
+        bounds.expand(box);
+    }
+
+    // A binary tree never has more than twice as many nodes as leaves
+    nodes.reserve(triangles.size() * 2);
+    nodes.push_back(BVHNode { bounds.min, 0, bounds.max, (uint32_t) triangles.size() });
+
+    split(0, 0, triangle_bounds, centroids);
+
+    if (format == BVH_QUANTIZED) quantize();
+}
+
+void TriangleBVH::split(uint32_t node_index, uint32_t depth, std::vector<AABB>& triangle_bounds, std::vector<glm::vec3>& centroids)
+{
+    uint32_t first = nodes[node_index].first;
+    uint32_t count = nodes[node_index].count;
+
+    if (count <= 1) return;
+
+    AABB centroid_bounds = AABB::empty();
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        centroid_bounds.expand(centroids[i]);
+    }
+
+    // Binned surface area heuristic: the chance of a ray hitting a child is the ratio of
+    // its area to the parent's, so a split costs the triangles of each side weighted by
+    // their area
+    float best_cost = FLT_MAX;
+    int best_axis = -1;
+    uint32_t best_bin = 0;
+
+    auto bin_of = [&](const glm::vec3& centroid, int axis) {
+        float extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+        uint32_t bin = (uint32_t) ((centroid[axis] - centroid_bounds.min[axis]) / extent * SAH_BINS);
+        return std::min(bin, SAH_BINS - 1);
+    };
+
+    if (depth < MAX_SAH_DEPTH)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (centroid_bounds.max[axis] <= centroid_bounds.min[axis]) continue;
+
+            AABB bin_bounds[SAH_BINS];
+            uint32_t bin_counts[SAH_BINS] = {};
+
+            for (uint32_t b = 0; b < SAH_BINS; b++) bin_bounds[b] = AABB::empty();
+
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                uint32_t bin = bin_of(centroids[i], axis);
+                bin_counts[bin]++;
+                bin_bounds[bin].expand(triangle_bounds[i]);
+            }
+
+            // Right sides swept from the end, left sides on the way back
+            float right_areas[SAH_BINS - 1];
+            uint32_t right_counts[SAH_BINS - 1];
+
+            AABB right = AABB::empty();
+            uint32_t right_count = 0;
+
+            for (uint32_t b = SAH_BINS - 1; b > 0; b--)
+            {
+                right.expand(bin_bounds[b]);
+                right_count += bin_counts[b];
+
+                right_areas[b - 1] = right_count > 0 ? surface_area(right.min, right.max) : 0.0f;
+                right_counts[b - 1] = right_count;
+            }
+
+            AABB left = AABB::empty();
+            uint32_t left_count = 0;
+
+            for (uint32_t b = 0; b < SAH_BINS - 1; b++)
+            {
+                left.expand(bin_bounds[b]);
+                left_count += bin_counts[b];
+
+                if (left_count == 0 || right_counts[b] == 0) continue;
+
+                float cost = left_count * surface_area(left.min, left.max) + right_counts[b] * right_areas[b];
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+    }
+
+    // A node test costs about as much as a triangle test
+    float node_area = surface_area(nodes[node_index].min, nodes[node_index].max);
+    float split_cost = node_area > 0.0f ? 1.0f + best_cost / node_area : FLT_MAX;
+
+    bool too_large = count > MAX_LEAF_TRIANGLES;
+    if (!too_large && (best_axis < 0 || split_cost >= (float) count)) return;
+
+    auto swap_triangles = [&](uint32_t a, uint32_t b) {
+        std::swap(triangles[a], triangles[b]);
+        std::swap(triangle_ids[a], triangle_ids[b]);
+        std::swap(triangle_bounds[a], triangle_bounds[b]);
+        std::swap(centroids[a], centroids[b]);
+    };
+
+    uint32_t middle;
+
+    if (best_axis >= 0)
+    {
+        uint32_t i = first, j = first + count;
+        while (i < j)
+        {
+            if (bin_of(centroids[i], best_axis) <= best_bin) i++;
+            else swap_triangles(i, --j);
+        }
+
+        middle = i;
+    }
+    else
+    {
+        // Every centroid in the same place, or too deep to keep splitting by cost.
+        // Any halving is as good as another.
+        middle = first + count / 2;
+    }
+
+    uint32_t left_index = nodes.size();
+
+    for (std::pair<uint32_t, uint32_t> range : { std::make_pair(first, middle), std::make_pair(middle, first + count) })
+    {
+        AABB box = AABB::empty();
+        for (uint32_t i = range.first; i < range.second; i++) box.expand(triangle_bounds[i]);
+
+        nodes.push_back(BVHNode { box.min, range.first, box.max, range.second - range.first });
+    }
+
+    nodes[node_index].first = left_index;
+    nodes[node_index].count = 0;
+
+    split(left_index, depth + 1, triangle_bounds, centroids);
+    split(left_index + 1, depth + 1, triangle_bounds, centroids);
+}
+
+void TriangleBVH::quantize()
+{
+    glm::vec3 extent = bounds.max - bounds.min;
+
+    // The last grid step has to reach the maximum, whatever the rounding
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float scale = extent[axis] / 65535.0f;
+        while (bounds.min[axis] + 65535.0f * scale < bounds.max[axis]) scale = std::nextafter(scale, FLT_MAX);
+
+        quantize_scale[axis] = scale;
+    }
+
+    quantized_nodes.resize(nodes.size());
+
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        const BVHNode& node = nodes[i];
+        QuantizedBVHNode& quantized = quantized_nodes[i];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float scale = quantize_scale[axis];
+            float origin = bounds.min[axis];
+
+            if (scale <= 0.0f)
+            {
+                quantized.min[axis] = 0;
+                quantized.max[axis] = 0;
+                continue;
+            }
+
+            // Rounded outwards, the quantized box may only ever be larger
+            int32_t low = (int32_t) glm::clamp(std::floor((node.min[axis] - origin) / scale), 0.0f, 65535.0f);
+            int32_t high = (int32_t) glm::clamp(std::ceil((node.max[axis] - origin) / scale), 0.0f, 65535.0f);
+
+            while (low > 0 && origin + low * scale > node.min[axis]) low--;
+            while (high < 65535 && origin + high * scale < node.max[axis]) high++;
+
+            quantized.min[axis] = (uint16_t) low;
+            quantized.max[axis] = (uint16_t) high;
+        }
+
+        quantized.first_count = (node.count << QUANTIZED_COUNT_SHIFT) | node.first;
+    }
+
+    nodes.clear();
+    nodes.shrink_to_fit();
+}
+
+/* #endregion */
+
+/* #region queries */
+
+inline void TriangleBVH::load_node(uint32_t index, glm::vec3& min, glm::vec3& max, uint32_t& first, uint32_t& count) const
+{
+    if (format == BVH_FLOAT)
+    {
+        const BVHNode& node = nodes[index];
+
+        min = node.min;
+        max = node.max;
+        first = node.first;
+        count = node.count;
+        return;
+    }
+
+    const QuantizedBVHNode& node = quantized_nodes[index];
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        min[axis] = bounds.min[axis] + node.min[axis] * quantize_scale[axis];
+        max[axis] = bounds.min[axis] + node.max[axis] * quantize_scale[axis];
+    }
+
+    first = node.first_count & QUANTIZED_FIRST_MASK;
+    count = node.first_count >> QUANTIZED_COUNT_SHIFT;
+}
+
+// Distance at which the ray enters the box, FLT_MAX when it misses it before max_distance
+static float box_entry(const glm::vec3& origin, const glm::vec3& inverse_direction, const glm::vec3& min, const glm::vec3& max, float max_distance)
+{
+    glm::vec3 t0 = (min - origin) * inverse_direction;
+    glm::vec3 t1 = (max - origin) * inverse_direction;
+
+    glm::vec3 t_min = glm::min(t0, t1);
+    glm::vec3 t_max = glm::max(t0, t1);
+
+    float entry = std::max(std::max(t_min.x, t_min.y), std::max(t_min.z, 0.0f));
+    float exit = std::min(std::min(t_max.x, t_max.y), std::min(t_max.z, max_distance));
+
+    return entry <= exit ? entry : FLT_MAX;
+}
+
+// Möller-Trumbore, both sides of the triangle count
+static bool intersect_triangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& v0, const glm::vec3& edge1, const glm::vec3& edge2, float max_distance, float& distance)
+{
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+
+    if (std::abs(determinant) < 1e-12f) return false;
+
+    float inverse = 1.0f / determinant;
+    glm::vec3 s = origin - v0;
+
+    float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f) return false;
+
+    glm::vec3 q = glm::cross(s, edge1);
+
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f) return false;
+
+    float t = glm::dot(edge2, q) * inverse;
+    if (t < 0.0f || t >= max_distance) return false;
+
+    distance = t;
+    return true;
+}
+
+bool TriangleBVH::intersect(const Ray& ray, RayHit& hit) const
+{
+    if (triangles.empty()) return false;
+
+    glm::vec3 inverse_direction = 1.0f / ray.direction;
+    float max_distance = std::min(ray.max_distance, hit.distance);
+    uint32_t found = UINT32_MAX;
+
+    glm::vec3 min, max;
+    uint32_t first, count;
+
+    load_node(0, min, max, first, count);
+    float root_entry = box_entry(ray.origin, inverse_direction, min, max, max_distance);
+    if (root_entry == FLT_MAX) return false;
+
+    // Entry distances are kept with the nodes, so nodes beyond a closer hit are skipped
+    // without testing their box again
+    std::pair<uint32_t, float> stack[TRAVERSAL_STACK];
+    uint32_t stack_size = 0;
+
+    stack[stack_size++] = std::make_pair(0u, root_entry);
+
+    while (stack_size > 0)
+    {
+        std::pair<uint32_t, float> entry = stack[--stack_size];
+        if (entry.second >= max_distance) continue;
+
+        load_node(entry.first, min, max, first, count);
+
+        if (count > 0)
+        {
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                const Triangle& triangle = triangles[i];
+
+                float distance;
+                if (intersect_triangle(ray.origin, ray.direction, triangle.v0, triangle.edge1, triangle.edge2, max_distance, distance))
+                {
+                    max_distance = distance;
+                    found = i;
+                }
+            }
+
+            continue;
+        }
+
+        // Both children are tested here, so the nearer one can be visited first
+        float entries[2];
+        for (uint32_t child = 0; child < 2; child++)
+        {
+            uint32_t child_first, child_count;
+            load_node(first + child, min, max, child_first, child_count);
+            entries[child] = box_entry(ray.origin, inverse_direction, min, max, max_distance);
+        }
+
+        uint32_t closer = entries[0] <= entries[1] ? 0 : 1;
+        uint32_t further = 1 - closer;
+
+        if (entries[further] != FLT_MAX) stack[stack_size++] = std::make_pair(first + further, entries[further]);
+        if (entries[closer] != FLT_MAX) stack[stack_size++] = std::make_pair(first + closer, entries[closer]);
+    }
+
+    if (found == UINT32_MAX) return false;
+
+    const Triangle& triangle = triangles[found];
+
+    hit.distance = max_distance;
+    hit.triangle = triangle_ids[found];
+    hit.normal = glm::normalize(glm::cross(triangle.edge1, triangle.edge2));
+
+    return true;
+}
+
+#ifdef BVH_SSE
+
+// The four rays of a packet, one per lane
+struct PacketLanes
+{
+    __m128 origin[3];
+    __m128 direction[3];
+    __m128 inverse_direction[3];
+};
+
+static int packet_box_mask(const PacketLanes& lanes, const glm::vec3& min, const glm::vec3& max, __m128 max_distance)
+{
+    __m128 entry = _mm_setzero_ps();
+    __m128 exit = max_distance;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(min[axis]), lanes.origin[axis]), lanes.inverse_direction[axis]);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(max[axis]), lanes.origin[axis]), lanes.inverse_direction[axis]);
+
+        entry = _mm_max_ps(entry, _mm_min_ps(t0, t1));
+        exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+    }
+
+    return _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+}
+
+// Same test as intersect_triangle, for every lane at once. Returns the lanes that hit
+// the triangle closer than their max_distance, which is moved to the hit.
+static int packet_triangle_mask(const PacketLanes& lanes, const glm::vec3& v0, const glm::vec3& edge1, const glm::vec3& edge2, __m128& max_distance, int active)
+{
+    __m128 e1[3] = { _mm_set1_ps(edge1.x), _mm_set1_ps(edge1.y), _mm_set1_ps(edge1.z) };
+    __m128 e2[3] = { _mm_set1_ps(edge2.x), _mm_set1_ps(edge2.y), _mm_set1_ps(edge2.z) };
+    const __m128* d = lanes.direction;
+
+    __m128 p[3] = {
+        _mm_sub_ps(_mm_mul_ps(d[1], e2[2]), _mm_mul_ps(d[2], e2[1])),
+        _mm_sub_ps(_mm_mul_ps(d[2], e2[0]), _mm_mul_ps(d[0], e2[2])),
+        _mm_sub_ps(_mm_mul_ps(d[0], e2[1]), _mm_mul_ps(d[1], e2[0])),
+    };
+
+    __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1[0], p[0]), _mm_mul_ps(e1[1], p[1])), _mm_mul_ps(e1[2], p[2]));
+    __m128 absolute = _mm_andnot_ps(_mm_set1_ps(-0.0f), determinant);
+    __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+    __m128 s[3] = {
+        _mm_sub_ps(lanes.origin[0], _mm_set1_ps(v0.x)),
+        _mm_sub_ps(lanes.origin[1], _mm_set1_ps(v0.y)),
+        _mm_sub_ps(lanes.origin[2], _mm_set1_ps(v0.z)),
+    };
+
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s[0], p[0]), _mm_mul_ps(s[1], p[1])), _mm_mul_ps(s[2], p[2])), inverse);
+
+    __m128 q[3] = {
+        _mm_sub_ps(_mm_mul_ps(s[1], e1[2]), _mm_mul_ps(s[2], e1[1])),
+        _mm_sub_ps(_mm_mul_ps(s[2], e1[0]), _mm_mul_ps(s[0], e1[2])),
+        _mm_sub_ps(_mm_mul_ps(s[0], e1[1]), _mm_mul_ps(s[1], e1[0])),
+    };
+
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], q[0]), _mm_mul_ps(d[1], q[1])), _mm_mul_ps(d[2], q[2])), inverse);
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2[0], q[0]), _mm_mul_ps(e2[1], q[1])), _mm_mul_ps(e2[2], q[2])), inverse);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+
+    __m128 mask = _mm_cmpge_ps(absolute, _mm_set1_ps(1e-12f));
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmplt_ps(t, max_distance)));
+
+    // Only rays that entered the leaf, the others may pass the triangle closer than
+    // something they hit elsewhere but haven't been tested against yet
+    __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+    mask = _mm_and_ps(mask, _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(active), lane_bits), lane_bits)));
+
+    max_distance = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, max_distance));
+
+    return _mm_movemask_ps(mask);
+}
+
+void TriangleBVH::intersect(RayPacket& packet) const
+{
+    if (triangles.empty()) return;
+
+    PacketLanes lanes;
+    float max_distances[RayPacket::SIZE];
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const Ray* rays = packet.rays;
+
+        lanes.origin[axis] = _mm_setr_ps(rays[0].origin[axis], rays[1].origin[axis], rays[2].origin[axis], rays[3].origin[axis]);
+        lanes.direction[axis] = _mm_setr_ps(rays[0].direction[axis], rays[1].direction[axis], rays[2].direction[axis], rays[3].direction[axis]);
+        lanes.inverse_direction[axis] = _mm_div_ps(_mm_set1_ps(1.0f), lanes.direction[axis]);
+    }
+
+    for (uint32_t r = 0; r < RayPacket::SIZE; r++)
+    {
+        max_distances[r] = std::min(packet.rays[r].max_distance, packet.hits[r].distance);
+    }
+
+    __m128 max_distance = _mm_loadu_ps(max_distances);
+    uint32_t found[RayPacket::SIZE] = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX };
+
+    uint32_t stack[TRAVERSAL_STACK];
+    uint32_t stack_size = 0;
+
+    stack[stack_size++] = 0;
+
+    glm::vec3 min, max;
+    uint32_t first, count;
+
+    // The whole packet walks down together, a node is entered while any ray still hits it
+    while (stack_size > 0)
+    {
+        load_node(stack[--stack_size], min, max, first, count);
+
+        int active = packet_box_mask(lanes, min, max, max_distance);
+        if (active == 0) continue;
+
+        if (count > 0)
+        {
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                const Triangle& triangle = triangles[i];
+
+                int hits = packet_triangle_mask(lanes, triangle.v0, triangle.edge1, triangle.edge2, max_distance, active);
+
+                for (uint32_t r = 0; r < RayPacket::SIZE; r++)
+                {
+                    if (hits & (1 << r)) found[r] = i;
+                }
+            }
+
+            continue;
+        }
+
+        // Visit the child lying further along the first active ray last
+        int lane = 0;
+        while (!(active & (1 << lane))) lane++;
+
+        glm::vec3 direction = packet.rays[lane].direction;
+
+        glm::vec3 left_min, left_max, right_min, right_max;
+        uint32_t child_first, child_count;
+        load_node(first, left_min, left_max, child_first, child_count);
+        load_node(first + 1, right_min, right_max, child_first, child_count);
+
+        bool left_first = glm::dot(direction, (right_min + right_max) - (left_min + left_max)) >= 0.0f;
+
+        stack[stack_size++] = left_first ? first + 1 : first;
+        stack[stack_size++] = left_first ? first : first + 1;
+    }
+
+    _mm_storeu_ps(max_distances, max_distance);
+
+    for (uint32_t r = 0; r < RayPacket::SIZE; r++)
+    {
+        if (found[r] == UINT32_MAX) continue;
+
+        const Triangle& triangle = triangles[found[r]];
+        RayHit& hit = packet.hits[r];
+
+        hit.distance = max_distances[r];
+        hit.triangle = triangle_ids[found[r]];
+        hit.normal = glm::normalize(glm::cross(triangle.edge1, triangle.edge2));
+    }
+}
+
+#else
+
+void TriangleBVH::intersect(RayPacket& packet) const
+{
+    for (uint32_t r = 0; r < RayPacket::SIZE; r++)
+    {
+        intersect(packet.rays[r], packet.hits[r]);
+    }
+}
+
+#endif
+
+// Closest point on a triangle, from Ericson's Real-Time Collision Detection
+static glm::vec3 closest_point_on_triangle(const glm::vec3& point, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 ab = b - a, ac = c - a, ap = point - a;
+
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    glm::vec3 bp = point - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+    glm::vec3 cp = point - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denominator = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+void TriangleBVH::overlap_sphere(const glm::vec3& center, float radius, std::vector<SphereContact>& contacts) const
+{
+    if (triangles.empty()) return;
+
+    float radius_squared = radius * radius;
+
+    uint32_t stack[TRAVERSAL_STACK];
+    uint32_t stack_size = 0;
+
+    stack[stack_size++] = 0;
+
+    glm::vec3 min, max;
+    uint32_t first, count;
+
+    while (stack_size > 0)
+    {
+        load_node(stack[--stack_size], min, max, first, count);
+
+        glm::vec3 outside = center - glm::clamp(center, min, max);
+        if (glm::dot(outside, outside) > radius_squared) continue;
+
+        if (count == 0)
+        {
+            stack[stack_size++] = first;
+            stack[stack_size++] = first + 1;
+            continue;
+        }
+
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            const Triangle& triangle = triangles[i];
+
+            glm::vec3 point = closest_point_on_triangle(center, triangle.v0, triangle.v0 + triangle.edge1, triangle.v0 + triangle.edge2);
+            glm::vec3 offset = center - point;
+
+            float distance_squared = glm::dot(offset, offset);
+            if (distance_squared > radius_squared) continue;
+
+            float distance = std::sqrt(distance_squared);
+
+            // A centre right on the triangle is pushed out along its normal
+            glm::vec3 normal = distance > 1e-6f ? offset / distance : glm::normalize(glm::cross(triangle.edge1, triangle.edge2));
+
+            contacts.push_back(SphereContact { point, normal, radius - distance, triangle_ids[i] });
+        }
+    }
+}
+
+/* #endregion */
+
+const AABB& TriangleBVH::get_bounds() const
+{
+    return bounds;
+}
+
+uint32_t TriangleBVH::get_triangle_count() const
+{
+    return triangles.size();
+}
+
+uint32_t TriangleBVH::get_node_count() const
+{
+    return format == BVH_FLOAT ? nodes.size() : quantized_nodes.size();
+}
+
+size_t TriangleBVH::get_memory_bytes() const
+{
+    return triangles.size() * (sizeof(Triangle) + sizeof(uint32_t)) + nodes.size() * sizeof(BVHNode) + quantized_nodes.size() * sizeof(QuantizedBVHNode);
+}
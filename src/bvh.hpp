@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include <vec3.hpp>
+#include <mat4x4.hpp>
+
+#include "mesh.hpp"
+#include "bounds.hpp"
+
+struct Ray
+{
+    glm::vec3 origin;
+
+    // Doesn't have to be normalized, distances are measured in multiples of it
+    glm::vec3 direction;
+    float max_distance = FLT_MAX;
+};
+
+struct RayHit
+{
+    float distance = FLT_MAX;
+
+    // Index in the order the triangles were added, UINT32_MAX for a miss
+    uint32_t triangle = UINT32_MAX;
+
+    // Geometric normal, facing whichever way the triangle winds
+    glm::vec3 normal = glm::vec3(0.0f, 0.0f, 0.0f);
+
+    bool is_hit() const { return triangle != UINT32_MAX; }
+};
+
+// Four rays traced together, with SSE where it is available. Coherent rays, like the
+// wheels of a car or a row of pixels, share most of their way down the tree.
+struct RayPacket
+{
+    static const uint32_t SIZE = 4;
+
+    Ray rays[SIZE];
+    RayHit hits[SIZE];
+};
+
+struct SphereContact
+{
+    // Closest point of the triangle to the centre
+    glm::vec3 point;
+
+    // Pushes the sphere out of the triangle
+    glm::vec3 normal;
+    float depth;
+
+    uint32_t triangle;
+};
+
+// 32 bytes, two per cache line. The children of an inner node are stored next to each
+// other, so one index finds both.
+struct BVHNode
+{
+    glm::vec3 min;
+    uint32_t first;     // first triangle of a leaf, left child of an inner node
+    glm::vec3 max;
+    uint32_t count;     // triangles of a leaf, 0 for inner nodes
+};
+
+// 16 bytes, the bounds are rounded outwards onto a 16 bit grid over the root bounds.
+struct QuantizedBVHNode
+{
+    uint16_t min[3];
+    uint16_t max[3];
+
+    // Triangle count in the top 4 bits, first triangle or left child in the rest
+    uint32_t first_count;
+};
+
+enum BVHFormat
+{
+    BVH_FLOAT,
+    BVH_QUANTIZED,
+};
+
+// Bounding volume hierarchy over the triangles of one or more meshes, for collision
+// queries on the CPU. It is built once, in mesh space, and placed in the world by the
+// transforms of whatever uses it, see collision.hpp.
+class TriangleBVH
+{
+public:
+    // Leaves of the quantized format can't hold more
+    static const uint32_t MAX_LEAF_TRIANGLES = 15;
+
+    static const uint32_t SAH_BINS = 16;
+
+    TriangleBVH() = default;
+
+    // Copies the triangles of a mesh, transformed by `matrix`. Call before build().
+    void add_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const glm::mat4& matrix = glm::mat4(1.0f));
+
+    // Splits the triangles with the surface area heuristic.
+    void build(BVHFormat format = BVH_FLOAT);
+
+    // Both only ever move a hit closer, so rays can be traced against several BVHs one
+    // after another. Return whether this BVH was hit.
+    bool intersect(const Ray& ray, RayHit& hit) const;
+    void intersect(RayPacket& packet) const;
+
+    // Appends a contact for every triangle closer than `radius` to `center`.
+    void overlap_sphere(const glm::vec3& center, float radius, std::vector<SphereContact>& contacts) const;
+
+    const AABB& get_bounds() const;
+    uint32_t get_triangle_count() const;
+    uint32_t get_node_count() const;
+    size_t get_memory_bytes() const;
+
+private:
+    // Edges are precomputed for the intersection test
+    struct Triangle
+    {
+        glm::vec3 v0;
+        glm::vec3 edge1;
+        glm::vec3 edge2;
+    };
+
+    BVHFormat format = BVH_FLOAT;
+    AABB bounds = AABB::empty();
+
+    std::vector<Triangle> triangles;        // in leaf order after build()
+    std::vector<uint32_t> triangle_ids;     // original index of every triangle
+
+    std::vector<BVHNode> nodes;
+    std::vector<QuantizedBVHNode> quantized_nodes;
+    glm::vec3 quantize_scale;
+
+    void split(uint32_t node_index, uint32_t depth, std::vector<AABB>& triangle_bounds, std::vector<glm::vec3>& centroids);
+    void quantize();
+
+    void load_node(uint32_t index, glm::vec3& min, glm::vec3& max, uint32_t& first, uint32_t& count) const;
+};
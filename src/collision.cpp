@@ -0,0 +1,106 @@
+#include "collision.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <mat3x3.hpp>
+#include <geometric.hpp>
+#include <matrix.hpp>
+
+#include "systems.hpp"
+
+static const ComponentMask COLLISION_COMPONENTS = COMPONENT_WORLD_TRANSFORM | COMPONENT_COLLIDER | COMPONENT_BOUNDS;
+
+// Normals are moved with the inverse transpose, so they stay perpendicular under scale
+static glm::vec3 to_world_normal(const glm::dmat4& inverse_world, const glm::vec3& normal)
+{
+    return glm::normalize(glm::mat3(glm::transpose(glm::dmat3(inverse_world))) * normal);
+}
+
+bool collision::raycast(Registry& registry, const glm::dvec3& origin, const glm::vec3& direction, float max_distance, CollisionHit& hit)
+{
+    Ray world_ray { glm::vec3(origin), direction, std::min(max_distance, hit.distance) };
+    glm::vec3 inverse_direction = 1.0f / direction;
+    bool found = false;
+
+    registry.for_each_archetype(COLLISION_COMPONENTS, [&](Archetype& archetype) {
+        for (size_t i = 0; i < archetype.size(); i++)
+        {
+            const TriangleBVH* bvh = archetype.colliders[i].bvh;
+            if (bvh == nullptr) continue;
+
+            const WorldTransform& world = archetype.world_transforms[i];
+            const AABB& bounds = systems::get_world_bounds(archetype.bounds[i], world);
+
+            // Slab test against the world bounds before paying for the inverse matrix
+            glm::vec3 t0 = (bounds.min - world_ray.origin) * inverse_direction;
+            glm::vec3 t1 = (bounds.max - world_ray.origin) * inverse_direction;
+            glm::vec3 t_min = glm::min(t0, t1), t_max = glm::max(t0, t1);
+
+            float entry = std::max(std::max(t_min.x, t_min.y), std::max(t_min.z, 0.0f));
+            float exit = std::min(std::min(t_max.x, t_max.y), std::min(t_max.z, world_ray.max_distance));
+            if (entry > exit) continue;
+
+            // The ray keeps its parameter in mesh space, so distances compare across entities
+            glm::dmat4 inverse_world = glm::inverse(world.matrix);
+
+            Ray local_ray;
+            local_ray.origin = glm::vec3(inverse_world * glm::dvec4(origin, 1.0));
+            local_ray.direction = glm::vec3(glm::dmat3(inverse_world) * glm::dvec3(direction));
+            local_ray.max_distance = world_ray.max_distance;
+
+            RayHit local_hit;
+            if (!bvh->intersect(local_ray, local_hit)) continue;
+
+            world_ray.max_distance = local_hit.distance;
+            found = true;
+
+            hit.entity = archetype.entities[i];
+            hit.distance = local_hit.distance;
+            hit.point = origin + glm::dvec3(direction) * (double) local_hit.distance;
+            hit.normal = to_world_normal(inverse_world, local_hit.normal);
+        }
+    });
+
+    return found;
+}
+
+void collision::overlap_sphere(Registry& registry, const glm::dvec3& center, float radius, std::vector<CollisionContact>& contacts)
+{
+    glm::vec3 world_center = glm::vec3(center);
+    std::vector<SphereContact> local_contacts;
+
+    registry.for_each_archetype(COLLISION_COMPONENTS, [&](Archetype& archetype) {
+        for (size_t i = 0; i < archetype.size(); i++)
+        {
+            const TriangleBVH* bvh = archetype.colliders[i].bvh;
+            if (bvh == nullptr) continue;
+
+            const WorldTransform& world = archetype.world_transforms[i];
+            if (systems::get_world_bounds(archetype.bounds[i], world).distance_to(world_center) > radius) continue;
+
+            glm::dmat4 inverse_world = glm::inverse(world.matrix);
+
+            // A scaled sphere is an ellipsoid, so the query uses the sphere around it and
+            // the contacts are checked again in world space
+            glm::dmat3 basis = glm::dmat3(world.matrix);
+            double min_scale = std::min(glm::length(basis[0]), std::min(glm::length(basis[1]), glm::length(basis[2])));
+            if (min_scale <= 0.0) continue;
+
+            local_contacts.clear();
+            bvh->overlap_sphere(glm::vec3(inverse_world * glm::dvec4(center, 1.0)), (float) (radius / min_scale), local_contacts);
+
+            for (const SphereContact& local : local_contacts)
+            {
+                glm::dvec3 point = glm::dvec3(world.matrix * glm::dvec4(glm::dvec3(local.point), 1.0));
+                glm::dvec3 offset = center - point;
+                double distance = glm::length(offset);
+
+                if (distance > radius) continue;
+
+                glm::vec3 normal = distance > 1e-6 ? glm::vec3(offset / distance) : to_world_normal(inverse_world, local.normal);
+                contacts.push_back(CollisionContact { archetype.entities[i], point, normal, (float) (radius - distance) });
+            }
+        }
+    });
+}
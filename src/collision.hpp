@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cfloat>
+#include <vector>
+
+#include <vec3.hpp>
+
+#include "ecs.hpp"
+#include "bvh.hpp"
+
+struct CollisionHit
+{
+    Entity entity = NULL_ENTITY;
+    glm::dvec3 point = glm::dvec3(0.0, 0.0, 0.0);
+    glm::vec3 normal = glm::vec3(0.0f, 0.0f, 0.0f);
+    float distance = FLT_MAX;
+
+    bool is_hit() const { return !entity.is_null(); }
+};
+
+struct CollisionContact
+{
+    Entity entity;
+    glm::dvec3 point;
+
+    // Pushes the sphere out of the entity
+    glm::vec3 normal;
+    float depth;
+};
+
+// Queries against every entity with a Collider. Each BVH stays in its mesh's space, the
+// queries are moved into it through the entity's world matrix, so one BVH serves every
+// instance of a mesh. Positions are in world space, in double like the transforms.
+namespace collision
+{
+    // Closest hit along `direction`, which doesn't have to be normalized: distances are
+    // measured in multiples of it. Returns whether anything was hit.
+    bool raycast(Registry& registry, const glm::dvec3& origin, const glm::vec3& direction, float max_distance, CollisionHit& hit);
+
+    // Appends a contact for every triangle closer than `radius` to `center`.
+    void overlap_sphere(Registry& registry, const glm::dvec3& center, float radius, std::vector<CollisionContact>& contacts);
+}
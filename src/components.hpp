@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vec3.hpp>
+#include <mat4x4.hpp>
+
+#include "entity.hpp"
+#include "transform.hpp"
+#include "bounds.hpp"
+#include "mesh.hpp"
+#include "instance_batch.hpp"
+
+typedef uint32_t ComponentMask;
+
+enum ComponentBit : ComponentMask
+{
+    COMPONENT_TRANSFORM = 1 << 0,
+    COMPONENT_WORLD_TRANSFORM = 1 << 1,
+    COMPONENT_HIERARCHY = 1 << 2,
+    COMPONENT_MESH_REF = 1 << 3,
+    COMPONENT_BOUNDS = 1 << 4,
+    COMPONENT_VELOCITY = 1 << 5,
+    COMPONENT_INSTANCES = 1 << 6,
+    COMPONENT_COLLIDER = 1 << 7,
+    COMPONENT_INTERPOLATION = 1 << 8,
+    COMPONENT_OCCLUDER = 1 << 9,
+};
+
+class TriangleBVH;
+
+// Groups of geometry that are culled at their own distance, see DrawDistances
+enum DrawClass : uint8_t
+{
+    DRAW_PROPS,
+    DRAW_ROAD,
+    DRAW_FOLIAGE,
+    DRAW_TERRAIN,
+    DRAW_CLASS_COUNT,
+};
+
+// Transform (see transform.hpp) holds the local scale, rotation and position.
+
+struct WorldTransform
+{
+    // Double like Transform::position, see systems::cull for how it reaches the GPU
+    glm::dmat4 matrix = glm::dmat4(1.0);
+
+    // Tick of the last transform system pass that rewrote the matrix.
+    uint64_t updated_tick = 0;
+    bool dirty = true;
+};
+
+struct Hierarchy
+{
+    Entity parent = NULL_ENTITY;
+    uint32_t depth = 0;
+};
+
+struct MeshRef
+{
+    const Mesh* meshes = nullptr;
+    uint32_t mesh_count = 0;
+    Shader* shader = nullptr;
+
+    // Replaces the texture of every mesh when non-zero
+    uint32_t texture = 0;
+
+    DrawClass draw_class = DRAW_PROPS;
+};
+
+struct Bounds
+{
+    AABB local;
+
+    // Float, which is still within millimetres far from the origin. Plenty for culling.
+    AABB world;
+
+    uint64_t updated_tick = 0;
+};
+
+struct Velocity
+{
+    glm::vec3 linear = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 angular = glm::vec3(0.0f, 0.0f, 0.0f);
+};
+
+// Transform of the entity before the last simulation tick. Entities that have it are
+// drawn between that and their current Transform, see systems::interpolate.
+struct Interpolation
+{
+    Transform previous;
+    float alpha = 1.0f;
+};
+
+struct Instances
+{
+    const InstanceBatch* batch = nullptr;
+    Shader* shader = nullptr;
+
+    DrawClass draw_class = DRAW_FOLIAGE;
+};
+
+// Triangles to collide with in the entity's own space, usually shared by every entity
+// using the same mesh. See collision.hpp.
+struct Collider
+{
+    const TriangleBVH* bvh = nullptr;
+};
+
+// Solid boxes inside the entity in its own space, that the occlusion culler draws in
+// place of its meshes. With Instances they stand in for each instance instead.
+struct Occluder
+{
+    const std::vector<AABB>* boxes = nullptr;
+
+    // Only occludes up to this far from the camera, where it still covers enough pixels
+    float distance = 0.0f;
+};
@@ -0,0 +1,38 @@
+#include "draw_distance.hpp"
+
+#include <algorithm>
+
+#include <trigonometric.hpp>
+#include <gtc/matrix_transform.hpp>
+
+float DrawDistances::get(DrawClass draw_class) const
+{
+    return std::min(class_distances[draw_class], fog_end);
+}
+
+void DrawDistances::scale_to(float distance)
+{
+    float factor = distance / fog_end;
+
+    fog_start *= factor;
+    fog_end = distance;
+
+    for (float& class_distance : class_distances)
+    {
+        class_distance *= factor;
+    }
+}
+
+glm::mat4 DrawDistances::get_projection(float aspect) const
+{
+    // Anything past the far plane is further away than fog_end, so it would be fully fogged
+    return glm::perspective(glm::radians(45.0f), aspect, 0.1f, fog_end);
+}
+
+void DrawDistances::set_fog(Shader* shader) const
+{
+    shader->use();
+    shader->set_vec3("fog_color", fog_color);
+    shader->set_float("fog_start", fog_start);
+    shader->set_float("fog_end", fog_end);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vec3.hpp>
+#include <mat4x4.hpp>
+
+#include "components.hpp"
+#include "shader.hpp"
+
+// How far the camera sees. Fog thickens from fog_start and hides everything at fog_end,
+// which is also the far plane, so nothing past it is ever submitted. Each class of
+// geometry can stop earlier than that: small props are lost in the fog long before the
+// terrain, and they are the first thing to give up when frames get slow.
+struct DrawDistances
+{
+    glm::vec3 fog_color = glm::vec3(0.6f, 0.64f, 0.68f);
+    float fog_start = 60.0f;
+    float fog_end = 150.0f;
+
+    // Indexed by DrawClass: props, road, foliage, terrain
+    float class_distances[DRAW_CLASS_COUNT] = { 100.0f, 150.0f, 120.0f, 150.0f };
+
+    // Never further than fog_end.
+    float get(DrawClass draw_class) const;
+
+    // Moves fog_end to `distance` and every other distance with it, keeping their ratios.
+    void scale_to(float distance);
+
+    glm::mat4 get_projection(float aspect) const;
+
+    // Sets the fog_color, fog_start and fog_end uniforms.
+    void set_fog(Shader* shader) const;
+};
@@ -0,0 +1,195 @@
+#include "ecs.hpp"
+
+#include <stdexcept>
+#include <type_traits>
+
+// Calls function(bit, column) for every component column of an archetype.
+template<typename F> static void visit_columns(Archetype& archetype, F function)
+{
+    function(COMPONENT_TRANSFORM, archetype.transforms);
+    function(COMPONENT_WORLD_TRANSFORM, archetype.world_transforms);
+    function(COMPONENT_HIERARCHY, archetype.hierarchies);
+    function(COMPONENT_MESH_REF, archetype.mesh_refs);
+    function(COMPONENT_BOUNDS, archetype.bounds);
+    function(COMPONENT_VELOCITY, archetype.velocities);
+    function(COMPONENT_INSTANCES, archetype.instances);
+    function(COMPONENT_COLLIDER, archetype.colliders);
+    function(COMPONENT_INTERPOLATION, archetype.interpolations);
+    function(COMPONENT_OCCLUDER, archetype.occluders);
+}
+
+Entity Registry::create(ComponentMask mask)
+{
+    uint32_t index;
+
+    if (!free_indices.empty())
+    {
+        index = free_indices.back();
+        free_indices.pop_back();
+    }
+    else
+    {
+        index = records.size();
+        records.push_back(EntityRecord {});
+    }
+
+    EntityRecord& record = records[index];
+    Entity entity = Entity { index, record.generation };
+
+    uint32_t archetype_index = get_or_create_archetype(mask);
+    Archetype& archetype = archetypes[archetype_index];
+
+    record.archetype = archetype_index;
+    record.row = archetype.size();
+    record.alive = true;
+
+    archetype.entities.push_back(entity);
+    visit_columns(archetype, [&](ComponentMask bit, auto& column) {
+        if (mask & bit) column.emplace_back();
+    });
+
+    entity_count++;
+
+    return entity;
+}
+
+void Registry::destroy(Entity entity)
+{
+    if (!is_alive(entity))
+        throw std::runtime_error("Tried destroying an entity that is not alive.");
+
+    EntityRecord& record = records[entity.index];
+    remove_row(record.archetype, record.row);
+
+    record.alive = false;
+    record.generation++;
+    free_indices.push_back(entity.index);
+
+    entity_count--;
+}
+
+void Registry::reserve(ComponentMask mask, size_t count)
+{
+    Archetype& archetype = archetypes[get_or_create_archetype(mask)];
+    size_t capacity = archetype.size() + count;
+
+    archetype.entities.reserve(capacity);
+    visit_columns(archetype, [&](ComponentMask bit, auto& column) {
+        if (mask & bit) column.reserve(capacity);
+    });
+}
+
+bool Registry::is_alive(Entity entity) const
+{
+    return entity.index < records.size()
+        && records[entity.index].alive
+        && records[entity.index].generation == entity.generation;
+}
+
+ComponentMask Registry::get_mask(Entity entity) const
+{
+    return archetypes[get_record(entity).archetype].mask;
+}
+
+size_t Registry::get_entity_count() const
+{
+    return entity_count;
+}
+
+uint64_t Registry::get_tick() const
+{
+    return tick;
+}
+
+void Registry::advance_tick()
+{
+    tick++;
+}
+
+const Registry::EntityRecord& Registry::get_record(Entity entity) const
+{
+    if (!is_alive(entity))
+        throw std::runtime_error("Tried accessing an entity that is not alive.");
+
+    return records[entity.index];
+}
+
+uint32_t Registry::get_or_create_archetype(ComponentMask mask)
+{
+    for (size_t i = 0; i < archetypes.size(); i++)
+    {
+        if (archetypes[i].mask == mask) return i;
+    }
+
+    archetypes.emplace_back();
+    archetypes.back().mask = mask;
+
+    return archetypes.size() - 1;
+}
+
+void Registry::move_entity(Entity entity, ComponentMask new_mask)
+{
+    EntityRecord& record = records[entity.index];
+
+    uint32_t old_index = record.archetype;
+    uint32_t old_row = record.row;
+    uint32_t new_index = get_or_create_archetype(new_mask);
+
+    Archetype& old_archetype = archetypes[old_index];
+    Archetype& new_archetype = archetypes[new_index];
+    ComponentMask old_mask = old_archetype.mask;
+
+    new_archetype.entities.push_back(entity);
+
+    // Copy the components both masks share, default construct the new ones
+    visit_columns(new_archetype, [&](ComponentMask bit, auto& column) {
+        if (!(new_mask & bit)) return;
+
+        if (old_mask & bit)
+        {
+            visit_columns(old_archetype, [&](ComponentMask old_bit, auto& old_column) {
+                if constexpr (std::is_same_v<decltype(column), decltype(old_column)>)
+                {
+                    if (old_bit == bit) column.push_back(old_column[old_row]);
+                }
+            });
+        }
+        else
+        {
+            column.emplace_back();
+        }
+    });
+
+    remove_row(old_index, old_row);
+
+    record.archetype = new_index;
+    record.row = new_archetype.size() - 1;
+}
+
+void Registry::remove_row(uint32_t archetype_index, uint32_t row)
+{
+    Archetype& archetype = archetypes[archetype_index];
+    size_t last = archetype.size() - 1;
+
+    // Swap the last row into the hole so the columns stay dense
+    if (row != last)
+    {
+        Entity moved = archetype.entities[last];
+        archetype.entities[row] = moved;
+        records[moved.index].row = row;
+    }
+    archetype.entities.pop_back();
+
+    visit_columns(archetype, [&](ComponentMask bit, auto& column) {
+        if (!(archetype.mask & bit)) return;
+
+        if (row != last) column[row] = column[last];
+        column.pop_back();
+    });
+}
+
+Registry& get_registry()
+{
+    static Registry registry;
+    return registry;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+
+#include "components.hpp"
+
+// Every distinct component mask gets its own archetype. Components are stored as
+// parallel arrays, so a system only touches the columns it asks for. Columns of
+// components that aren't part of the mask are left empty.
+struct Archetype
+{
+    ComponentMask mask = 0;
+
+    std::vector<Entity> entities;
+
+    std::vector<Transform> transforms;
+    std::vector<WorldTransform> world_transforms;
+    std::vector<Hierarchy> hierarchies;
+    std::vector<MeshRef> mesh_refs;
+    std::vector<Bounds> bounds;
+    std::vector<Velocity> velocities;
+    std::vector<Instances> instances;
+    std::vector<Collider> colliders;
+    std::vector<Interpolation> interpolations;
+    std::vector<Occluder> occluders;
+
+    size_t size() const { return entities.size(); }
+
+    bool has(ComponentMask components) const { return (mask & components) == components; }
+};
+
+template<typename T> struct ComponentTraits;
+
+template<> struct ComponentTraits<Transform>
+{
+    static const ComponentMask bit = COMPONENT_TRANSFORM;
+    static std::vector<Transform>& column(Archetype& a) { return a.transforms; }
+};
+
+template<> struct ComponentTraits<WorldTransform>
+{
+    static const ComponentMask bit = COMPONENT_WORLD_TRANSFORM;
+    static std::vector<WorldTransform>& column(Archetype& a) { return a.world_transforms; }
+};
+
+template<> struct ComponentTraits<Hierarchy>
+{
+    static const ComponentMask bit = COMPONENT_HIERARCHY;
+    static std::vector<Hierarchy>& column(Archetype& a) { return a.hierarchies; }
+};
+
+template<> struct ComponentTraits<MeshRef>
+{
+    static const ComponentMask bit = COMPONENT_MESH_REF;
+    static std::vector<MeshRef>& column(Archetype& a) { return a.mesh_refs; }
+};
+
+template<> struct ComponentTraits<Bounds>
+{
+    static const ComponentMask bit = COMPONENT_BOUNDS;
+    static std::vector<Bounds>& column(Archetype& a) { return a.bounds; }
+};
+
+template<> struct ComponentTraits<Velocity>
+{
+    static const ComponentMask bit = COMPONENT_VELOCITY;
+    static std::vector<Velocity>& column(Archetype& a) { return a.velocities; }
+};
+
+template<> struct ComponentTraits<Instances>
+{
+    static const ComponentMask bit = COMPONENT_INSTANCES;
+    static std::vector<Instances>& column(Archetype& a) { return a.instances; }
+};
+
+template<> struct ComponentTraits<Collider>
+{
+    static const ComponentMask bit = COMPONENT_COLLIDER;
+    static std::vector<Collider>& column(Archetype& a) { return a.colliders; }
+};
+
+template<> struct ComponentTraits<Interpolation>
+{
+    static const ComponentMask bit = COMPONENT_INTERPOLATION;
+    static std::vector<Interpolation>& column(Archetype& a) { return a.interpolations; }
+};
+
+template<> struct ComponentTraits<Occluder>
+{
+    static const ComponentMask bit = COMPONENT_OCCLUDER;
+    static std::vector<Occluder>& column(Archetype& a) { return a.occluders; }
+};
+
+class Registry
+{
+public:
+    Entity create(ComponentMask mask);
+    void destroy(Entity entity);
+
+    // Grows the archetype of `mask` so `count` more entities fit without reallocating.
+    void reserve(ComponentMask mask, size_t count);
+
+    bool is_alive(Entity entity) const;
+    ComponentMask get_mask(Entity entity) const;
+
+    template<typename T> bool has(Entity entity) const;
+    template<typename T> T& get(Entity entity);
+    template<typename T> T* try_get(Entity entity);
+    template<typename T> void add(Entity entity, const T& component = T());
+    template<typename T> void remove(Entity entity);
+
+    // Calls function(Archetype&) for every non-empty archetype containing all of `components`.
+    template<typename F> void for_each_archetype(ComponentMask components, F function);
+
+    // Calls function(Entity, Ts&...) for every entity that has all of Ts.
+    template<typename... Ts, typename F> void each(F function);
+
+    size_t get_entity_count() const;
+
+    uint64_t get_tick() const;
+    void advance_tick();
+
+private:
+    struct EntityRecord
+    {
+        uint32_t generation = 0;
+        uint32_t archetype = 0;
+        uint32_t row = 0;
+        bool alive = false;
+    };
+
+    // Deque so references to archetypes survive new masks being added mid-iteration
+    std::deque<Archetype> archetypes;
+    std::vector<EntityRecord> records;
+    std::vector<uint32_t> free_indices;
+
+    size_t entity_count = 0;
+    uint64_t tick = 1;
+
+    const EntityRecord& get_record(Entity entity) const;
+
+    uint32_t get_or_create_archetype(ComponentMask mask);
+    void move_entity(Entity entity, ComponentMask new_mask);
+    void remove_row(uint32_t archetype, uint32_t row);
+};
+
+Registry& get_registry();
+
+/* #region template implementations */
+
+template<typename T> bool Registry::has(Entity entity) const
+{
+    return (get_mask(entity) & ComponentTraits<T>::bit) != 0;
+}
+
+template<typename T> T& Registry::get(Entity entity)
+{
+    const EntityRecord& record = get_record(entity);
+    return ComponentTraits<T>::column(archetypes[record.archetype])[record.row];
+}
+
+template<typename T> T* Registry::try_get(Entity entity)
+{
+    if (!is_alive(entity) || !has<T>(entity)) return nullptr;
+
+    return &get<T>(entity);
+}
+
+template<typename T> void Registry::add(Entity entity, const T& component)
+{
+    if (!has<T>(entity))
+    {
+        move_entity(entity, get_mask(entity) | ComponentTraits<T>::bit);
+    }
+
+    get<T>(entity) = component;
+}
+
+template<typename T> void Registry::remove(Entity entity)
+{
+    if (has<T>(entity))
+    {
+        move_entity(entity, get_mask(entity) & ~ComponentTraits<T>::bit);
+    }
+}
+
+template<typename F> void Registry::for_each_archetype(ComponentMask components, F function)
+{
+    for (size_t i = 0; i < archetypes.size(); i++)
+    {
+        if (archetypes[i].has(components) && archetypes[i].size() > 0)
+        {
+            function(archetypes[i]);
+        }
+    }
+}
+
+template<typename... Ts, typename F> void Registry::each(F function)
+{
+    for_each_archetype((ComponentTraits<Ts>::bit | ... | 0), [&](Archetype& archetype) {
+        for (size_t row = 0; row < archetype.size(); row++)
+        {
+            function(archetype.entities[row], ComponentTraits<Ts>::column(archetype)[row]...);
+        }
+    });
+}
+
+/* #endregion */
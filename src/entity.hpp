@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+struct Entity
+{
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool is_null() const { return index == UINT32_MAX; }
+
+    bool operator == (const Entity& e) const { return index == e.index && generation == e.generation; }
+    bool operator != (const Entity& e) const { return !(*this == e); }
+};
+
+const Entity NULL_ENTITY = Entity {};
@@ -0,0 +1,55 @@
+#include "fixed_timestep.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+FixedTimestep::FixedTimestep(double tick_rate, uint32_t max_ticks_per_frame)
+{
+    if (tick_rate <= 0.0) throw std::runtime_error("Tick rate has to be positive.");
+
+    this->tick_seconds = 1.0 / tick_rate;
+    this->max_ticks_per_frame = max_ticks_per_frame;
+}
+
+uint32_t FixedTimestep::advance(double frame_seconds)
+{
+    accumulator += frame_seconds;
+
+    uint32_t ticks = 0;
+    while (accumulator >= tick_seconds && ticks < max_ticks_per_frame)
+    {
+        accumulator -= tick_seconds;
+        ticks++;
+    }
+
+    if (accumulator >= tick_seconds)
+    {
+        // Keep the fraction, so interpolation doesn't jump after the stall
+        double dropped = tick_seconds * std::floor(accumulator / tick_seconds);
+        dropped_seconds += dropped;
+        accumulator -= dropped;
+    }
+
+    tick_count += ticks;
+    return ticks;
+}
+
+double FixedTimestep::get_tick_seconds() const
+{
+    return tick_seconds;
+}
+
+float FixedTimestep::get_alpha() const
+{
+    return (float) (accumulator / tick_seconds);
+}
+
+uint64_t FixedTimestep::get_tick_count() const
+{
+    return tick_count;
+}
+
+double FixedTimestep::get_dropped_seconds() const
+{
+    return dropped_seconds;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// Runs the simulation at a fixed rate, however often frames are drawn. Real time is
+// collected in an accumulator and spent in whole ticks, what is left over is how far
+// the frame lies between the last two ticks, for interpolating what is drawn.
+class FixedTimestep
+{
+public:
+    FixedTimestep(double tick_rate = 60.0, uint32_t max_ticks_per_frame = 8);
+
+    // Adds the real time the last frame took and returns how many ticks to run now.
+    // After a stall of more than max_ticks_per_frame ticks the rest is dropped, so the
+    // simulation falls behind real time once instead of every frame from then on.
+    uint32_t advance(double frame_seconds);
+
+    double get_tick_seconds() const;
+
+    // Fraction of a tick that has passed since the last one, 0 to 1
+    float get_alpha() const;
+
+    uint64_t get_tick_count() const;
+    double get_dropped_seconds() const;
+
+private:
+    double tick_seconds;
+    uint32_t max_ticks_per_frame;
+
+    double accumulator = 0.0;
+    uint64_t tick_count = 0;
+    double dropped_seconds = 0.0;
+};
@@ -0,0 +1,239 @@
+#include "foliage.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <common.hpp>
+#include <geometric.hpp>
+#include <gtc/constants.hpp>
+
+const char* const TREE_CROWN_TEXTURE = "branch_2.png";
+const char* const TREE_TRUNK_TEXTURE = "wood_1.jpg";
+const char* const GROUND_TEXTURE = "grass_1.png";
+
+const float DENSITY_CELL_SIZE = 40.0f;
+
+// Of the trunk, the part that is measured for its width, and how much of that width
+// stays solid. Of the crown, the fraction of its bounds taken as solid.
+const float TRUNK_BASE_FRACTION = 0.1f;
+const float TRUNK_SOLID_FRACTION = 0.6f;
+const float CROWN_SOLID_FRACTION = 0.4f;
+
+static uint32_t hash(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    uint32_t h = a * 0x9E3779B9u;
+    h = (h ^ b) * 0x85EBCA6Bu;
+    h = (h ^ (h >> 15) ^ c) * 0xC2B2AE35u;
+    h = (h ^ (h >> 13) ^ d) * 0x27D4EB2Fu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Uniform in [0, 1)
+static float to_unit(uint32_t h)
+{
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+static const MeshData* find_mesh(const ModelSource& source, const char* texture_name)
+{
+    for (const MeshData& mesh : source.meshes)
+    {
+        if (mesh.texture_name == texture_name) return &mesh;
+    }
+
+    return nullptr;
+}
+
+ModelSource foliage::extract_tree(const ModelSource& source)
+{
+    const MeshData* crown = find_mesh(source, TREE_CROWN_TEXTURE);
+    const MeshData* trunk = find_mesh(source, TREE_TRUNK_TEXTURE);
+
+    if (crown == nullptr || trunk == nullptr)
+    {
+        throw std::runtime_error("Foliage source model has no tree to extract.");
+    }
+
+    AABB trunk_bounds = AABB::empty();
+    for (const Vertex& vertex : trunk->vertices) trunk_bounds.expand(vertex.position);
+
+    glm::vec3 offset = -trunk_bounds.get_center();
+    offset.y = 0.0f;
+
+    ModelSource tree;
+    tree.bounds = AABB::empty();
+
+    for (const MeshData* mesh : { crown, trunk })
+    {
+        MeshData moved = *mesh;
+
+        for (Vertex& vertex : moved.vertices)
+        {
+            vertex.position += offset;
+            tree.bounds.expand(vertex.position);
+        }
+
+        tree.meshes.push_back(std::move(moved));
+    }
+
+    return tree;
+}
+
+std::vector<AABB> foliage::get_occluders(const ModelSource& tree)
+{
+    const MeshData* crown = find_mesh(tree, TREE_CROWN_TEXTURE);
+    const MeshData* trunk = find_mesh(tree, TREE_TRUNK_TEXTURE);
+
+    if (crown == nullptr || trunk == nullptr) throw std::runtime_error("Tree has no crown or trunk to occlude with.");
+
+    AABB crown_bounds = AABB::empty();
+    for (const Vertex& vertex : crown->vertices) crown_bounds.expand(vertex.position);
+
+    AABB trunk_bounds = AABB::empty();
+    for (const Vertex& vertex : trunk->vertices) trunk_bounds.expand(vertex.position);
+
+    // The wood has branches too, only the base tells how thick the trunk is
+    float base_top = trunk_bounds.min.y + (trunk_bounds.max.y - trunk_bounds.min.y) * TRUNK_BASE_FRACTION;
+
+    AABB base = AABB::empty();
+    for (const Vertex& vertex : trunk->vertices)
+    {
+        if (vertex.position.y <= base_top) base.expand(vertex.position);
+    }
+
+    glm::vec3 trunk_center = base.get_center();
+    glm::vec3 trunk_extents = base.get_extents() * TRUNK_SOLID_FRACTION;
+
+    AABB solid_trunk {
+        glm::vec3(trunk_center.x - trunk_extents.x, trunk_bounds.min.y, trunk_center.z - trunk_extents.z),
+        glm::vec3(trunk_center.x + trunk_extents.x, crown_bounds.min.y, trunk_center.z + trunk_extents.z),
+    };
+
+    glm::vec3 crown_center = crown_bounds.get_center();
+    glm::vec3 crown_extents = crown_bounds.get_extents() * CROWN_SOLID_FRACTION;
+
+    return { solid_trunk, AABB { crown_center - crown_extents, crown_center + crown_extents } };
+}
+
+ModelSource foliage::extract_ground(const ModelSource& source)
+{
+    const MeshData* ground = find_mesh(source, GROUND_TEXTURE);
+
+    if (ground == nullptr)
+    {
+        throw std::runtime_error("Foliage source model has no ground plane.");
+    }
+
+    ModelSource plane;
+    plane.meshes.push_back(*ground);
+    plane.bounds = AABB::empty();
+
+    for (const Vertex& vertex : ground->vertices) plane.bounds.expand(vertex.position);
+
+    return plane;
+}
+
+float foliage::get_density(const glm::vec2& position, uint32_t seed)
+{
+    glm::vec2 cell = position / DENSITY_CELL_SIZE;
+    glm::vec2 base = glm::floor(cell);
+    glm::vec2 t = cell - base;
+    t = t * t * (3.0f - 2.0f * t);
+
+    int32_t x = (int32_t) base.x, y = (int32_t) base.y;
+
+    auto corner = [&](int32_t dx, int32_t dy) {
+        return to_unit(hash(seed, (uint32_t) (x + dx), (uint32_t) (y + dy), 0));
+    };
+
+    float value = glm::mix(glm::mix(corner(0, 0), corner(1, 0), t.x), glm::mix(corner(0, 1), corner(1, 1), t.x), t.y);
+
+    // Push the noise apart into groves and clearings
+    float d = glm::clamp((value - 0.25f) * 2.0f, 0.0f, 1.0f);
+    return d * d * (3.0f - 2.0f * d);
+}
+
+static float distance_to_centerline(const std::vector<glm::vec3>& centerline, const glm::vec2& point)
+{
+    float best = INFINITY;
+
+    for (size_t i = 0; i + 1 < centerline.size(); i++)
+    {
+        glm::vec2 a(centerline[i].x, centerline[i].z);
+        glm::vec2 b(centerline[i + 1].x, centerline[i + 1].z);
+
+        glm::vec2 segment = b - a;
+        float length_sq = glm::dot(segment, segment);
+        float t = length_sq > 0.0f ? glm::clamp(glm::dot(point - a, segment) / length_sq, 0.0f, 1.0f) : 0.0f;
+
+        best = std::min(best, glm::length(point - (a + segment * t)));
+    }
+
+    return best;
+}
+
+std::vector<Instance> foliage::scatter(const RouteChunk& chunk, const std::vector<glm::vec3>& nearby_centerline, const FoliageConfig& config,
+    const AABB& prototype_bounds, AABB& bounds)
+{
+    std::vector<Instance> instances;
+
+    float radius = std::max(std::max(-prototype_bounds.min.x, prototype_bounds.max.x), std::max(-prototype_bounds.min.z, prototype_bounds.max.z));
+    uint32_t lanes = (uint32_t) std::ceil((config.band_width - config.road_clearance) / config.spacing);
+
+    for (size_t i = 0; i + 1 < chunk.centerline.size(); i++)
+    {
+        glm::vec3 a = chunk.centerline[i];
+        glm::vec3 b = chunk.centerline[i + 1];
+        float start = chunk.centerline_distance[i];
+        float end = chunk.centerline_distance[i + 1];
+
+        if (end <= start) continue;
+
+        glm::vec3 tangent = glm::normalize(b - a);
+        glm::vec3 normal(-tangent.z, 0.0f, tangent.x);
+
+        // Steps are numbered by route distance, not per chunk
+        for (uint32_t step = (uint32_t) std::ceil(start / config.spacing); step * config.spacing < end; step++)
+        {
+            glm::vec3 center = a + (b - a) * ((step * config.spacing - start) / (end - start));
+
+            for (uint32_t lane = 0; lane < lanes * 2; lane++)
+            {
+                float side = lane < lanes ? -1.0f : 1.0f;
+                uint32_t column = lane % lanes;
+
+                float offset = config.road_clearance + (column + to_unit(hash(config.seed, step, lane, 1))) * config.spacing;
+                float along = (to_unit(hash(config.seed, step, lane, 2)) - 0.5f) * config.spacing;
+
+                if (offset > config.band_width) continue;
+
+                glm::vec3 position = center + normal * (side * offset) + tangent * along;
+                glm::vec2 flat(position.x, position.z);
+
+                if (to_unit(hash(config.seed, step, lane, 3)) >= config.density * get_density(flat, config.seed)) continue;
+
+                // Curves bring other parts of the road closer than the lane offset
+                if (distance_to_centerline(nearby_centerline, flat) < config.road_clearance) continue;
+
+                Instance instance;
+                instance.position = position - chunk.origin;
+                instance.yaw = to_unit(hash(config.seed, step, lane, 4)) * glm::two_pi<float>();
+                instance.scale = glm::mix(config.min_scale, config.max_scale, to_unit(hash(config.seed, step, lane, 5)));
+                instance.rank = to_unit(hash(config.seed, step, lane, 6));
+
+                instances.push_back(instance);
+
+                bounds.expand(instance.position + glm::vec3(-radius, prototype_bounds.min.y, -radius) * instance.scale);
+                bounds.expand(instance.position + glm::vec3(radius, prototype_bounds.max.y, radius) * instance.scale);
+            }
+        }
+    }
+
+    std::sort(instances.begin(), instances.end(), [](const Instance& a, const Instance& b) {
+        return a.rank < b.rank;
+    });
+
+    return instances;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vec2.hpp>
+
+#include "route.hpp"
+#include "bounds.hpp"
+#include "mesh_registry.hpp"
+#include "instance_batch.hpp"
+#include "shader.hpp"
+
+struct FoliageConfig
+{
+    uint32_t seed = 7;
+
+    // Candidates are jittered on a grid of this size along and across the road
+    float spacing = 4.0f;
+
+    // Band beside the road, measured from the centre line
+    float road_clearance = 7.0f;
+    float band_width = 24.0f;
+
+    // Chance of a candidate being kept where the density map is 1
+    float density = 0.6f;
+
+    float min_scale = 0.7f;
+    float max_scale = 1.3f;
+
+    // Distance based thinning, see InstanceBatch
+    float thin_start = 60.0f;
+    float thin_end = 250.0f;
+    float min_fraction = 0.15f;
+
+    // View distances over which trees crossfade to their impostors
+    float impostor_start = 50.0f;
+    float impostor_end = 65.0f;
+
+    // Trees closer than this to the camera are occluders, see foliage::get_occluders
+    float occluder_distance = 40.0f;
+};
+
+struct FoliageShaders
+{
+    Shader* meshes;
+    Shader* impostors;
+
+    // Renders the tree into the impostor atlas once, when the first trees are uploaded
+    Shader* impostor_bake;
+};
+
+// Procedural roadside trees. Placement only depends on the seed, the route distance
+// of each candidate and the road near it, so every chunk comes out the same whichever
+// thread builds it and however the route is split into chunks, as long as chunks are
+// longer than the band beside the road.
+namespace foliage
+{
+    const char* const SOURCE_MODEL = "grass_trees_1.obj";
+
+    // The first tree of the grass and trees tile, moved so its trunk stands on the origin.
+    ModelSource extract_tree(const ModelSource& source);
+
+    // Boxes inside the tree from extract_tree() for occlusion culling: the trunk, and
+    // the core of the crown where the leaves are dense enough to hide what is behind.
+    std::vector<AABB> get_occluders(const ModelSource& tree);
+
+    // The grass ground plane of the tile.
+    ModelSource extract_ground(const ModelSource& source);
+
+    // Density map in [0, 1], smooth noise that clusters trees into groves and clearings.
+    float get_density(const glm::vec2& position, uint32_t seed);
+
+    // Instances beside the road of `chunk`, in the chunk's space. They keep clear of
+    // `nearby_centerline`, see Route::get_nearby_centerline(), so bends near the ends of
+    // the chunk don't put trees on the next chunk's road. `bounds` is grown to contain
+    // every instance of a prototype with `prototype_bounds`.
+    std::vector<Instance> scatter(const RouteChunk& chunk, const std::vector<glm::vec3>& nearby_centerline, const FoliageConfig& config,
+        const AABB& prototype_bounds, AABB& bounds);
+}
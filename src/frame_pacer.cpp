@@ -0,0 +1,202 @@
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+#ifdef ISWIN
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+static const char* PRESENT_MODE_NAMES[] = { "vsync", "adaptive", "uncapped" };
+
+// How quickly the work estimate forgets a slow frame, per frame
+const double WORK_ESTIMATE_DECAY = 0.98;
+
+static std::chrono::steady_clock::duration to_duration(double seconds)
+{
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+static double to_milliseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+FramePacer::FramePacer(const FramePacingConfig& config)
+{
+#ifdef ISWIN
+    // Sleeps are otherwise rounded up to the 15.6 ms default timer tick
+    timeBeginPeriod(1);
+#endif
+
+    timings.reserve(FRAME_HISTORY);
+
+    frame_start = Clock::now();
+    last_present = frame_start;
+
+    set_config(config);
+}
+
+FramePacer::~FramePacer()
+{
+#ifdef ISWIN
+    timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::set_config(const FramePacingConfig& config)
+{
+    this->config = config;
+
+    apply_present_mode();
+
+    period = Clock::duration::zero();
+    if (config.max_fps > 0.0)
+    {
+        period = to_duration(1.0 / config.max_fps);
+    }
+    else if (config.low_latency && present_mode != PRESENT_UNCAPPED)
+    {
+        // Starting late only helps if we know when the next refresh is
+        double refresh_rate = config.refresh_rate > 0.0 ? config.refresh_rate : get_refresh_rate();
+        if (refresh_rate > 0.0) period = to_duration(1.0 / refresh_rate);
+    }
+
+    deadline = Clock::now();
+
+    // Timings of the old mode would only blur the new one's
+    timings.clear();
+    next_timing = 0;
+    stats = FrameTimeStats();
+}
+
+const FramePacingConfig& FramePacer::get_config() const
+{
+    return config;
+}
+
+void FramePacer::apply_present_mode()
+{
+    present_mode = config.present_mode;
+
+    if (present_mode == PRESENT_ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+    {
+        present_mode = PRESENT_VSYNC;
+    }
+
+    // A negative interval is what the tear extensions take for adaptive
+    glfwSwapInterval(present_mode == PRESENT_VSYNC ? 1 : present_mode == PRESENT_ADAPTIVE ? -1 : 0);
+}
+
+void FramePacer::begin_frame()
+{
+    if (config.low_latency && period != Clock::duration::zero())
+    {
+        // Aim to finish right at the next slot, with a spin's worth of margin
+        deadline += period;
+        wait_until(deadline - work_estimate - to_duration(config.spin_seconds));
+    }
+
+    frame_start = Clock::now();
+}
+
+void FramePacer::end_frame()
+{
+    // Without this the driver lets the CPU run a few frames ahead, and each of them
+    // waits in the queue with input that gets older
+    if (config.low_latency) glFinish();
+
+    Clock::time_point now = Clock::now();
+
+    Clock::duration work = now - frame_start;
+    work_estimate = std::max(work, std::chrono::duration_cast<Clock::duration>(work_estimate * WORK_ESTIMATE_DECAY));
+
+    FrameTiming timing { to_milliseconds(now - last_present), to_milliseconds(work) };
+    last_present = now;
+
+    if (timings.size() < FRAME_HISTORY) timings.push_back(timing);
+    else timings[next_timing] = timing;
+    next_timing = (next_timing + 1) % FRAME_HISTORY;
+
+    update_stats();
+
+    if (!config.low_latency && period != Clock::duration::zero())
+    {
+        deadline += period;
+        wait_until(deadline);
+    }
+}
+
+void FramePacer::wait_until(Clock::time_point time)
+{
+    Clock::time_point now = Clock::now();
+
+    // After a slow frame start counting again from now, instead of rushing the
+    // following frames to catch up
+    if (deadline < now - period)
+    {
+        deadline = now;
+        return;
+    }
+
+    Clock::duration spin = to_duration(config.spin_seconds);
+    if (time - now > spin) std::this_thread::sleep_for(time - now - spin);
+
+    while (Clock::now() < time)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void FramePacer::update_stats()
+{
+    double sum = 0.0, latency_sum = 0.0, worst = 0.0;
+    for (const FrameTiming& timing : timings)
+    {
+        sum += timing.frame_ms;
+        latency_sum += timing.latency_ms;
+        worst = std::max(worst, timing.frame_ms);
+    }
+
+    double mean = sum / timings.size();
+
+    double variance = 0.0;
+    for (const FrameTiming& timing : timings)
+    {
+        variance += (timing.frame_ms - mean) * (timing.frame_ms - mean);
+    }
+
+    stats.mean_ms = mean;
+    stats.deviation_ms = std::sqrt(variance / timings.size());
+    stats.worst_ms = worst;
+    stats.input_latency_ms = latency_sum / timings.size();
+}
+
+const FrameTimeStats& FramePacer::get_stats() const
+{
+    return stats;
+}
+
+PresentMode FramePacer::get_present_mode() const
+{
+    return present_mode;
+}
+
+const char* FramePacer::get_mode_name(PresentMode mode)
+{
+    return PRESENT_MODE_NAMES[mode];
+}
+
+double FramePacer::get_refresh_rate()
+{
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = monitor != nullptr ? glfwGetVideoMode(monitor) : nullptr;
+
+    return mode != nullptr && mode->refreshRate > 0 ? mode->refreshRate : 0.0;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+enum PresentMode
+{
+    PRESENT_VSYNC,
+
+    // Vsync that tears instead of waiting a whole extra refresh when a frame is late.
+    // Falls back to plain vsync where the driver can't do it.
+    PRESENT_ADAPTIVE,
+
+    PRESENT_UNCAPPED,
+};
+
+struct FramePacingConfig
+{
+    PresentMode present_mode = PRESENT_VSYNC;
+
+    // Frame limit on top of the present mode, 0 for none
+    double max_fps = 0.0;
+
+    // Waits before input is read instead of after present: a frame starts as late as
+    // it can while still being done by the next refresh or limiter slot, and the driver
+    // isn't allowed to queue frames ahead of the GPU. Input is then as fresh as it can
+    // be when the frame shows.
+    bool low_latency = false;
+
+    // The limiter sleeps until this long before a frame is due and spins the rest,
+    // sleeping alone overshoots by up to a scheduler tick
+    double spin_seconds = 0.002;
+
+    // Of the display, for starting frames late in low latency mode. Looked up on the
+    // primary monitor when 0, which only works on the main thread.
+    double refresh_rate = 0.0;
+};
+
+// Over the last FRAME_HISTORY frames
+struct FrameTimeStats
+{
+    // Present to present
+    double mean_ms = 0.0;
+    double deviation_ms = 0.0;
+    double worst_ms = 0.0;
+
+    // From begin_frame() returning, when input is read, to the frame being handed to
+    // the driver, or finished by the GPU in low latency mode
+    double input_latency_ms = 0.0;
+};
+
+// Decides when frames start and how they are presented.
+class FramePacer
+{
+public:
+    static const uint32_t FRAME_HISTORY = 240;
+
+    // Sets the swap interval of the current context.
+    FramePacer(const FramePacingConfig& config);
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator = (const FramePacer&) = delete;
+
+    void set_config(const FramePacingConfig& config);
+    const FramePacingConfig& get_config() const;
+
+    // Call first thing in a frame, before polling input.
+    void begin_frame();
+
+    // Call right after glfwSwapBuffers.
+    void end_frame();
+
+    const FrameTimeStats& get_stats() const;
+
+    // The mode that is actually used, after any fallback
+    PresentMode get_present_mode() const;
+
+    static const char* get_mode_name(PresentMode mode);
+
+    // Of the primary monitor, 0 when unknown. Main thread only.
+    static double get_refresh_rate();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct FrameTiming
+    {
+        double frame_ms;
+        double latency_ms;
+    };
+
+    FramePacingConfig config;
+    PresentMode present_mode;
+
+    // Zero when nothing limits the frame rate but the present mode itself
+    Clock::duration period;
+    Clock::time_point deadline;
+
+    Clock::time_point frame_start;
+    Clock::time_point last_present;
+
+    // Decaying peak of how long frames take from begin_frame() to end_frame()
+    Clock::duration work_estimate = Clock::duration::zero();
+
+    std::vector<FrameTiming> timings;
+    uint32_t next_timing = 0;
+    FrameTimeStats stats;
+
+    void apply_present_mode();
+    void wait_until(Clock::time_point time);
+    void update_stats();
+};
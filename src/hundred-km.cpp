@@ -1,20 +1,60 @@
 #include <iostream>
+#include <string>
 #include <stdexcept>
+#include <chrono>
+#include <memory>
+#include <vector>
 
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
+#include <mat3x3.hpp>
 #include <gtc/matrix_transform.hpp>
 
 #include "player.hpp"
 #include "scene.hpp"
+#include "node_arena.hpp"
+#include "level.hpp"
+#include "world_streamer.hpp"
+#include "terrain.hpp"
+#include "draw_distance.hpp"
+#include "fixed_timestep.hpp"
+#include "frame_pacer.hpp"
+#include "render_thread.hpp"
+#include "jobs.hpp"
+#include "asset_loader.hpp"
+#include "upload_thread.hpp"
+#include "stream_buffer.hpp"
+#include "mesh_pool.hpp"
+#include "instance_culling.hpp"
+#include "occlusion_culler.hpp"
+#include "residency.hpp"
+#include "stats_overlay.hpp"
+#include "benchmarks.hpp"
+#include "path_helper.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+const char* WINDOW_TITLE = "Hundred Kilometers";
+
 GLFWwindow* window;
 
 glm::mat4 projection;
 
+DrawDistances draw_distances;
+
+double tick_rate = 60.0;
+
+FramePacingConfig pacing_config;
+
+bool use_upload_thread = false;
+
+bool use_indirect = true;
+
+bool use_gpu_culling = false;
+
+bool use_occlusion = true;
+
 int WIDTH = 800, HEIGHT = 600;
 
 double delta_time = 0;
@@ -30,11 +70,21 @@ void process_input(GLFWwindow *window)
 void init_glfw()
 {
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    window = glfwCreateWindow(WIDTH, HEIGHT, "Hundred Kilometers", NULL, NULL);
+    // 4.5 has persistent stream buffers and multi-draw indirect, 4.3 only the latter, and
+    // 3.3 draws everything one mesh at a time
+    const int versions[][2] = { { 4, 5 }, { 4, 3 }, { 3, 3 } };
+
+    for (const int* version : versions)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+
+        window = glfwCreateWindow(WIDTH, HEIGHT, WINDOW_TITLE, NULL, NULL);
+        if (window != NULL) break;
+    }
+
     if (window == NULL)
     {
         glfwTerminate();
@@ -49,11 +99,11 @@ void init_glfw()
     }
 
     glViewport(0, 0, WIDTH, HEIGHT);
-    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* window, int width, int height) {
-        glViewport(0, 0, width, height);
+    // The viewport follows with the next frame drawn, on whichever thread owns the context
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int width, int height) {
         WIDTH = width;
         HEIGHT = height;
-        projection = glm::perspective(glm::radians(45.0f), ((float) WIDTH) / ((float) HEIGHT), 0.1f, 100.0f);
+        projection = draw_distances.get_projection(((float) WIDTH) / ((float) HEIGHT));
     });
 
     glfwSetCursorPosCallback(window, player::handle_mouse);
@@ -66,66 +116,434 @@ void init_glfw()
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    init_glfw();  
+    // Prints a binary level as text, so levels can be diffed
+    if (argc == 3 && std::string(argv[1]) == "--dump-level")
+    {
+        level::export_text(level::load(argv[2]), std::cout);
+        return 0;
+    }
+
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        // GPU memory budget for textures and mesh buffers, in MB
+        if (std::string(argv[i]) == "--vram-budget") residency::set_budget(std::stoull(argv[i + 1]) * 1024 * 1024);
+
+        // Fog end in metres, every class is culled proportionally closer or further
+        if (std::string(argv[i]) == "--draw-distance") draw_distances.scale_to(std::stof(argv[i + 1]));
+
+        // Simulation ticks per second, frames are drawn as often as they can be
+        if (std::string(argv[i]) == "--tick-rate") tick_rate = std::stod(argv[i + 1]);
+
+        // vsync, adaptive or uncapped
+        if (std::string(argv[i]) == "--present")
+        {
+            std::string mode = argv[i + 1];
+
+            if (mode == "vsync") pacing_config.present_mode = PRESENT_VSYNC;
+            else if (mode == "adaptive") pacing_config.present_mode = PRESENT_ADAPTIVE;
+            else if (mode == "uncapped") pacing_config.present_mode = PRESENT_UNCAPPED;
+            else throw std::runtime_error("Unknown present mode `" + mode + "`.");
+        }
+
+        // Frame limit on top of the present mode
+        if (std::string(argv[i]) == "--max-fps") pacing_config.max_fps = std::stod(argv[i + 1]);
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--low-latency") pacing_config.low_latency = true;
+
+        // Buffers and textures go up through a shared context on their own thread
+        if (std::string(argv[i]) == "--upload-thread") use_upload_thread = true;
+
+        // Draws every mesh on its own like on GL 3.3, even if the context can do better
+        if (std::string(argv[i]) == "--no-indirect") use_indirect = false;
+
+        // Instances of foliage are culled by a compute pass instead of all being drawn
+        if (std::string(argv[i]) == "--gpu-culling") use_gpu_culling = true;
+
+        // Everything in the frustum is drawn, even what the terrain and trees hide
+        if (std::string(argv[i]) == "--no-occlusion") use_occlusion = false;
+    }
 
     stbi_set_flip_vertically_on_load(true);  
 
+    if (argc == 2 && std::string(argv[1]) == "--bench-bvh")
+    {
+        benchmarks::bvh_queries(1000000);
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--bench-jobs")
+    {
+        jobs::init();
+        benchmarks::job_scheduling(1000000);
+        benchmarks::job_stress(500);
+
+        jobs::shutdown();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--bench-foliage")
+    {
+        benchmarks::foliage_generation(200);
+
+        init_glfw();
+        Shader foliage_shader("resources/shader/foliage.vert", "resources/shader/foliage.frag");
+        Shader impostor_shader("resources/shader/impostor.vert", "resources/shader/impostor.frag");
+        Shader impostor_bake_shader("resources/shader/impostor_bake.vert", "resources/shader/foliage.frag");
+
+        benchmarks::foliage_rendering(FoliageShaders { &foliage_shader, &impostor_shader, &impostor_bake_shader }, 1000000, 30);
+
+        glfwTerminate();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--bench-gpu-culling")
+    {
+        init_glfw();
+        Shader foliage_shader("resources/shader/foliage.vert", "resources/shader/foliage.frag");
+        Shader impostor_shader("resources/shader/impostor.vert", "resources/shader/impostor.frag");
+        Shader impostor_bake_shader("resources/shader/impostor_bake.vert", "resources/shader/foliage.frag");
+
+        benchmarks::gpu_culling(FoliageShaders { &foliage_shader, &impostor_shader, &impostor_bake_shader }, 250000, 30);
+
+        glfwTerminate();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--bench-occlusion")
+    {
+        jobs::init();
+        benchmarks::occlusion_culling(20000, 200);
+
+        jobs::shutdown();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--check-bake")
+    {
+        init_glfw();
+
+        Shader shader("resources/shader/test.vert", "resources/shader/test.frag");
+        benchmarks::static_baking(&shader);
+
+        glfwTerminate();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--bench-uploads")
+    {
+        init_glfw();
+        benchmarks::upload_spikes(window, 300);
+
+        glfwTerminate();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--bench-stream-buffers")
+    {
+        init_glfw();
+
+        Shader shader("resources/shader/test.vert", "resources/shader/test.frag");
+        benchmarks::stream_buffers(window, &shader, 5000, 200);
+
+        glfwTerminate();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--bench-indirect")
+    {
+        init_glfw();
+
+        Shader shader("resources/shader/test.vert", "resources/shader/test.frag");
+        Shader indirect_shader("resources/shader/test_indirect.vert", "resources/shader/test.frag");
+        benchmarks::indirect_draws(window, &shader, &indirect_shader, 5000, 100);
+
+        glfwTerminate();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--bench-pacing")
+    {
+        init_glfw();
+        benchmarks::frame_pacing(window, 300);
+
+        glfwTerminate();
+        return 0;
+    }
+
+    init_glfw();  
+    jobs::init();
+
+    // Before any mesh is created, they all go into the pool
+    if (use_indirect) mesh_pool::init(64 * 1024 * 1024, 32 * 1024 * 1024);
+
+    // Before any instance batch is created, as batches decide when they are
+    if (use_gpu_culling && !instance_culling::init())
+    {
+        throw std::runtime_error("GPU culling needs an OpenGL 4.3 context.");
+    }
+
+    std::unique_ptr<UploadThread> upload_thread;
+    if (use_upload_thread)
+    {
+        upload_thread = std::make_unique<UploadThread>(window);
+        asset_loader::set_upload_thread(upload_thread.get());
+    }
+
     Shader shader("resources/shader/test.vert", "resources/shader/test.frag");
+    Shader foliage_shader("resources/shader/foliage.vert", "resources/shader/foliage.frag");
+    Shader impostor_shader("resources/shader/impostor.vert", "resources/shader/impostor.frag");
+    Shader impostor_bake_shader("resources/shader/impostor_bake.vert", "resources/shader/foliage.frag");
+    Shader terrain_shader("resources/shader/terrain.vert", "resources/shader/test.frag");
 
-    Scene world;
-    world.set_position(0.0f, -1.0f, 0.0f);
+    std::vector<Shader*> shaders = { &shader, &foliage_shader, &impostor_shader, &terrain_shader };
 
-    Model* test_model = new Model("test_cube.obj", &shader);
-    Model* test_model2 = new Model("car.obj",  &shader);
-    Model* road = new Model("road_curve_90deg_20m.obj", &shader);
-    Model* grass_trees = new Model("grass_trees_1.obj", &shader);
+    std::unique_ptr<Shader> indirect_shader;
+    if (mesh_pool::is_enabled())
+    {
+        indirect_shader = std::make_unique<Shader>("resources/shader/test_indirect.vert", "resources/shader/test.frag");
+        shader.indirect_variant = indirect_shader.get();
+        shaders.push_back(indirect_shader.get());
+    }
 
-    world.add_model(test_model);
-    world.add_model(test_model2);
-    world.add_model(road);
-    world.add_model(grass_trees);
+    for (Shader* s : shaders)
+    {
+        draw_distances.set_fog(s);
+    }
+
+    shader.set_uniform_block("DrawData", DRAW_DATA_BINDING);
+
+    NodeArena world_arena;
 
-    test_model->set_position(0.0f, 2.0f, 0.0f);
-    test_model2->set_position(0.0f, 0.5f, 0.0f);
+    Scene* world = world_arena.get(world_arena.create_scene());
+    world->set_position(0.0f, -1.0f, 0.0f);
+
+    LevelData start_level = level::load(LEVEL_PATH + "start.hkl");
+
+    // Loading screen, the level's assets load in the background and are uploaded here
+    // while the window keeps responding
+    std::shared_ptr<LoadGroup> loading = std::make_shared<LoadGroup>();
+    asset_loader::start(loading, asset_loader::load_level(start_level, loading));
+
+    while (!loading->is_done())
+    {
+        glfwWaitEventsTimeout(0.01);
+        if (glfwWindowShouldClose(window)) loading->cancel();
+
+        jobs::run_gl_jobs();
+        if (upload_thread) upload_thread->publish();
+
+        std::string title = std::string(WINDOW_TITLE) + " - loading " + std::to_string((int) (loading->get_progress() * 100.0f)) + "%";
+        glfwSetWindowTitle(window, title.c_str());
+    }
+
+    loading->rethrow_error();
+
+    if (loading->is_cancelled())
+    {
+        if (upload_thread) upload_thread->stop();
+        jobs::shutdown();
+        glfwTerminate();
+        return 0;
+    }
+
+    std::vector<Spatial*> level_nodes = level::instantiate(start_level, world_arena, world, &shader);
+
+    int32_t test_cube = start_level.find_node("test_cube");
+    if (test_cube >= 0)
+    {
+        level_nodes[test_cube]->set_velocity(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, glm::radians(-10.0f), 0.0f));
+    }
+
+    // The streamed road carries on from where the start level's curve ends
+    StreamingConfig streaming_config;
+    streaming_config.origin = glm::vec3(15.0f, 0.0f, -10.0f);
+    streaming_config.heading = glm::vec3(1.0f, 0.0f, 0.0f);
+    streaming_config.view_distance = draw_distances.get(DRAW_ROAD);
+
+    WorldStreamer streamer(world, &shader, FoliageShaders { &foliage_shader, &impostor_shader, &impostor_bake_shader }, streaming_config);
+    Terrain terrain(world, &terrain_shader, streamer.get_route(), TerrainConfig());
+    terrain.set_draw_distance(draw_distances.get(DRAW_TERRAIN));
+    streamer.set_upload_thread(upload_thread.get());
 
     player::init(WIDTH, HEIGHT);
     
-    projection = glm::perspective(glm::radians(45.0f), ((float) WIDTH) / ((float) HEIGHT), 0.1f, 100.0f);
+    projection = draw_distances.get_projection(((float) WIDTH) / ((float) HEIGHT));
     
-    double last_frame = 0;
-    while (!glfwWindowShouldClose(window))
-    {
-        // Poll and process events
-        glfwPollEvents();
-        process_input(window);
+    FixedTimestep timestep(tick_rate);
+
+    // Runs on the render thread, everything it reads is in the packet or only changes
+    // in run_synchronized()
+    glm::ivec2 viewport_size = glm::ivec2(WIDTH, HEIGHT);
+
+    // Grows when a frame has more draws than fit
+    StreamBuffer draw_data(GL_UNIFORM_BUFFER, 256 * 1024);
+
+    std::unique_ptr<OcclusionCuller> occlusion;
+    if (use_occlusion) occlusion = std::make_unique<OcclusionCuller>();
+
+    RenderThread render_thread(window, pacing_config, [&](const FramePacket& packet) {
+        if (packet.screen_size != viewport_size)
+        {
+            viewport_size = packet.screen_size;
+            glViewport(0, 0, viewport_size.x, viewport_size.y);
+        }
 
         // Clear color and depth buffers
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClearColor(draw_distances.fog_color.x, draw_distances.fog_color.y, draw_distances.fog_color.z, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Drawin stuff
-        test_model->set_rotation(test_model->get_rotation() + glm::vec3(0, glm::radians(-10.0f) * delta_time, 0));
-
-        shader.use();
-        shader.set_mat4("view", player::get_view_matrix());
-        shader.set_mat4("projection", projection); // Find a way to only update projection matrix when window size changes
-        shader.set_vec2("screen_size", glm::vec2(WIDTH, HEIGHT));
+        // Only the rotation of the view goes to the GPU, positions arrive camera relative
+        // in every draw's model_view
+        glm::mat4 view_rotation = glm::mat4(glm::mat3(glm::dmat3(packet.view)));
+
+        for (Shader* s : shaders)
+        {
+            s->use();
+            s->set_mat4("view", view_rotation);
+            s->set_mat4("projection", packet.projection);
+            s->set_vec2("screen_size", glm::vec2(packet.screen_size));
+        }
+
+        instance_culling::begin_frame(packet.projection);
+        systems::submit(packet.draw_list, draw_data);
+        terrain.draw(packet.projection, packet.view);
+    });
 
-        player::update(window, delta_time);
-        world.draw_scene();
+    double last_frame = glfwGetTime();
+    while (!glfwWindowShouldClose(window))
+    {
+        // Waits while PACKET_COUNT frames are in flight, and in low latency mode for the
+        // last moment the frame can start
+        FramePacket& packet = render_thread.begin_packet();
 
-        // Swap buffers
-        glfwSwapBuffers(window);
+        // Poll and process events
+        glfwPollEvents();
+        process_input(window);
+        packet.input_time = std::chrono::steady_clock::now();
 
-        // Calculate delta time
-        float current_frame = glfwGetTime();
+        // Calculate delta time, in double as the time since startup only grows
+        double current_frame = glfwGetTime();
         delta_time = current_frame - last_frame;
         last_frame = current_frame;
+
+        // Simulate in fixed ticks, then draw everything between the last two of them.
+        // The camera doesn't touch the registry and goes first, so the occluders it sees
+        // are rasterized on the job system while the rest of the world is simulated.
+        uint32_t ticks = timestep.advance(delta_time);
+        for (uint32_t i = 0; i < ticks; i++)
+        {
+            player::update(window, (float) timestep.get_tick_seconds());
+        }
+
+        player::interpolate(timestep.get_alpha());
+
+        packet.projection = projection;
+        packet.view = player::get_view_matrix();
+        packet.screen_size = glm::ivec2(WIDTH, HEIGHT);
+
+        if (occlusion)
+        {
+            occlusion->begin_frame(packet.projection, packet.view);
+            terrain.add_occluders(*occlusion);
+            systems::add_occluders(get_registry(), draw_distances, *occlusion);
+            occlusion->rasterize();
+        }
+
+        for (uint32_t i = 0; i < ticks; i++)
+        {
+            systems::simulate(get_registry(), (float) timestep.get_tick_seconds());
+        }
+
+        // Streaming uploads and attaches chunks, which needs GL and the registry at once
+        render_thread.run_synchronized([&]() {
+            if (upload_thread) upload_thread->publish();
+
+            streamer.update(player::get_position(), player::get_velocity());
+            terrain.update(player::get_position());
+
+            residency::end_frame();
+            mesh_pool::end_frame();
+
+            if (upload_thread)
+            {
+                UploadStats uploads = upload_thread->get_stats();
+                stats_overlay::set("uploads", std::to_string(uploads.pending) + " pending, worst " + std::to_string(uploads.worst_upload_ms).substr(0, 4) + " ms");
+            }
+
+            // Jobs queued for the GL thread
+            jobs::run_gl_jobs();
+
+            const StreamingStats& streaming = streamer.get_stats();
+            stats_overlay::set("road", std::to_string((int) streaming.route_distance) + " m");
+            stats_overlay::set("chunks", std::to_string(streaming.resident_chunks) + " (+" + std::to_string(streaming.pending_chunks) + ") misses " + std::to_string(streaming.misses));
+
+            const TerrainStats& terrain_stats = terrain.get_stats();
+            stats_overlay::set("terrain", std::to_string(terrain_stats.resident_tiles) + " tiles " + std::to_string(terrain_stats.triangles / 1000) + "k tris");
+
+            const StreamBufferStats& buffers = draw_data.get_stats();
+            stats_overlay::set("draw data", std::string(buffers.persistent ? "persistent " : "orphaned ") + stats_overlay::format_bytes(buffers.used_bytes)
+                + " waited " + std::to_string(buffers.wait_ms).substr(0, 4) + " ms");
+
+            const SubmitStats& submitted = systems::get_submit_stats();
+            stats_overlay::set("draws", std::to_string(submitted.multi_draws) + " multi-draws of " + std::to_string(submitted.indirect_meshes) + " meshes, "
+                + std::to_string(submitted.single_draws) + " single");
+
+            if (instance_culling::is_enabled())
+            {
+                const InstanceCullingStats& culling = instance_culling::get_stats();
+                stats_overlay::set("gpu culling", std::to_string(culling.batches) + " batches, " + std::to_string(culling.instances / 1000) + "k instances");
+            }
+
+            const ResidencyStats& vram = residency::get_stats();
+            stats_overlay::set("vram", stats_overlay::format_bytes(vram.texture_bytes + vram.buffer_bytes) + " / " + stats_overlay::format_bytes(vram.budget_bytes)
+                + " pinned " + stats_overlay::format_bytes(vram.pinned_bytes) + " evicted " + std::to_string(vram.evictions));
+        });
+
+        systems::interpolate(get_registry(), timestep.get_alpha());
+
+        systems::update_transforms(get_registry());
+        systems::cull(get_registry(), packet.projection, packet.view, draw_distances, packet.draw_list, occlusion.get());
+
+        if (occlusion)
+        {
+            const OcclusionStats& occluded = occlusion->get_stats();
+            stats_overlay::set("occlusion", std::to_string(occluded.occluded) + " / " + std::to_string(occluded.tested) + " hidden, "
+                + std::to_string(occluded.rasterized_triangles) + " tris " + std::to_string(occluded.rasterize_ms).substr(0, 4) + " ms waited "
+                + std::to_string(occluded.wait_ms).substr(0, 4) + " ms tests " + std::to_string(occluded.test_ms).substr(0, 4) + " ms");
+        }
+
+        render_thread.submit_packet();
+
+        stats_overlay::set("sim", std::to_string((int) tick_rate) + " Hz, " + std::to_string(ticks) + " ticks"
+            + (timestep.get_dropped_seconds() > 0.0 ? " dropped " + std::to_string((int) (timestep.get_dropped_seconds() * 1000.0)) + " ms" : ""));
+
+        RenderStats render_stats = render_thread.get_stats();
+        stats_overlay::set("frame", std::string(FramePacer::get_mode_name(render_stats.present_mode)) + (pacing_config.low_latency ? " low latency" : "")
+            + " sd " + std::to_string(render_stats.pacing.deviation_ms).substr(0, 4) + " ms worst " + std::to_string((int) render_stats.pacing.worst_ms) + " ms"
+            + " latency " + std::to_string(render_stats.latency_mean_ms).substr(0, 4) + " ms worst " + std::to_string((int) render_stats.latency_worst_ms) + " ms");
+
+        stats_overlay::update(window, WINDOW_TITLE, delta_time);
     }
 
-    delete test_model, test_model2, road, grass_trees;
+    // Takes the GL context back for the cleanup
+    render_thread.stop();
+    if (upload_thread) upload_thread->stop();
+
+    // Release the whole level while the GL context still exists
+    draw_data.destroy();
+    occlusion.reset();
+    terrain.shutdown();
+    streamer.shutdown();
+    world_arena.clear();
+    mesh_pool::shutdown();
+    instance_culling::shutdown();
+
+    jobs::shutdown();
 
     glfwTerminate();
     return 0;
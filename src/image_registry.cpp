@@ -1,5 +1,6 @@
 #include "image_registry.hpp"
 
+#include <exception>
 #include <stdexcept>
 #include <map>
 
@@ -7,9 +8,25 @@
 #include <stb_image.h>
 
 #include "path_helper.hpp"
+#include "residency.hpp"
+#include "jobs.hpp"
 
 static std::map<std::string, uint32_t> loaded_textures;
 
+struct TextureRecord
+{
+    std::string file_name;
+    AssetId asset;
+
+    // Evicted and being decoded again on a worker
+    bool reloading = false;
+};
+
+// What an evicted texture shows until it is back
+static const unsigned char PLACEHOLDER_TEXEL[4] = { 128, 128, 128, 255 };
+
+static std::map<uint32_t, TextureRecord> texture_records;
+
 uint32_t image_registry::load_texture(const std::string file_name)
 {
     if (loaded_textures.count(file_name))
@@ -17,8 +34,40 @@ uint32_t image_registry::load_texture(const std::string file_name)
         throw std::runtime_error("Tried to load texture `" + file_name + "`, which already exists.");
     }
 
+    return upload_texture(decode_texture(file_name));
+}
+
+uint32_t image_registry::get_texture(const std::string file_name)
+{
+    if (!loaded_textures.count(file_name))
+    {
+        throw std::runtime_error("Tried to load texture `" + file_name + "`, which hasn't been loaded yet.");
+    }
+
+    return loaded_textures[file_name];
+}
+
+uint32_t image_registry::get_or_load_texture(const std::string file_name)
+{
+    if (!loaded_textures.count(file_name))
+    {
+        return load_texture(file_name);
+    }
+    else
+    {
+        return get_texture(file_name);
+    }
+}
+
+bool image_registry::is_loaded(const std::string file_name)
+{
+    return loaded_textures.count(file_name) > 0;
+}
+
+ImageData image_registry::decode_texture(const std::string file_name)
+{
     int width, height, nr_channels;
-    unsigned char *data = stbi_load((get_process_path() + "resources/texture/" + file_name).c_str(), &width, &height, &nr_channels, STBI_rgb_alpha); 
+    unsigned char *data = stbi_load((TEXTURES_PATH + file_name).c_str(), &width, &height, &nr_channels, STBI_rgb_alpha); 
 
     if (data == NULL)
     {
@@ -26,6 +75,29 @@ uint32_t image_registry::load_texture(const std::string file_name)
         throw std::runtime_error("Failed to load texture `" + file_name + "`.");
     }
 
+    ImageData image;
+    image.file_name = file_name;
+    image.width = width;
+    image.height = height;
+    image.pixels.assign(data, data + (size_t) width * height * 4);
+
+    stbi_image_free(data);
+
+    return image;
+}
+
+uint32_t image_registry::upload_texture(const ImageData& image)
+{
+    if (loaded_textures.count(image.file_name))
+    {
+        throw std::runtime_error("Tried to upload texture `" + image.file_name + "`, which already exists.");
+    }
+
+    return register_texture(image, create_texture(image));
+}
+
+uint32_t image_registry::create_texture(const ImageData& image)
+{
     uint32_t texture;
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
@@ -36,34 +108,77 @@ uint32_t image_registry::load_texture(const std::string file_name)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
     //glGenerateMipmap(GL_TEXTURE_2D);
 
-    loaded_textures[file_name] = texture;
-
-    stbi_image_free(data);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
     return texture;
 }
 
-uint32_t image_registry::get_texture(const std::string file_name)
+uint32_t image_registry::register_texture(const ImageData& image, uint32_t texture)
 {
-    if (!loaded_textures.count(file_name))
+    auto loaded = loaded_textures.find(image.file_name);
+    if (loaded != loaded_textures.end())
     {
-        throw std::runtime_error("Tried to load texture `" + file_name + "`, which hasn't been loaded yet.");
+        glDeleteTextures(1, &texture);
+        return loaded->second;
     }
 
-    return loaded_textures[file_name];
+    loaded_textures[image.file_name] = texture;
+
+    // Shrinking the image to a single texel releases the storage but keeps the name,
+    // which models and meshes hold on to
+    AssetId asset = residency::track(ASSET_TEXTURE, image.pixels.size(), [texture]() {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_TEXEL);
+    });
+
+    texture_records[texture] = TextureRecord { image.file_name, asset };
+
+    return texture;
 }
 
-uint32_t image_registry::get_or_load_texture(const std::string file_name)
+// On the GL thread, once the evicted texture was decoded again
+static void finish_reload(uint32_t texture, const ImageData& image)
 {
-    if (!loaded_textures.count(file_name))
-    {
-        return load_texture(file_name);
-    }
-    else
-    {
-        return get_texture(file_name);
-    }
+    TextureRecord& record = texture_records.at(texture);
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    residency::reloaded(record.asset);
+    record.reloading = false;
+}
+
+void image_registry::bind_texture(uint32_t texture)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    auto record = texture_records.find(texture);
+    if (record == texture_records.end() || residency::use(record->second.asset) || record->second.reloading) return;
+
+    // The placeholder is drawn until the file is read and decoded on a worker, the
+    // frame never waits for the disk. A failed decode is rethrown on the GL thread.
+    record->second.reloading = true;
+
+    jobs::run([texture, file_name = record->second.file_name]() {
+        ImageData image;
+        std::exception_ptr error;
+
+        try
+        {
+            image = decode_texture(file_name);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        jobs::run([texture, image = std::move(image), error]() {
+            if (error) std::rethrow_exception(error);
+            finish_reload(texture, image);
+        }, nullptr, JOB_GL_THREAD);
+    }, nullptr, JOB_BACKGROUND);
 }
@@ -2,6 +2,17 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
+
+struct ImageData
+{
+    std::string file_name;
+    int width = 0;
+    int height = 0;
+
+    // RGBA8
+    std::vector<unsigned char> pixels;
+};
 
 namespace image_registry
 {
@@ -12,4 +23,24 @@ namespace image_registry
     uint32_t get_texture(const std::string file_name);
 
     uint32_t get_or_load_texture(const std::string file_name);
+
+    bool is_loaded(const std::string file_name);
+
+    // Reads and decodes a texture without touching GL, safe to call from any thread.
+    ImageData decode_texture(const std::string file_name);
+
+    // Uploads decoded pixels and registers them under their file name.
+    uint32_t upload_texture(const ImageData& image);
+
+    // upload_texture() in two halves. Creating the texture only needs a context sharing
+    // objects with the one that draws, registering has to happen on the GL thread. If the
+    // file was registered in the meantime, `texture` is deleted and the registered one
+    // is returned.
+    uint32_t create_texture(const ImageData& image);
+    uint32_t register_texture(const ImageData& image, uint32_t texture);
+
+    // Binds to GL_TEXTURE_2D. If the residency manager evicted the texture, it binds
+    // a grey placeholder texel and queues a reload on the job system. The file is
+    // decoded on a worker, and the texture is uploaded by jobs::run_gl_jobs().
+    void bind_texture(uint32_t texture);
 };
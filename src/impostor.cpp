@@ -0,0 +1,165 @@
+#include "impostor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include <glad/gl.h>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/constants.hpp>
+
+struct ImpostorVertex
+{
+    glm::vec2 corner;
+    glm::vec2 tex_coords;
+};
+
+Impostor::Impostor(const Mesh* meshes, uint32_t mesh_count, const AABB& bounds, Shader* bake_shader)
+{
+    // Wide enough for the model turned to any angle
+    float radius = 0.0f;
+    for (float x : { bounds.min.x, bounds.max.x })
+    {
+        for (float z : { bounds.min.z, bounds.max.z })
+        {
+            radius = std::max(radius, std::sqrt(x * x + z * z));
+        }
+    }
+
+    ImpostorVertex quad[] = {
+        { glm::vec2(-radius, bounds.min.y), glm::vec2(0.0f, 0.0f) },
+        { glm::vec2(radius, bounds.min.y), glm::vec2(1.0f, 0.0f) },
+        { glm::vec2(-radius, bounds.max.y), glm::vec2(0.0f, 1.0f) },
+        { glm::vec2(radius, bounds.max.y), glm::vec2(1.0f, 1.0f) },
+    };
+
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+    AABB square = bounds;
+    square.min.x = -radius;
+    square.max.x = radius;
+    square.min.z = -radius;
+    square.max.z = radius;
+
+    bake(meshes, mesh_count, square, bake_shader);
+
+    initialized = true;
+}
+
+void Impostor::bake(const Mesh* meshes, uint32_t mesh_count, const AABB& bounds, Shader* bake_shader)
+{
+    uint32_t width = ANGLES * TILE_SIZE, height = TILE_SIZE;
+
+    glGenTextures(1, &atlas);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    uint32_t depth;
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    // Everything below changes global state, put it back for the caller afterwards
+    int previous_framebuffer, previous_viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer);
+    glGetIntegerv(GL_VIEWPORT, previous_viewport);
+    bool blend = glIsEnabled(GL_BLEND);
+
+    uint32_t framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteTextures(1, &atlas);
+        glDeleteBuffers(1, &VBO);
+
+        throw std::runtime_error("The impostor framebuffer is incomplete.");
+    }
+
+    // Transparent where the model isn't, so the quads can cut the model out
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Blending would square the alpha written into the atlas
+    glDisable(GL_BLEND);
+
+    // Looking down -z at the model from outside its bounds
+    bake_shader->use();
+    bake_shader->set_mat4("projection", glm::ortho(bounds.min.x, bounds.max.x, bounds.min.y, bounds.max.y, bounds.min.z, bounds.max.z));
+
+    uint32_t inner = TILE_SIZE - 2 * TILE_PADDING;
+
+    for (uint32_t angle = 0; angle < ANGLES; angle++)
+    {
+        glViewport(angle * TILE_SIZE + TILE_PADDING, TILE_PADDING, inner, inner);
+
+        // Turning the model by n steps is the same as looking at it from n steps the
+        // other way round
+        float yaw = glm::two_pi<float>() * angle / ANGLES;
+        bake_shader->set_mat4("model_view", glm::rotate(glm::mat4(1.0f), yaw, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+        for (uint32_t i = 0; i < mesh_count; i++)
+        {
+            meshes[i].draw(bake_shader);
+        }
+    }
+
+    if (blend) glEnable(GL_BLEND);
+    glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+    glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depth);
+
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+void Impostor::set_vertex_layout() const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ImpostorVertex), (void*) offsetof(ImpostorVertex, corner));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ImpostorVertex), (void*) offsetof(ImpostorVertex, tex_coords));
+}
+
+void Impostor::bind(Shader* shader) const
+{
+    if (!initialized) throw std::runtime_error("Tried to bind an unitialized impostor.");
+
+    shader->use();
+    shader->set_int("our_texture", 0);
+    shader->set_float("impostor_angles", (float) ANGLES);
+    shader->set_float("impostor_padding", (float) TILE_PADDING / TILE_SIZE);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+}
+
+void Impostor::destroy_impostor()
+{
+    if (!initialized) return;
+
+    glDeleteTextures(1, &atlas);
+    glDeleteBuffers(1, &VBO);
+
+    initialized = false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include "mesh.hpp"
+#include "bounds.hpp"
+#include "shader.hpp"
+
+// Pictures of a model seen from evenly spaced angles around its y axis, baked side by
+// side into one atlas texture. Far away the model is drawn as a quad turned towards the
+// camera that shows the picture of the nearest angles instead.
+class Impostor
+{
+public:
+    static const uint32_t ANGLES = 8;
+    static const uint32_t TILE_SIZE = 256;
+
+    // Texels kept empty around every picture, so mip levels don't bleed into the next tile
+    static const uint32_t TILE_PADDING = 8;
+
+    // Renders the meshes into the atlas in an offscreen framebuffer. `bounds` are the
+    // bounds of the meshes around their own origin, which the model turns around. The
+    // bake shader has to take the usual model_view and projection.
+    Impostor(const Mesh* meshes, uint32_t mesh_count, const AABB& bounds, Shader* bake_shader);
+
+    Impostor(const Impostor&) = delete;
+    Impostor& operator = (const Impostor&) = delete;
+
+    // Binds the quad to the current VAO, as attributes 0 (corner) and 2 (texture coordinates).
+    void set_vertex_layout() const;
+
+    // Sets the atlas uniforms of an impostor shader and binds the atlas to texture unit 0.
+    void bind(Shader* shader) const;
+
+    void destroy_impostor();
+
+private:
+    bool initialized = false;
+
+    uint32_t atlas;
+    uint32_t VBO;
+
+    void bake(const Mesh* meshes, uint32_t mesh_count, const AABB& bounds, Shader* bake_shader);
+};
@@ -0,0 +1,350 @@
+#include "instance_batch.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include <glad/gl.h>
+
+#include "image_registry.hpp"
+#include "instance_culling.hpp"
+#include "bounds.hpp"
+
+InstanceBatch::InstanceBatch(const Mesh* meshes, uint32_t mesh_count, std::vector<Instance> instances)
+    : meshes(meshes), mesh_count(mesh_count), instances(std::move(instances))
+{
+    std::sort(this->instances.begin(), this->instances.end(), [](const Instance& a, const Instance& b) {
+        return a.rank < b.rank;
+    });
+
+    float min_y = FLT_MAX, max_y = -FLT_MAX;
+    for (uint32_t i = 0; i < mesh_count; i++)
+    {
+        for (const Vertex& vertex : meshes[i].vertices)
+        {
+            min_y = std::min(min_y, vertex.position.y);
+            max_y = std::max(max_y, vertex.position.y);
+        }
+    }
+
+    bound_height = min_y <= max_y ? (min_y + max_y) * 0.5f : 0.0f;
+    for (uint32_t i = 0; i < mesh_count; i++)
+    {
+        for (const Vertex& vertex : meshes[i].vertices)
+        {
+            glm::vec3 offset = vertex.position - glm::vec3(0.0f, bound_height, 0.0f);
+            bound_radius = std::max(bound_radius, std::sqrt(offset.x * offset.x + offset.y * offset.y + offset.z * offset.z));
+        }
+    }
+
+    glGenBuffers(1, &VBO);
+    if (instance_culling::is_enabled()) create_culling();
+    upload_buffer();
+
+    VAOs.resize(mesh_count);
+    glGenVertexArrays(mesh_count, VAOs.data());
+
+    for (uint32_t i = 0; i < mesh_count; i++)
+    {
+        glBindVertexArray(VAOs[i]);
+        meshes[i].set_vertex_layout();
+        set_instance_layout(VBO, 0);
+    }
+
+    glBindVertexArray(0);
+
+    initialized = true;
+
+    // The culled instances are written again every draw, they go with the instances
+    uint32_t vbo = VBO, culled_vbo = culled ? culled_VBO : 0;
+    buffer = residency::track(ASSET_BUFFER, get_buffer_bytes(), [vbo, culled_vbo]() {
+        for (uint32_t released : { vbo, culled_vbo })
+        {
+            if (released == 0) continue;
+
+            glBindBuffer(GL_ARRAY_BUFFER, released);
+            glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+        }
+    });
+}
+
+void InstanceBatch::upload_buffer() const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+
+    if (culled)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, culled_VBO);
+        glBufferData(GL_ARRAY_BUFFER, 2 * instances.size() * sizeof(Instance), nullptr, GL_DYNAMIC_COPY);
+    }
+}
+
+void InstanceBatch::create_culling()
+{
+    culled = true;
+
+    glGenBuffers(1, &culled_VBO);
+    glGenBuffers(1, &command_buffer);
+
+    // The impostors' DrawArraysIndirectCommand, then a DrawElementsIndirectCommand per
+    // mesh. Instance counts are filled in by the culling pass.
+    commands = { 4, 0, 0, 0 };
+
+    for (uint32_t i = 0; i < mesh_count; i++)
+    {
+        const Mesh& mesh = meshes[i];
+        const PoolRange& range = mesh.get_pool_range();
+
+        if (mesh.is_pooled()) commands.insert(commands.end(), { range.index_count, 0, range.first_index, range.first_vertex, 0 });
+        else commands.insert(commands.end(), { (uint32_t) mesh.indices.size(), 0, 0, 0, 0 });
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(uint32_t), commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    culled_VAOs.resize(mesh_count);
+    glGenVertexArrays(mesh_count, culled_VAOs.data());
+
+    for (uint32_t i = 0; i < mesh_count; i++)
+    {
+        glBindVertexArray(culled_VAOs[i]);
+        meshes[i].set_vertex_layout();
+        set_instance_layout(culled_VBO, 0);
+    }
+
+    glBindVertexArray(0);
+}
+
+void InstanceBatch::cull(const glm::mat4& model_view, uint32_t instance_count, uint32_t layers, float start, float end) const
+{
+    Shader* shader = instance_culling::get_shader();
+    Frustum frustum = Frustum::from_matrix(instance_culling::get_projection() * model_view);
+
+    shader->use();
+    shader->set_mat4("model_view", model_view);
+    shader->set_vec4_array("planes", frustum.planes, 6);
+    shader->set_uint("instance_count", instance_count);
+    shader->set_uint("capacity", instances.size());
+    shader->set_uint("mesh_count", mesh_count);
+    shader->set_uint("layers", impostor != nullptr ? layers : layers & INSTANCE_MESHES);
+    shader->set_float("impostor_start", start);
+    shader->set_float("impostor_end", end);
+    shader->set_vec2("bound", glm::vec2(bound_height, bound_radius));
+
+    // Every draw counts from zero
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, command_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, commands.size() * sizeof(uint32_t), commands.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, VBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, culled_VBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, command_buffer);
+
+    glDispatchCompute((instance_count + 63) / 64, 1, 1);
+
+    // The survivors are read as vertex attributes and their counts as draw commands
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    instance_culling::add_batch(instance_count);
+}
+
+void InstanceBatch::set_instance_layout(uint32_t instance_buffer, size_t offset) const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*) (offset + offsetof(Instance, position)));
+    glVertexAttribDivisor(3, 1);
+
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*) (offset + offsetof(Instance, scale)));
+    glVertexAttribDivisor(4, 1);
+}
+
+void InstanceBatch::set_impostor(const Impostor* impostor, Shader* impostor_shader, float start, float end)
+{
+    if (!initialized) throw std::runtime_error("Tried to add an impostor to an unitialized instance batch.");
+    if (this->impostor != nullptr) throw std::runtime_error("The instance batch already has an impostor.");
+
+    this->impostor = impostor;
+    this->impostor_shader = impostor_shader;
+    impostor_start = start;
+    impostor_end = end;
+
+    glGenVertexArrays(1, &impostor_VAO);
+    glBindVertexArray(impostor_VAO);
+
+    impostor->set_vertex_layout();
+    set_instance_layout(VBO, 0);
+
+    if (culled)
+    {
+        glGenVertexArrays(1, &culled_impostor_VAO);
+        glBindVertexArray(culled_impostor_VAO);
+
+        impostor->set_vertex_layout();
+        set_instance_layout(culled_VBO, instances.size() * sizeof(Instance));
+    }
+
+    glBindVertexArray(0);
+}
+
+void InstanceBatch::draw(Shader* shader, const glm::mat4& model_view, uint32_t instance_count, uint32_t layers) const
+{
+    if (!initialized) throw std::runtime_error("Tried to draw an unitialized instance batch.");
+    if (instance_count == 0) return;
+
+    if (!residency::use(buffer))
+    {
+        upload_buffer();
+        residency::reloaded(buffer);
+    }
+
+    // Without an impostor the meshes never fade out
+    float start = impostor != nullptr ? impostor_start : FLT_MAX;
+    float end = impostor != nullptr ? impostor_end : FLT_MAX;
+
+    if (culled)
+    {
+        cull(model_view, instance_count, layers, start, end);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    }
+
+    if (layers & INSTANCE_MESHES)
+    {
+        shader->use();
+        shader->set_mat4("model_view", model_view);
+        shader->set_float("impostor_start", start);
+        shader->set_float("impostor_end", end);
+        shader->set_int("our_texture", 0);
+        glActiveTexture(GL_TEXTURE0);
+
+        for (uint32_t i = 0; i < mesh_count; i++)
+        {
+            const Mesh& mesh = meshes[i];
+
+            mesh.make_resident();
+            image_registry::bind_texture(mesh.texture);
+
+            if (culled)
+            {
+                glBindVertexArray(culled_VAOs[i]);
+                glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*) ((4 + i * 5) * sizeof(uint32_t)));
+            }
+            else
+            {
+                glBindVertexArray(VAOs[i]);
+                mesh.draw_elements(instance_count);
+            }
+        }
+    }
+
+    if ((layers & INSTANCE_IMPOSTORS) && impostor != nullptr)
+    {
+        impostor->bind(impostor_shader);
+        impostor_shader->set_mat4("model_view", model_view);
+        impostor_shader->set_float("impostor_start", start);
+        impostor_shader->set_float("impostor_end", end);
+
+        if (culled)
+        {
+            glBindVertexArray(culled_impostor_VAO);
+            glDrawArraysIndirect(GL_TRIANGLE_STRIP, (void*) 0);
+        }
+        else
+        {
+            glBindVertexArray(impostor_VAO);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instance_count);
+        }
+    }
+
+    glBindVertexArray(0);
+    if (culled) glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+uint32_t InstanceBatch::get_visible_count(float distance, float draw_distance) const
+{
+    float end = std::min(thin_end, draw_distance);
+    if (distance <= thin_start || end <= thin_start) return instances.size();
+
+    float t = std::min((distance - thin_start) / (end - thin_start), 1.0f);
+    float fraction = 1.0f + (min_fraction - 1.0f) * t;
+
+    return (uint32_t) (instances.size() * fraction);
+}
+
+uint32_t InstanceBatch::get_layers(float near_distance, float far_distance) const
+{
+    if (impostor == nullptr) return INSTANCE_MESHES;
+
+    uint32_t layers = 0;
+    if (near_distance < impostor_end) layers |= INSTANCE_MESHES;
+    if (far_distance > impostor_start) layers |= INSTANCE_IMPOSTORS;
+
+    return layers;
+}
+
+uint32_t InstanceBatch::get_instance_count() const
+{
+    return instances.size();
+}
+
+const std::vector<Instance>& InstanceBatch::get_instances() const
+{
+    return instances;
+}
+
+glm::vec2 InstanceBatch::get_bound() const
+{
+    return glm::vec2(bound_height, bound_radius);
+}
+
+uint32_t InstanceBatch::read_culled_count(InstanceLayer layer) const
+{
+    if (!culled) throw std::runtime_error("Tried reading the culled count of a batch that isn't culled.");
+
+    size_t count_index = layer == INSTANCE_MESHES ? 5 : 1;
+    uint32_t count = 0;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, command_buffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, count_index * sizeof(uint32_t), sizeof(uint32_t), &count);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    return count;
+}
+
+size_t InstanceBatch::get_buffer_bytes() const
+{
+    // Culling keeps room for every instance in both layers
+    return instances.size() * sizeof(Instance) * (culled ? 3 : 1);
+}
+
+void InstanceBatch::destroy_batch()
+{
+    if (!initialized) return;
+
+    glDeleteVertexArrays(VAOs.size(), VAOs.data());
+    glDeleteBuffers(1, &VBO);
+
+    if (culled)
+    {
+        glDeleteVertexArrays(culled_VAOs.size(), culled_VAOs.data());
+        glDeleteBuffers(1, &culled_VBO);
+        glDeleteBuffers(1, &command_buffer);
+
+        if (impostor != nullptr) glDeleteVertexArrays(1, &culled_impostor_VAO);
+        culled = false;
+    }
+
+    if (impostor != nullptr) glDeleteVertexArrays(1, &impostor_VAO);
+    impostor = nullptr;
+
+    residency::untrack(buffer);
+    buffer = NO_ASSET;
+
+    initialized = false;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vec3.hpp>
+#include <mat4x4.hpp>
+
+#include "mesh.hpp"
+#include "impostor.hpp"
+#include "residency.hpp"
+
+// Per instance vertex data, attributes 3 (position and yaw) and 4 (scale and rank)
+struct Instance
+{
+    glm::vec3 position;
+    float yaw;
+    float scale;
+
+    // Random value in [0, 1), instances are drawn in rank order so drawing fewer of
+    // them thins them out evenly
+    float rank;
+};
+
+enum InstanceLayer : uint32_t
+{
+    INSTANCE_MESHES = 1 << 0,
+    INSTANCE_IMPOSTORS = 1 << 1,
+};
+
+// Draws the same meshes many times from one instance buffer, and far away the same
+// instances as impostors. With instance_culling enabled when the batch is created, every
+// draw culls the instances on the GPU first and draws the survivors indirectly.
+class InstanceBatch
+{
+public:
+    // Instances are thinned out linearly from thin_start down to min_fraction at thin_end
+    float thin_start = 0.0f;
+    float thin_end = 0.0f;
+    float min_fraction = 1.0f;
+
+    // The meshes have to outlive the batch.
+    InstanceBatch(const Mesh* meshes, uint32_t mesh_count, std::vector<Instance> instances);
+
+    InstanceBatch(const InstanceBatch&) = delete;
+    InstanceBatch& operator = (const InstanceBatch&) = delete;
+
+    // Instances crossfade from the meshes to `impostor` between the view distances
+    // `start` and `end`. The impostor has to outlive the batch.
+    void set_impostor(const Impostor* impostor, Shader* impostor_shader, float start, float end);
+
+    // `shader` draws the meshes, `model_view` takes the space the instances are in to
+    // view space.
+    void draw(Shader* shader, const glm::mat4& model_view, uint32_t instance_count, uint32_t layers) const;
+
+    // How many instances to draw for a camera at `distance`. Thinning is done by
+    // `draw_distance` at the latest, when the batch is cut off before thin_end.
+    uint32_t get_visible_count(float distance, float draw_distance) const;
+
+    // Which layers have to be drawn when the instances are between `near_distance` and
+    // `far_distance` away from the camera.
+    uint32_t get_layers(float near_distance, float far_distance) const;
+    uint32_t get_instance_count() const;
+
+    // In rank order, the first get_visible_count() of them are drawn
+    const std::vector<Instance>& get_instances() const;
+
+    // Height of the centre of the sphere culling tests every instance with, and its
+    // radius, both at scale 1
+    glm::vec2 get_bound() const;
+
+    // Reads back how many instances the last draw drew of `layer` after GPU culling.
+    // Waits for the GPU, for tests and benchmarks.
+    uint32_t read_culled_count(InstanceLayer layer) const;
+
+    size_t get_buffer_bytes() const;
+
+    // Frees the GL objects, only the owner may call this.
+    void destroy_batch();
+
+private:
+    const Mesh* meshes;
+    uint32_t mesh_count;
+
+    std::vector<Instance> instances;
+
+    bool initialized = false;
+
+    std::vector<uint32_t> VAOs;
+    uint32_t VBO;
+
+    const Impostor* impostor = nullptr;
+    Shader* impostor_shader = nullptr;
+    float impostor_start, impostor_end;
+    uint32_t impostor_VAO;
+
+    AssetId buffer = NO_ASSET;
+
+    // Sphere around every instance at scale 1, centred on its y axis so the yaw doesn't
+    // move it
+    float bound_height = 0.0f;
+    float bound_radius = 0.0f;
+
+    // GPU culling writes the survivors for the meshes and then for the impostors into
+    // culled_VBO, and their counts into the indirect commands
+    bool culled = false;
+    uint32_t culled_VBO, command_buffer;
+    std::vector<uint32_t> culled_VAOs;
+    uint32_t culled_impostor_VAO;
+    std::vector<uint32_t> commands;
+
+    void upload_buffer() const;
+    void create_culling();
+    void cull(const glm::mat4& model_view, uint32_t instance_count, uint32_t layers, float start, float end) const;
+
+    // Points attributes 3 and 4 of the current VAO at instances in `instance_buffer`,
+    // from `offset` on.
+    void set_instance_layout(uint32_t instance_buffer, size_t offset) const;
+};
@@ -0,0 +1,61 @@
+#include "instance_culling.hpp"
+
+#include <memory>
+
+#include <glad/gl.h>
+
+static std::unique_ptr<Shader> shader;
+static glm::mat4 projection = glm::mat4(1.0f);
+
+static InstanceCullingStats stats;
+
+bool instance_culling::init()
+{
+    if (shader) return true;
+
+    // Core since 4.3, glad only loads it when the context has it
+    if (glDispatchCompute == nullptr) return false;
+
+    shader = std::make_unique<Shader>("resources/shader/cull_instances.comp");
+    return true;
+}
+
+void instance_culling::shutdown()
+{
+    if (!shader) return;
+
+    glDeleteProgram(shader->id);
+    shader.reset();
+}
+
+bool instance_culling::is_enabled()
+{
+    return shader != nullptr;
+}
+
+void instance_culling::begin_frame(const glm::mat4& frame_projection)
+{
+    projection = frame_projection;
+    stats = InstanceCullingStats();
+}
+
+const glm::mat4& instance_culling::get_projection()
+{
+    return projection;
+}
+
+Shader* instance_culling::get_shader()
+{
+    return shader.get();
+}
+
+void instance_culling::add_batch(uint32_t instance_count)
+{
+    stats.batches++;
+    stats.instances += instance_count;
+}
+
+const InstanceCullingStats& instance_culling::get_stats()
+{
+    return stats;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#include <mat4x4.hpp>
+
+#include "shader.hpp"
+
+struct InstanceCullingStats
+{
+    // During the last frame
+    uint32_t batches = 0;
+    uint64_t instances = 0;
+};
+
+// Culls the instances of every InstanceBatch on the GPU. A compute pass tests each
+// instance's bounding sphere against the frustum, compacts the survivors into a buffer
+// of the batch and counts them into its indirect draw commands, so visibility of single
+// instances never reaches the CPU. The CPU still culls whole batches.
+namespace instance_culling
+{
+    // Compiles the culling shader if the context has compute shaders (GL 4.3), returns
+    // whether it did. Batches created before aren't culled.
+    bool init();
+    void shutdown();
+
+    bool is_enabled();
+
+    // Call on the thread that draws, before the frame's batches are drawn
+    void begin_frame(const glm::mat4& projection);
+
+    const glm::mat4& get_projection();
+    Shader* get_shader();
+
+    // Counted by the batches as they cull
+    void add_batch(uint32_t instance_count);
+
+    const InstanceCullingStats& get_stats();
+}
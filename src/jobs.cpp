@@ -0,0 +1,497 @@
+#include "jobs.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+struct Job
+{
+    std::function<void()> function;
+    JobCounter* counter;
+    JobAffinity affinity;
+};
+
+// Chase-Lev work stealing deque of fixed capacity, after Lê, Pop, Cohen and Zappa Nardelli,
+// "Correct and Efficient Work-Stealing for Weak Memory Models". Only the owner pushes and
+// pops, at the bottom, any thread steals from the top.
+class WorkDeque
+{
+public:
+    static const int64_t CAPACITY = 4096;
+
+    // False when full, the caller then queues the job on the shared queue
+    bool push(Job* job)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+
+        if (b - t >= CAPACITY) return false;
+
+        buffer[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    Job* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job* job = buffer[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+
+        // The last job, a thief may be taking it at the same time
+        if (t == b)
+        {
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return job;
+    }
+
+    Job* steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) return nullptr;
+
+        Job* job = buffer[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+
+        // Lost to the owner or another thief
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+
+        return job;
+    }
+
+private:
+    // Apart, so thieves bumping top don't keep invalidating the owner's bottom
+    alignas(64) std::atomic<int64_t> top { 0 };
+    alignas(64) std::atomic<int64_t> bottom { 0 };
+    std::atomic<Job*> buffer[CAPACITY];
+};
+
+// Thread 0 is the one that called init(), the workers are 1 and up. Other threads are
+// outside the pool.
+static const int OUTSIDE_POOL = -1;
+static thread_local int thread_index = OUTSIDE_POOL;
+
+static std::vector<std::unique_ptr<WorkDeque>> deques;
+static std::vector<std::thread> workers;
+static bool initialized = false;
+
+// For threads outside the pool and deques that are full
+static std::mutex shared_mutex;
+static std::deque<Job*> shared_jobs;
+
+static std::mutex gl_mutex;
+static std::deque<Job*> gl_jobs;
+
+static std::mutex background_mutex;
+static std::deque<Job*> background_jobs;
+
+// Queued jobs not yet taken, workers sleep while there are none
+static std::atomic<int64_t> queued { 0 };
+static std::atomic<uint32_t> sleeping { 0 };
+static std::atomic<bool> stopping { false };
+static std::mutex sleep_mutex;
+static std::condition_variable sleep_condition;
+
+static std::atomic<uint64_t> jobs_run { 0 };
+static std::atomic<uint64_t> steals { 0 };
+
+struct JobScheduler
+{
+    static void add(JobCounter* counter)
+    {
+        if (counter != nullptr) counter->value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void enqueue(Job* job);
+    static void finish(Job* job, std::exception_ptr error);
+    static void wait_done(JobCounter& counter);
+    static void continue_after(JobCounter& dependency, Job* job);
+    static uint32_t get_value(const JobCounter& counter);
+};
+
+static void wake_worker()
+{
+    // Sleepers check `queued` under the mutex, so taking it here means none of them
+    // misses the job between checking and waiting
+    if (sleeping.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        sleep_condition.notify_one();
+    }
+}
+
+void JobScheduler::enqueue(Job* job)
+{
+    if (job->affinity == JOB_GL_THREAD)
+    {
+        std::lock_guard<std::mutex> lock(gl_mutex);
+        gl_jobs.push_back(job);
+        return;
+    }
+
+    queued.fetch_add(1);
+
+    if (job->affinity == JOB_BACKGROUND)
+    {
+        {
+            std::lock_guard<std::mutex> lock(background_mutex);
+            background_jobs.push_back(job);
+        }
+
+        wake_worker();
+        return;
+    }
+
+    if (thread_index == OUTSIDE_POOL || !deques[thread_index]->push(job))
+    {
+        std::lock_guard<std::mutex> lock(shared_mutex);
+        shared_jobs.push_back(job);
+    }
+
+    wake_worker();
+}
+
+void JobScheduler::finish(Job* job, std::exception_ptr error)
+{
+    JobCounter* counter = job->counter;
+    delete job;
+
+    jobs_run.fetch_add(1, std::memory_order_relaxed);
+
+    if (counter == nullptr)
+    {
+        if (error) std::rethrow_exception(error);
+        return;
+    }
+
+    std::vector<Job*> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+
+        if (error && !counter->error) counter->error = error;
+        if (counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1) ready.swap(counter->continuations);
+    }
+
+    for (Job* continuation : ready) enqueue(continuation);
+}
+
+void JobScheduler::wait_done(JobCounter& counter)
+{
+    // The last job may still be unlocking the counter
+    std::lock_guard<std::mutex> lock(counter.mutex);
+
+    if (counter.error)
+    {
+        std::exception_ptr error = counter.error;
+        counter.error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void JobScheduler::continue_after(JobCounter& dependency, Job* job)
+{
+    {
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+
+        // finish() takes the list after the counter reached zero, under the same lock
+        if (dependency.value.load(std::memory_order_acquire) != 0)
+        {
+            dependency.continuations.push_back(job);
+            return;
+        }
+    }
+
+    enqueue(job);
+}
+
+uint32_t JobScheduler::get_value(const JobCounter& counter)
+{
+    return counter.value.load(std::memory_order_acquire);
+}
+
+bool JobCounter::is_done() const
+{
+    return JobScheduler::get_value(*this) == 0;
+}
+
+static Job* take_job()
+{
+    Job* job = nullptr;
+
+    if (thread_index != OUTSIDE_POOL) job = deques[thread_index]->pop();
+
+    if (job == nullptr)
+    {
+        // Start at a random victim, so thieves spread out
+        static thread_local std::minstd_rand random(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        size_t first = random() % deques.size();
+
+        for (size_t i = 0; i < deques.size() && job == nullptr; i++)
+        {
+            size_t victim = (first + i) % deques.size();
+            if ((int) victim == thread_index) continue;
+
+            job = deques[victim]->steal();
+            if (job != nullptr) steals.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (job == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(shared_mutex);
+
+        if (!shared_jobs.empty())
+        {
+            job = shared_jobs.front();
+            shared_jobs.pop_front();
+        }
+    }
+
+    if (job != nullptr) queued.fetch_sub(1);
+    return job;
+}
+
+// Only for workers with nothing else to do, and shutdown()
+static Job* take_background_job()
+{
+    std::lock_guard<std::mutex> lock(background_mutex);
+    if (background_jobs.empty()) return nullptr;
+
+    Job* job = background_jobs.front();
+    background_jobs.pop_front();
+
+    queued.fetch_sub(1);
+    return job;
+}
+
+static void execute(Job* job)
+{
+    std::exception_ptr error;
+
+    try
+    {
+        job->function();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    JobScheduler::finish(job, error);
+}
+
+static void worker_loop(int index)
+{
+    thread_index = index;
+
+    while (true)
+    {
+        Job* job = take_job();
+        if (job == nullptr) job = take_background_job();
+
+        if (job != nullptr)
+        {
+            execute(job);
+            continue;
+        }
+
+        // Spin a little before sleeping, jobs often come in bursts
+        for (int spin = 0; spin < 64 && queued.load() == 0 && !stopping.load(); spin++)
+        {
+            std::this_thread::yield();
+        }
+
+        if (queued.load() > 0) continue;
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleeping.fetch_add(1);
+        sleep_condition.wait(lock, []() { return stopping.load() || queued.load() > 0; });
+        sleeping.fetch_sub(1);
+
+        if (stopping.load() && queued.load() == 0) return;
+    }
+}
+
+void jobs::init(uint32_t worker_count)
+{
+    if (initialized) throw std::runtime_error("Tried initializing the job system twice.");
+
+    if (worker_count == 0) worker_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    stopping = false;
+    thread_index = 0;
+
+    for (uint32_t i = 0; i <= worker_count; i++)
+    {
+        deques.push_back(std::make_unique<WorkDeque>());
+    }
+
+    for (uint32_t i = 1; i <= worker_count; i++)
+    {
+        workers.emplace_back(worker_loop, (int) i);
+    }
+
+    initialized = true;
+}
+
+void jobs::shutdown()
+{
+    if (!initialized) return;
+
+    // What is still queued runs, the jobs may be holding resources
+    while (true)
+    {
+        Job* job = take_job();
+        if (job == nullptr) job = take_background_job();
+        if (job == nullptr) break;
+
+        execute(job);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+        sleep_condition.notify_all();
+    }
+
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+
+    while (run_gl_jobs() > 0) {}
+
+    deques.clear();
+    thread_index = OUTSIDE_POOL;
+    initialized = false;
+}
+
+void jobs::run(std::function<void()> job, JobCounter* counter, JobAffinity affinity)
+{
+    if (!initialized) throw std::runtime_error("Tried running a job before the job system was initialized.");
+
+    JobScheduler::add(counter);
+    JobScheduler::enqueue(new Job { std::move(job), counter, affinity });
+}
+
+void jobs::run_after(JobCounter& dependency, std::function<void()> job, JobCounter* counter, JobAffinity affinity)
+{
+    if (!initialized) throw std::runtime_error("Tried running a job before the job system was initialized.");
+
+    // Counted from now, so waiting on it also waits for the dependency
+    JobScheduler::add(counter);
+    JobScheduler::continue_after(dependency, new Job { std::move(job), counter, affinity });
+}
+
+void jobs::wait(JobCounter& counter)
+{
+    while (!counter.is_done())
+    {
+        Job* job = take_job();
+
+        if (job != nullptr) execute(job);
+        else std::this_thread::yield();
+    }
+
+    JobScheduler::wait_done(counter);
+}
+
+static void split_range(uint32_t begin, uint32_t end, uint32_t grain_size, const std::function<void(uint32_t, uint32_t)>& function, JobCounter& counter)
+{
+    // Queue the upper halves and keep the lower for this thread, until it fits a grain
+    while (end - begin > grain_size)
+    {
+        uint32_t middle = begin + (end - begin) / 2;
+
+        jobs::run([middle, end, grain_size, &function, &counter]() {
+            split_range(middle, end, grain_size, function, counter);
+        }, &counter);
+
+        end = middle;
+    }
+
+    function(begin, end);
+}
+
+void jobs::parallel_for(uint32_t count, uint32_t grain_size, const std::function<void(uint32_t, uint32_t)>& function)
+{
+    if (count == 0) return;
+
+    JobCounter counter;
+    std::exception_ptr error;
+
+    // The queued ranges point at the counter and the function, so they have to finish
+    // before anything is thrown out of here
+    try
+    {
+        split_range(0, count, std::max(grain_size, 1u), function, counter);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    try
+    {
+        wait(counter);
+    }
+    catch (...)
+    {
+        if (!error) error = std::current_exception();
+    }
+
+    if (error) std::rethrow_exception(error);
+}
+
+uint32_t jobs::run_gl_jobs()
+{
+    uint32_t ran = 0;
+
+    while (true)
+    {
+        Job* job;
+        {
+            std::lock_guard<std::mutex> lock(gl_mutex);
+            if (gl_jobs.empty()) return ran;
+
+            job = gl_jobs.front();
+            gl_jobs.pop_front();
+        }
+
+        execute(job);
+        ran++;
+    }
+}
+
+uint32_t jobs::get_worker_count()
+{
+    return workers.size();
+}
+
+JobStats jobs::get_stats()
+{
+    JobStats stats;
+    stats.worker_count = workers.size();
+    stats.jobs_run = jobs_run.load();
+    stats.steals = steals.load();
+
+    return stats;
+}
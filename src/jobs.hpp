@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct Job;
+
+// Counts the unfinished jobs started with it. A job can also wait for one to reach zero
+// before it is queued at all, see jobs::run_after.
+class JobCounter
+{
+public:
+    JobCounter() = default;
+
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator = (const JobCounter&) = delete;
+
+    bool is_done() const;
+
+private:
+    // Scheduler internals, in jobs.cpp
+    friend struct JobScheduler;
+
+    std::atomic<uint32_t> value { 0 };
+
+    // Guards the rest, and is held while the counter reaches zero, so a waiter that
+    // took it knows no job touches the counter anymore
+    std::mutex mutex;
+
+    // Jobs waiting for the counter to reach zero
+    std::vector<Job*> continuations;
+
+    // The first exception a job counted here threw, rethrown by jobs::wait
+    std::exception_ptr error;
+};
+
+enum JobAffinity
+{
+    JOB_ANY_THREAD,
+
+    // Only run by jobs::run_gl_jobs(), on whichever thread has the GL context current.
+    // The other threads never pick these up, not even while waiting.
+    JOB_GL_THREAD,
+
+    // Long work like file IO or draining a build queue. Only workers run these, once
+    // they have nothing else to do, so a wait() in the middle of a frame never ends up
+    // running one.
+    JOB_BACKGROUND,
+};
+
+struct JobStats
+{
+    uint32_t worker_count = 0;
+
+    // Totals since init()
+    uint64_t jobs_run = 0;
+    uint64_t steals = 0;
+};
+
+// Work stealing job scheduler. Every worker, and the thread that called init(), has its
+// own Chase-Lev deque: it pushes and pops at the bottom without locking, and idle
+// workers steal from the top of someone else's. Threads outside the pool queue their
+// jobs through a shared locked queue instead.
+//
+// Waiting is never idle: wait() and parallel_for() run other jobs until what they wait
+// for is done, so jobs can wait for jobs they started themselves. Background jobs are
+// the exception, they are left to the workers.
+namespace jobs
+{
+    // Starts `worker_count` worker threads, one less than the hardware threads when 0.
+    void init(uint32_t worker_count = 0);
+
+    // Waits for every queued job and joins the workers.
+    void shutdown();
+
+    // Queues `job`. The counter, if any, is incremented now and decremented once the
+    // job has run. Jobs without a counter must not throw.
+    void run(std::function<void()> job, JobCounter* counter = nullptr, JobAffinity affinity = JOB_ANY_THREAD);
+
+    // Queues `job` once `dependency` reaches zero, right away if it already has.
+    void run_after(JobCounter& dependency, std::function<void()> job, JobCounter* counter = nullptr, JobAffinity affinity = JOB_ANY_THREAD);
+
+    // Runs other jobs until the counter reaches zero, then rethrows the first exception
+    // of its jobs. GL and background jobs never run here, so waiting for GL jobs on the
+    // GL thread needs run_gl_jobs() in between.
+    void wait(JobCounter& counter);
+
+    // Calls function(begin, end) over [0, count) in ranges of at most grain_size and
+    // waits for all of them. Ranges are split in halves, so idle workers steal big ones.
+    void parallel_for(uint32_t count, uint32_t grain_size, const std::function<void(uint32_t, uint32_t)>& function);
+
+    // Runs the queued GL jobs, and the ones they queue in turn. Call on the thread with
+    // the GL context. Returns how many ran.
+    uint32_t run_gl_jobs();
+
+    uint32_t get_worker_count();
+
+    JobStats get_stats();
+}
@@ -0,0 +1,253 @@
+#include "level.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "image_registry.hpp"
+
+const char* LevelData::get_string(uint32_t offset) const
+{
+    if (offset == LEVEL_NONE) return "";
+
+    return strings.data() + offset;
+}
+
+int32_t LevelData::find_node(const std::string& name) const
+{
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        if (nodes[i].name != LEVEL_NONE && name == get_string(nodes[i].name)) return i;
+    }
+
+    return -1;
+}
+
+template<typename T> static void read_table(const std::vector<char>& buffer, size_t& offset, std::vector<T>& table, size_t count)
+{
+    table.resize(count);
+    if (count == 0) return;
+
+    std::memcpy(table.data(), buffer.data() + offset, count * sizeof(T));
+    offset += count * sizeof(T);
+}
+
+static void validate(const LevelData& data, const std::string& path)
+{
+    auto fail = [&](const std::string& reason) {
+        throw std::runtime_error("Invalid level `" + path + "`: " + reason + ".");
+    };
+
+    auto check_string = [&](uint32_t offset) {
+        if (offset != LEVEL_NONE && offset >= data.strings.size()) fail("string offset out of range");
+    };
+
+    if (!data.strings.empty() && data.strings.back() != '\0') fail("string table is not terminated");
+
+    for (uint32_t offset : data.meshes) check_string(offset);
+    for (uint32_t offset : data.textures) check_string(offset);
+
+    for (size_t i = 0; i < data.nodes.size(); i++)
+    {
+        const LevelNode& node = data.nodes[i];
+
+        check_string(node.name);
+
+        if (node.parent < -1) fail("node " + std::to_string(i) + " has an invalid parent");
+        if (node.parent >= (int32_t) i) fail("node " + std::to_string(i) + " comes before its parent");
+        if (node.parent >= 0 && data.nodes[node.parent].mesh != LEVEL_NONE) fail("node " + std::to_string(i) + " has a model as parent");
+        if (node.mesh != LEVEL_NONE && node.mesh >= data.meshes.size()) fail("mesh index out of range");
+        if (node.texture != LEVEL_NONE && node.texture >= data.textures.size()) fail("texture index out of range");
+    }
+}
+
+LevelData level::load(const std::string path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open level `" + path + "`.");
+    }
+
+    std::vector<char> buffer((size_t) file.tellg());
+    file.seekg(0);
+
+    if (!file.read(buffer.data(), buffer.size()))
+    {
+        throw std::runtime_error("Failed to read level `" + path + "`.");
+    }
+
+    LevelHeader header;
+
+    if (buffer.size() < sizeof(header))
+    {
+        throw std::runtime_error("Invalid level `" + path + "`: file is too small.");
+    }
+
+    std::memcpy(&header, buffer.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, LEVEL_MAGIC, sizeof(LEVEL_MAGIC)) != 0 || header.version != LEVEL_VERSION)
+    {
+        throw std::runtime_error("Invalid level `" + path + "`: unknown magic or version.");
+    }
+
+    uint64_t expected_size = sizeof(header)
+        + (uint64_t) header.node_count * sizeof(LevelNode)
+        + ((uint64_t) header.mesh_count + header.texture_count) * sizeof(uint32_t)
+        + header.string_size;
+
+    if (expected_size != buffer.size())
+    {
+        throw std::runtime_error("Invalid level `" + path + "`: table sizes don't match the file size.");
+    }
+
+    LevelData data;
+    size_t offset = sizeof(header);
+
+    read_table(buffer, offset, data.nodes, header.node_count);
+    read_table(buffer, offset, data.meshes, header.mesh_count);
+    read_table(buffer, offset, data.textures, header.texture_count);
+    data.strings.assign(buffer.data() + offset, header.string_size);
+
+    validate(data, path);
+
+    return data;
+}
+
+void level::save(const LevelData& data, const std::string path)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open level `" + path + "` for writing.");
+    }
+
+    LevelHeader header;
+    std::memcpy(header.magic, LEVEL_MAGIC, sizeof(LEVEL_MAGIC));
+    header.version = LEVEL_VERSION;
+    header.node_count = data.nodes.size();
+    header.mesh_count = data.meshes.size();
+    header.texture_count = data.textures.size();
+    header.string_size = data.strings.size();
+
+    file.write((const char*) &header, sizeof(header));
+    file.write((const char*) data.nodes.data(), data.nodes.size() * sizeof(LevelNode));
+    file.write((const char*) data.meshes.data(), data.meshes.size() * sizeof(uint32_t));
+    file.write((const char*) data.textures.data(), data.textures.size() * sizeof(uint32_t));
+    file.write(data.strings.data(), data.strings.size());
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write level `" + path + "`.");
+    }
+}
+
+static void write_vec3(std::ostream& out, const char* label, const float* v)
+{
+    out << ' ' << label << ' ' << v[0] << ' ' << v[1] << ' ' << v[2];
+}
+
+void level::export_text(const LevelData& data, std::ostream& out)
+{
+    out << std::setprecision(9);
+    out << "hkml " << LEVEL_VERSION << '\n';
+
+    for (size_t i = 0; i < data.meshes.size(); i++)
+    {
+        out << "mesh " << i << ' ' << data.get_string(data.meshes[i]) << '\n';
+    }
+
+    for (size_t i = 0; i < data.textures.size(); i++)
+    {
+        out << "texture " << i << ' ' << data.get_string(data.textures[i]) << '\n';
+    }
+
+    for (size_t i = 0; i < data.nodes.size(); i++)
+    {
+        const LevelNode& node = data.nodes[i];
+
+        out << "node " << i << " \"" << data.get_string(node.name) << '"';
+        out << " parent " << node.parent;
+
+        out << " mesh ";
+        if (node.mesh == LEVEL_NONE) out << '-'; else out << node.mesh;
+
+        out << " texture ";
+        if (node.texture == LEVEL_NONE) out << '-'; else out << node.texture;
+
+        write_vec3(out, "scale", node.scale);
+        write_vec3(out, "rotation", node.rotation);
+        write_vec3(out, "position", node.position);
+        out << '\n';
+    }
+}
+
+std::vector<Spatial*> level::instantiate(const LevelData& data, NodeArena& arena, Scene* root, Shader* shader)
+{
+    Registry& registry = get_registry();
+
+    size_t model_count = 0;
+    for (const LevelNode& node : data.nodes)
+    {
+        if (node.mesh != LEVEL_NONE) model_count++;
+    }
+
+    registry.reserve(MODEL_COMPONENTS, model_count);
+    registry.reserve(SCENE_COMPONENTS, data.nodes.size() - model_count);
+
+    std::vector<uint32_t> textures(data.textures.size());
+    for (size_t i = 0; i < data.textures.size(); i++)
+    {
+        textures[i] = image_registry::get_or_load_texture(data.get_string(data.textures[i]));
+    }
+
+    std::vector<Spatial*> nodes(data.nodes.size());
+    std::vector<glm::dmat4> world_matrices(data.nodes.size());
+
+    glm::dmat4 root_matrix = root->get_transformation_matrix();
+    uint64_t tick = registry.get_tick();
+
+    for (size_t i = 0; i < data.nodes.size(); i++)
+    {
+        const LevelNode& node = data.nodes[i];
+        Scene* parent = node.parent < 0 ? root : static_cast<Scene*>(nodes[node.parent]);
+
+        Transform transform;
+        transform.scale = glm::vec3(node.scale[0], node.scale[1], node.scale[2]);
+        transform.rotation = glm::vec3(node.rotation[0], node.rotation[1], node.rotation[2]);
+        transform.position = glm::dvec3(node.position[0], node.position[1], node.position[2]);
+
+        if (node.mesh != LEVEL_NONE)
+        {
+            Model* model = arena.get(arena.create_model(data.get_string(data.meshes[node.mesh]), shader));
+
+            if (node.texture != LEVEL_NONE) model->set_texture_override(textures[node.texture]);
+
+            parent->add_model(model);
+            nodes[i] = model;
+        }
+        else
+        {
+            Scene* scene = arena.get(arena.create_scene());
+
+            parent->add_scene(scene);
+            nodes[i] = scene;
+        }
+
+        nodes[i]->set_transform(transform);
+
+        // Parents are earlier in the table, so their matrix is already final
+        const glm::dmat4& parent_matrix = node.parent < 0 ? root_matrix : world_matrices[node.parent];
+        world_matrices[i] = transform.get_local_matrix() * parent_matrix;
+
+        WorldTransform& world = registry.get<WorldTransform>(nodes[i]->get_entity());
+        world.matrix = world_matrices[i];
+        world.updated_tick = tick;
+        world.dirty = false;
+    }
+
+    return nodes;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "node_arena.hpp"
+
+/*
+ * Binary level layout, all values little endian:
+ *
+ *   LevelHeader
+ *   LevelNode[node_count]        parents always come before their children
+ *   uint32_t[mesh_count]         string offsets of the OBJ file names
+ *   uint32_t[texture_count]      string offsets of the texture file names
+ *   char[string_size]            NUL terminated strings
+ */
+
+const char LEVEL_MAGIC[4] = { 'H', 'K', 'M', 'L' };
+const uint32_t LEVEL_VERSION = 1;
+const uint32_t LEVEL_NONE = UINT32_MAX;
+
+struct LevelHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t node_count;
+    uint32_t mesh_count;
+    uint32_t texture_count;
+    uint32_t string_size;
+};
+
+struct LevelNode
+{
+    int32_t parent;     // -1 for nodes directly below the root
+    uint32_t name;      // string offset, LEVEL_NONE if unnamed
+    uint32_t mesh;      // mesh table index, LEVEL_NONE for a plain scene node
+    uint32_t texture;   // texture table index, LEVEL_NONE keeps the material texture
+
+    float scale[3];
+    float rotation[3];
+    float position[3];
+};
+
+static_assert(sizeof(LevelHeader) == 24, "LevelHeader must match the file layout");
+static_assert(sizeof(LevelNode) == 52, "LevelNode must match the file layout");
+
+struct LevelData
+{
+    std::vector<LevelNode> nodes;
+    std::vector<uint32_t> meshes;
+    std::vector<uint32_t> textures;
+    std::string strings;
+
+    const char* get_string(uint32_t offset) const;
+
+    // Index of the first node called `name`, or -1.
+    int32_t find_node(const std::string& name) const;
+};
+
+namespace level
+{
+    // Reads the whole file with a single read and validates the tables.
+    LevelData load(const std::string path);
+    void save(const LevelData& data, const std::string path);
+
+    // One line per table entry, meant for diffing levels.
+    void export_text(const LevelData& data, std::ostream& out);
+
+    // Creates every node in `arena` below `root`. World matrices are computed in one
+    // pass over the node table, so nothing is left for the transform system to cascade.
+    // Returns the created node for every entry of the node table.
+    std::vector<Spatial*> instantiate(const LevelData& data, NodeArena& arena, Scene* root, Shader* shader);
+}
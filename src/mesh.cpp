@@ -4,6 +4,8 @@
 
 #include <stdexcept>
 
+#include "image_registry.hpp"
+
 Mesh::Mesh() {}
 
 Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, uint32_t texture)
@@ -16,33 +18,93 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, uint
 }
 
 void Mesh::draw(Shader *shader) const
+{
+    draw(shader, 0);
+}
+
+void Mesh::draw(Shader *shader, uint32_t texture_override) const
 {
     if (!initialized) throw std::runtime_error("Tried to draw an unitialized mesh.");
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    image_registry::bind_texture(texture_override != 0 ? texture_override : texture);
 
     // draw mesh
     shader->use();
     shader->set_int("our_texture", 0);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+
+    make_resident();
+    glBindVertexArray(pooled ? mesh_pool::get_vertex_array() : VAO);
+    draw_elements(1);
     glBindVertexArray(0);
 }
 
 void Mesh::initialize_mesh()
 {
-    glGenVertexArrays(1, &VAO);
+    create_buffers();
+    create_vertex_array();
+}
+
+void Mesh::create_buffers()
+{
+    if (mesh_pool::is_enabled() && mesh_pool::add(vertices.data(), vertices.size(), indices.data(), indices.size(), pool_range))
+    {
+        pooled = true;
+        has_buffers = true;
+        return;
+    }
+
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
-
+    // The index buffer goes through a target that isn't part of the VAO state, so this
+    // works without a VAO bound
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    has_buffers = true;
+}
+
+void Mesh::create_vertex_array()
+{
+    if (!has_buffers) throw std::runtime_error("Tried creating the vertex array of a mesh without buffers.");
+
+    // Drawn with the pool's vertex array, the pool is never evicted
+    if (pooled)
+    {
+        initialized = true;
+        return;
+    }
+
+    glGenVertexArrays(1, &VAO);
+
+    glBindVertexArray(VAO);
+    set_vertex_layout();
+    glBindVertexArray(0);
+
+    initialized = true;
+
+    // Releasing the storage keeps the names and the vertex layout of the VAO valid
+    uint32_t vao = VAO, vbo = VBO;
+    buffers = residency::track(ASSET_BUFFER, get_buffer_bytes(), [vao, vbo]() {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+    });
+}
+
+void Mesh::set_vertex_layout() const
+{
+    // Pooled meshes start at index 0 of the pool, draw_elements() adds their range
+    glBindBuffer(GL_ARRAY_BUFFER, pooled ? mesh_pool::get_vertex_buffer() : VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pooled ? mesh_pool::get_index_buffer() : EBO);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) 0);
@@ -52,8 +114,76 @@ void Mesh::initialize_mesh()
     
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, tex_coords));
+}
 
+void Mesh::draw_elements(uint32_t instance_count) const
+{
+    if (pooled)
+    {
+        void* first_index = (void*) ((size_t) pool_range.first_index * sizeof(uint32_t));
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, pool_range.index_count, GL_UNSIGNED_INT, first_index, instance_count, pool_range.first_vertex);
+    }
+    else
+    {
+        glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instance_count);
+    }
+}
+
+bool Mesh::is_pooled() const
+{
+    return pooled;
+}
+
+const PoolRange& Mesh::get_pool_range() const
+{
+    return pool_range;
+}
+
+void Mesh::make_resident() const
+{
+    if (pooled || residency::use(buffers)) return;
+
+    glBindVertexArray(VAO);
+    upload_buffers();
     glBindVertexArray(0);
 
-    initialized = true;
+    residency::reloaded(buffers);
+}
+
+// Expects the VAO to be bound
+void Mesh::upload_buffers() const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+}
+
+size_t Mesh::get_buffer_bytes() const
+{
+    return vertices.size() * sizeof(Vertex) + indices.size() * sizeof(uint32_t);
+}
+
+void Mesh::destroy_mesh()
+{
+    if (!has_buffers) return;
+
+    if (pooled)
+    {
+        mesh_pool::release(pool_range);
+
+        initialized = false;
+        has_buffers = false;
+        pooled = false;
+        return;
+    }
+
+    if (initialized) glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+
+    residency::untrack(buffers);
+    buffers = NO_ASSET;
+
+    initialized = false;
+    has_buffers = false;
 }
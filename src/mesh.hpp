@@ -7,6 +7,8 @@
 #include <vec2.hpp>
 
 #include "shader.hpp"
+#include "residency.hpp"
+#include "mesh_pool.hpp"
 
 struct Vertex
 {
@@ -27,10 +29,46 @@ public:
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, uint32_t texture);
 
     void draw(Shader *shader) const;
+    void draw(Shader *shader, uint32_t texture_override) const;
     void initialize_mesh();
 
+    // initialize_mesh() in two halves. Filling the buffers works on any context sharing
+    // objects with the one that draws, the vertex array has to be created on that one.
+    // With the mesh pool enabled the mesh goes into the pool if it fits.
+    void create_buffers();
+    void create_vertex_array();
+
+    // Frees the GL buffers. Copies of a mesh share them, so only the owner may call this.
+    void destroy_mesh();
+
+    size_t get_buffer_bytes() const;
+
+    // Uploads the buffers again if the residency manager evicted them.
+    void make_resident() const;
+
+    // Binds this mesh's buffers to the current VAO and points attributes 0 to 2 at them,
+    // for VAOs that add their own attributes like instancing.
+    void set_vertex_layout() const;
+
+    // Draws the mesh's triangles with the VAO that is bound, which has the layout of
+    // set_vertex_layout(). Pooled meshes draw from their range of the pool.
+    void draw_elements(uint32_t instance_count) const;
+
+    bool is_pooled() const;
+    const PoolRange& get_pool_range() const;
+
 private:
     bool initialized = false;
+    bool has_buffers = false;
+    bool pooled = false;
+
+    PoolRange pool_range;
 
     uint32_t VAO, VBO, EBO;
+
+    // Buffer storage can be evicted by the residency manager, it's uploaded again
+    // from the CPU copy when the mesh is drawn next
+    AssetId buffers = NO_ASSET;
+
+    void upload_buffers() const;
 };
@@ -0,0 +1,282 @@
+#include "mesh_pool.hpp"
+
+#include <deque>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "mesh.hpp"
+#include "residency.hpp"
+
+// Released ranges waiting for the GPU to finish the frames that drew them
+struct RetiredRanges
+{
+    // GLsync
+    void* fence;
+    std::vector<PoolRange> ranges;
+};
+
+static bool enabled = false;
+static uint32_t VAO = 0, VBO = 0, EBO = 0;
+
+// The whole pool, pinned in the residency budget
+static AssetId asset = NO_ASSET;
+
+// Free space by first element, in vertices and indices. Neighbouring ranges are merged.
+static std::map<uint32_t, uint32_t> free_vertices;
+static std::map<uint32_t, uint32_t> free_indices;
+
+static std::vector<PoolRange> released;
+static std::deque<RetiredRanges> retired;
+
+static MeshPoolStats stats;
+
+// add() can run on the upload thread while the GL thread releases
+static std::mutex mutex;
+
+// First fit, returns false if no free range is large enough
+static bool allocate_range(std::map<uint32_t, uint32_t>& free, uint32_t count, uint32_t& first)
+{
+    for (auto it = free.begin(); it != free.end(); it++)
+    {
+        if (it->second < count) continue;
+
+        first = it->first;
+        uint32_t left = it->second - count;
+        free.erase(it);
+
+        if (left > 0) free[first + count] = left;
+        return true;
+    }
+
+    return false;
+}
+
+static void free_range(std::map<uint32_t, uint32_t>& free, uint32_t first, uint32_t count)
+{
+    if (count == 0) return;
+
+    auto next = free.lower_bound(first);
+
+    if (next != free.end() && first + count == next->first)
+    {
+        count += next->second;
+        next = free.erase(next);
+    }
+
+    if (next != free.begin())
+    {
+        auto previous = std::prev(next);
+
+        if (previous->first + previous->second == first)
+        {
+            previous->second += count;
+            return;
+        }
+    }
+
+    free[first] = count;
+}
+
+static void free_ranges(const std::vector<PoolRange>& ranges)
+{
+    for (const PoolRange& range : ranges)
+    {
+        free_range(free_vertices, range.first_vertex, range.vertex_count);
+        free_range(free_indices, range.first_index, range.index_count);
+
+        stats.vertex_bytes -= range.vertex_count * sizeof(Vertex);
+        stats.index_bytes -= range.index_count * sizeof(uint32_t);
+        stats.meshes--;
+    }
+}
+
+bool mesh_pool::init(size_t vertex_bytes, size_t index_bytes)
+{
+    if (enabled) return true;
+
+    // Core since 4.3, glad only loads it when the context has it
+    if (glMultiDrawElementsIndirect == nullptr) return false;
+
+    uint32_t vertex_count = (uint32_t) (vertex_bytes / sizeof(Vertex));
+    uint32_t index_count = (uint32_t) (index_bytes / sizeof(uint32_t));
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, (size_t) vertex_count * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t) index_count * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) 0);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, normal));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, tex_coords));
+
+    // Enabled by bind(), once there is a buffer to point them at
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        glVertexAttribDivisor(POOL_DRAW_DATA_ATTRIBUTE + i, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    asset = residency::track(ASSET_BUFFER, (size_t) vertex_count * sizeof(Vertex) + (size_t) index_count * sizeof(uint32_t), nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    free_vertices = { { 0, vertex_count } };
+    free_indices = { { 0, index_count } };
+
+    stats = MeshPoolStats();
+    stats.vertex_capacity = (size_t) vertex_count * sizeof(Vertex);
+    stats.index_capacity = (size_t) index_count * sizeof(uint32_t);
+
+    enabled = true;
+    return true;
+}
+
+void mesh_pool::shutdown()
+{
+    if (!enabled) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (RetiredRanges& ranges : retired) glDeleteSync(static_cast<GLsync>(ranges.fence));
+    retired.clear();
+    released.clear();
+
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
+
+    residency::untrack(asset);
+    asset = NO_ASSET;
+
+    free_vertices.clear();
+    free_indices.clear();
+
+    enabled = false;
+}
+
+bool mesh_pool::is_enabled()
+{
+    return enabled;
+}
+
+bool mesh_pool::add(const Vertex* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count, PoolRange& range)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        uint32_t first_vertex, first_index;
+
+        if (!allocate_range(free_vertices, vertex_count, first_vertex))
+        {
+            stats.overflows++;
+            return false;
+        }
+
+        if (!allocate_range(free_indices, index_count, first_index))
+        {
+            free_range(free_vertices, first_vertex, vertex_count);
+            stats.overflows++;
+            return false;
+        }
+
+        range = PoolRange { first_vertex, vertex_count, first_index, index_count };
+
+        stats.vertex_bytes += vertex_count * sizeof(Vertex);
+        stats.index_bytes += index_count * sizeof(uint32_t);
+        stats.meshes++;
+    }
+
+    // Indices stay relative to the mesh, draws add first_vertex as their base vertex.
+    // The copy write target isn't part of any vertex array's state.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t) range.first_vertex * sizeof(Vertex), vertex_count * sizeof(Vertex), vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t) range.first_index * sizeof(uint32_t), index_count * sizeof(uint32_t), indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return true;
+}
+
+void mesh_pool::release(const PoolRange& range)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    released.push_back(range);
+}
+
+void mesh_pool::end_frame()
+{
+    if (!enabled) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    while (!retired.empty())
+    {
+        GLsync fence = static_cast<GLsync>(retired.front().fence);
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+        glDeleteSync(fence);
+        free_ranges(retired.front().ranges);
+        retired.pop_front();
+    }
+
+    if (!released.empty())
+    {
+        retired.push_back(RetiredRanges { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(released) });
+        released.clear();
+    }
+}
+
+void mesh_pool::bind(uint32_t draw_data, size_t offset)
+{
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, draw_data);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        size_t column = offset + i * 4 * sizeof(float);
+        glEnableVertexAttribArray(POOL_DRAW_DATA_ATTRIBUTE + i);
+        glVertexAttribPointer(POOL_DRAW_DATA_ATTRIBUTE + i, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*) column);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+uint32_t mesh_pool::get_vertex_array()
+{
+    return VAO;
+}
+
+uint32_t mesh_pool::get_vertex_buffer()
+{
+    return VBO;
+}
+
+uint32_t mesh_pool::get_index_buffer()
+{
+    return EBO;
+}
+
+MeshPoolStats mesh_pool::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
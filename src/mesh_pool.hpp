@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct Vertex;
+
+// One draw of glMultiDrawElementsIndirect, laid out as GL reads it from the buffer
+struct DrawElementsIndirectCommand
+{
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t base_instance;
+};
+
+// Where a mesh lives in the pool, in vertices and indices
+struct PoolRange
+{
+    uint32_t first_vertex = 0;
+    uint32_t vertex_count = 0;
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+};
+
+struct MeshPoolStats
+{
+    size_t vertex_capacity = 0;
+    size_t index_capacity = 0;
+    size_t vertex_bytes = 0;
+    size_t index_bytes = 0;
+
+    uint32_t meshes = 0;
+
+    // Meshes that didn't fit and got buffers of their own
+    uint32_t overflows = 0;
+};
+
+// Model matrix and view of each draw, a mat4 per instance in attributes 3 to 6 of the
+// pool's vertex array
+const uint32_t POOL_DRAW_DATA_ATTRIBUTE = 3;
+
+// Shared vertex and index buffers every mesh is put into on GL 4.3 and later, so meshes
+// that only differ in their geometry can be drawn with one glMultiDrawElementsIndirect.
+// The pool is allocated once with a fixed size, and counts against the residency budget
+// as a pinned buffer that is never evicted. Meshes that don't fit keep buffers of their
+// own, as they do without the pool.
+namespace mesh_pool
+{
+    // Allocates the pool if the context has glMultiDrawElementsIndirect, returns
+    // whether it did. Call on the GL thread before any mesh is created.
+    bool init(size_t vertex_bytes, size_t index_bytes);
+
+    // Frees the pool. Meshes still in it can't be drawn anymore.
+    void shutdown();
+
+    bool is_enabled();
+
+    // Copies a mesh into the pool. Works on any context sharing objects with the one
+    // that draws. Returns false when the pool is full.
+    bool add(const Vertex* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count, PoolRange& range);
+
+    // Call on the GL thread. The space is reused once the GPU finished the frames that
+    // may still draw from it.
+    void release(const PoolRange& range);
+
+    // Call once at the end of every frame, on the GL thread.
+    void end_frame();
+
+    // Binds the pool's vertex array, with its per instance mat4 read from `draw_data`
+    // starting at `offset`. Instance i of a draw reads entry base_instance + i.
+    void bind(uint32_t draw_data, size_t offset);
+
+    uint32_t get_vertex_array();
+    uint32_t get_vertex_buffer();
+    uint32_t get_index_buffer();
+
+    MeshPoolStats get_stats();
+}
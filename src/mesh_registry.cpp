@@ -0,0 +1,153 @@
+#include "mesh_registry.hpp"
+
+#include <stdexcept>
+#include <map>
+#include <mutex>
+
+//#define OBJL_CONSOLE_OUTPUT
+#include <OBJ_Loader.h>
+
+#include "path_helper.hpp"
+#include "image_registry.hpp"
+
+static std::map<std::string, ModelData> loaded_models;
+
+static std::mutex decoded_models_mutex;
+static std::map<std::string, std::shared_ptr<const ModelSource>> decoded_models;
+
+static std::shared_ptr<const ModelSource> parse_obj(const std::string& file_name)
+{
+    objl::Loader loader;
+
+    if (!loader.LoadFile(OBJ_PATH + file_name))
+    {
+        throw std::runtime_error("Failed to load obj file `" + file_name + "`.");
+    }
+
+    std::shared_ptr<ModelSource> source = std::make_shared<ModelSource>();
+    source->bounds = AABB::empty();
+
+    std::shared_ptr<TriangleBVH> collision = std::make_shared<TriangleBVH>();
+
+    for (objl::Mesh m : loader.LoadedMeshes)
+    {
+        MeshData mesh;
+        mesh.vertices.resize(m.Vertices.size());
+
+        for (size_t i = 0; i < m.Vertices.size(); i++)
+        {
+            glm::vec3 pos(m.Vertices[i].Position.X,
+                m.Vertices[i].Position.Y,
+                m.Vertices[i].Position.Z);
+
+            glm::vec3 normal(m.Vertices[i].Normal.X,
+                m.Vertices[i].Normal.Y,
+                m.Vertices[i].Normal.Z);
+
+            glm::vec2 tex_coords(m.Vertices[i].TextureCoordinate.X,
+                m.Vertices[i].TextureCoordinate.Y);
+
+            mesh.vertices[i] = Vertex { pos, normal, tex_coords };
+
+            source->bounds.expand(pos);
+        }
+
+        mesh.indices = m.Indices;
+        mesh.texture_name = m.MeshMaterial.map_Kd;
+
+        collision->add_mesh(mesh.vertices, mesh.indices);
+
+        source->meshes.push_back(std::move(mesh));
+    }
+
+    collision->build();
+    source->collision = collision;
+
+    return source;
+}
+
+std::shared_ptr<const ModelSource> mesh_registry::decode_model(const std::string file_name)
+{
+    {
+        std::lock_guard<std::mutex> lock(decoded_models_mutex);
+
+        auto it = decoded_models.find(file_name);
+        if (it != decoded_models.end()) return it->second;
+    }
+
+    // Parse outside the lock, two threads racing on the same file just do the work twice
+    std::shared_ptr<const ModelSource> source = parse_obj(file_name);
+
+    std::lock_guard<std::mutex> lock(decoded_models_mutex);
+    return decoded_models.emplace(file_name, source).first->second;
+}
+
+const ModelData& mesh_registry::load_model(const std::string file_name)
+{
+    if (loaded_models.count(file_name))
+    {
+        throw std::runtime_error("Tried to load model `" + file_name + "`, which already exists.");
+    }
+
+    return upload_model(file_name, *decode_model(file_name));
+}
+
+const ModelData& mesh_registry::upload_model(const std::string file_name, const ModelSource& source)
+{
+    if (loaded_models.count(file_name))
+    {
+        throw std::runtime_error("Tried to upload model `" + file_name + "`, which already exists.");
+    }
+
+    ModelData data;
+    data.bounds = source.bounds;
+    data.collision = source.collision;
+
+    for (const MeshData& mesh_data : source.meshes)
+    {
+        uint32_t texture = image_registry::get_or_load_texture(mesh_data.texture_name);
+
+        data.meshes.push_back(Mesh(mesh_data.vertices, mesh_data.indices, texture));
+    }
+
+    return loaded_models[file_name] = std::move(data);
+}
+
+const ModelData& mesh_registry::get_model(const std::string file_name)
+{
+    if (!loaded_models.count(file_name))
+    {
+        throw std::runtime_error("Tried to get model `" + file_name + "`, which hasn't been loaded yet.");
+    }
+
+    return loaded_models[file_name];
+}
+
+const ModelData& mesh_registry::register_model(const std::string file_name, ModelData data)
+{
+    auto loaded = loaded_models.find(file_name);
+    if (loaded != loaded_models.end())
+    {
+        for (Mesh& mesh : data.meshes) mesh.destroy_mesh();
+        return loaded->second;
+    }
+
+    return loaded_models[file_name] = std::move(data);
+}
+
+bool mesh_registry::is_loaded(const std::string file_name)
+{
+    return loaded_models.count(file_name) > 0;
+}
+
+const ModelData& mesh_registry::get_or_load_model(const std::string file_name)
+{
+    if (!loaded_models.count(file_name))
+    {
+        return load_model(file_name);
+    }
+    else
+    {
+        return get_model(file_name);
+    }
+}
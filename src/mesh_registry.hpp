@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mesh.hpp"
+#include "bounds.hpp"
+#include "bvh.hpp"
+
+// CPU side of a mesh, before it has a texture or any GL buffers
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::string texture_name;
+};
+
+struct ModelSource
+{
+    std::vector<MeshData> meshes;
+    AABB bounds;
+
+    // Over the triangles of every mesh, built with the rest of the model
+    std::shared_ptr<const TriangleBVH> collision;
+};
+
+struct ModelData
+{
+    std::vector<Mesh> meshes;
+    AABB bounds;
+    std::shared_ptr<const TriangleBVH> collision;
+};
+
+// OBJ files are loaded once and shared by every model that uses them.
+namespace mesh_registry
+{
+    const ModelData& load_model(const std::string file_name);
+
+    const ModelData& get_model(const std::string file_name);
+
+    const ModelData& get_or_load_model(const std::string file_name);
+
+    bool is_loaded(const std::string file_name);
+
+    // Creates the meshes of a decoded model and registers them under `file_name`,
+    // loading whichever of its textures aren't loaded yet.
+    const ModelData& upload_model(const std::string file_name, const ModelSource& source);
+
+    // Registers meshes created elsewhere. If the file was registered in the meantime,
+    // the meshes of `data` are destroyed and the registered model is returned.
+    const ModelData& register_model(const std::string file_name, ModelData data);
+
+    // Parses an OBJ file without touching GL. Safe to call from any thread, every
+    // file is only parsed once and then shared.
+    std::shared_ptr<const ModelSource> decode_model(const std::string file_name);
+};
@@ -6,20 +6,28 @@
 #include <mat4x4.hpp>
 
 #include "spatial.hpp"
-#include "mesh.hpp"
+#include "mesh_registry.hpp"
+#include "bounds.hpp"
+#include "stream_buffer.hpp"
+
+const ComponentMask MODEL_COMPONENTS = SPATIAL_COMPONENTS | COMPONENT_MESH_REF | COMPONENT_BOUNDS | COMPONENT_COLLIDER;
 
 class Model : public Spatial
 {
 public:
     Model(const char *file_name, Shader* shader);
+    ~Model();
+
+    // Draws on its own, outside the render system. `view` is the camera's double precision view.
+    void draw(const glm::dmat4& view, StreamBuffer& draw_data) const;
 
-    void draw() const;
-    void draw(const Transform& parent_transform) const;
+    // Draws every mesh with `texture` instead of its material texture, 0 restores them.
+    void set_texture_override(uint32_t texture);
+
+    const AABB& get_local_bounds() const;
 
 private:
     Shader* shader;
 
-    std::vector<Mesh> meshes;
-
-    void load_model(const char *file_name);
+    const ModelData* data;
 };
@@ -0,0 +1,171 @@
+#include "node_arena.hpp"
+
+NodeArena::~NodeArena()
+{
+    clear();
+}
+
+Handle<Model> NodeArena::create_model(const char *file_name, Shader* shader)
+{
+    Handle<Model> handle = models.create(file_name, shader);
+
+    Model* model = models.get(handle);
+    model->arena = this;
+    model->arena_slot = handle.index;
+
+    return handle;
+}
+
+Handle<Scene> NodeArena::create_scene()
+{
+    Handle<Scene> handle = scenes.create();
+
+    Scene* scene = scenes.get(handle);
+    scene->arena = this;
+    scene->arena_slot = handle.index;
+
+    return handle;
+}
+
+Model* NodeArena::get(Handle<Model> handle) const
+{
+    return models.get(handle);
+}
+
+Scene* NodeArena::get(Handle<Scene> handle) const
+{
+    return scenes.get(handle);
+}
+
+Handle<Model> NodeArena::get_handle(const Model* model) const
+{
+    return models.get_handle(model->arena_slot);
+}
+
+Handle<Scene> NodeArena::get_handle(const Scene* scene) const
+{
+    return scenes.get_handle(scene->arena_slot);
+}
+
+void NodeArena::destroy(Handle<Model> handle)
+{
+    models.destroy(handle);
+}
+
+void NodeArena::destroy(Handle<Scene> handle)
+{
+    destroy(std::vector<Handle<Scene>> { handle });
+}
+
+void NodeArena::destroy(const std::vector<Handle<Scene>>& handles)
+{
+    std::vector<Handle<Model>> doomed_models;
+    std::vector<Handle<Scene>> doomed_scenes;
+
+    for (Handle<Scene> handle : handles)
+    {
+        Scene* scene = scenes.get(handle);
+        if (scene == nullptr) continue;
+
+        if (scene->parent_scene != nullptr) scene->parent_scene->remove_scene(scene);
+
+        collect_subtree(scene, doomed_models, doomed_scenes);
+    }
+
+    // Nothing links into the subtrees anymore, so the nodes can go without unlinking.
+    // Handles collected twice through nested roots are stale by then and ignored.
+    for (Handle<Model> handle : doomed_models)
+    {
+        models.destroy(handle);
+    }
+
+    for (Handle<Scene> handle : doomed_scenes)
+    {
+        scenes.destroy(handle);
+    }
+}
+
+void NodeArena::collect_subtree(Scene* scene, std::vector<Handle<Model>>& models_out, std::vector<Handle<Scene>>& scenes_out)
+{
+    for (size_t i = scene->child_models.size(); i-- > 0;)
+    {
+        Model* child = scene->child_models[i];
+
+        if (child->arena == this)
+        {
+            child->parent_scene = nullptr;
+            models_out.push_back(models.get_handle(child->arena_slot));
+        }
+        else
+        {
+            scene->remove_model(child);
+        }
+    }
+
+    for (size_t i = scene->child_scenes.size(); i-- > 0;)
+    {
+        Scene* child = scene->child_scenes[i];
+
+        if (child->arena == this)
+        {
+            child->parent_scene = nullptr;
+            collect_subtree(child, models_out, scenes_out);
+        }
+        else
+        {
+            scene->remove_scene(child);
+        }
+    }
+
+    scene->child_models.clear();
+    scene->child_scenes.clear();
+
+    scenes_out.push_back(scenes.get_handle(scene->arena_slot));
+}
+
+void NodeArena::clear()
+{
+    // Parents owned by someone else have to forget about our nodes
+    models.for_each([&](Handle<Model>, Model& model) {
+        if (model.parent_scene != nullptr && model.parent_scene->arena != this)
+        {
+            model.parent_scene->remove_model(&model);
+        }
+        model.parent_scene = nullptr;
+    });
+
+    scenes.for_each([&](Handle<Scene>, Scene& scene) {
+        if (scene.parent_scene != nullptr && scene.parent_scene->arena != this)
+        {
+            scene.parent_scene->remove_scene(&scene);
+        }
+        scene.parent_scene = nullptr;
+
+        // Children owned by someone else survive and lose their parent
+        for (size_t i = scene.child_models.size(); i-- > 0;)
+        {
+            if (scene.child_models[i]->arena != this) scene.remove_model(scene.child_models[i]);
+        }
+
+        for (size_t i = scene.child_scenes.size(); i-- > 0;)
+        {
+            if (scene.child_scenes[i]->arena != this) scene.remove_scene(scene.child_scenes[i]);
+        }
+
+        scene.child_models.clear();
+        scene.child_scenes.clear();
+    });
+
+    models.clear();
+    scenes.clear();
+}
+
+size_t NodeArena::get_model_count() const
+{
+    return models.size();
+}
+
+size_t NodeArena::get_scene_count() const
+{
+    return scenes.size();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "pool.hpp"
+#include "model.hpp"
+#include "scene.hpp"
+
+// Owns the models and scenes of one level or world chunk. Nodes are created in
+// typed pools and referred to by generational handles, and the whole arena can be
+// released at once instead of deleting node by node.
+class NodeArena
+{
+public:
+    NodeArena() = default;
+    ~NodeArena();
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator = (const NodeArena&) = delete;
+
+    Handle<Model> create_model(const char *file_name, Shader* shader);
+    Handle<Scene> create_scene();
+
+    Model* get(Handle<Model> handle) const;
+    Scene* get(Handle<Scene> handle) const;
+
+    // Only valid for nodes created by this arena.
+    Handle<Model> get_handle(const Model* model) const;
+    Handle<Scene> get_handle(const Scene* scene) const;
+
+    void destroy(Handle<Model> handle);
+
+    // Destroys the scene together with every node below it that this arena owns.
+    void destroy(Handle<Scene> handle);
+
+    // Same as destroying every scene on its own, but only the subtree roots are
+    // unlinked from their parents. Everything inside the subtrees is dropped as is.
+    void destroy(const std::vector<Handle<Scene>>& handles);
+
+    // Releases every node. Only nodes attached to scenes of other arenas are detached,
+    // links between nodes of this arena are simply dropped.
+    void clear();
+
+    size_t get_model_count() const;
+    size_t get_scene_count() const;
+
+private:
+    Pool<Model> models;
+    Pool<Scene> scenes;
+
+    void collect_subtree(Scene* scene, std::vector<Handle<Model>>& models_out, std::vector<Handle<Scene>>& scenes_out);
+};
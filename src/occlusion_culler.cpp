@@ -0,0 +1,498 @@
+#include "occlusion_culler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include <geometric.hpp>
+#include <matrix.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t BLOCK_SIZE = 8;
+
+// Vertices and triangles per setup job
+static const uint32_t SETUP_GRAIN = 256;
+
+// A triangle clipped by the near plane and the four sides has at most this many vertices
+static const uint32_t MAX_CLIPPED = 8;
+
+// Near, left, right, bottom, top, as dot(plane, clip) >= 0 inside. Triangles are only
+// clipped at the sides of a band this many times the screen, the edge functions and the
+// bounding rectangle take care of the rest.
+static const float GUARD_BAND = 4.0f;
+
+static const glm::vec4 SCREEN_PLANES[5] = {
+    glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),
+    glm::vec4(1.0f, 0.0f, 0.0f, 1.0f),
+    glm::vec4(-1.0f, 0.0f, 0.0f, 1.0f),
+    glm::vec4(0.0f, 1.0f, 0.0f, 1.0f),
+    glm::vec4(0.0f, -1.0f, 0.0f, 1.0f),
+};
+
+static const glm::vec4 CLIP_PLANES[5] = {
+    glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),
+    glm::vec4(1.0f, 0.0f, 0.0f, GUARD_BAND),
+    glm::vec4(-1.0f, 0.0f, 0.0f, GUARD_BAND),
+    glm::vec4(0.0f, 1.0f, 0.0f, GUARD_BAND),
+    glm::vec4(0.0f, -1.0f, 0.0f, GUARD_BAND),
+};
+
+// Counter clockwise seen from outside, corners numbered by x, y and z in bits 0 to 2
+static const uint32_t BOX_INDICES[36] = {
+    0, 2, 3, 0, 3, 1,
+    4, 5, 7, 4, 7, 6,
+    0, 4, 6, 0, 6, 2,
+    1, 3, 7, 1, 7, 5,
+    0, 1, 5, 0, 5, 4,
+    2, 6, 7, 2, 7, 3,
+};
+
+static double milliseconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Bit i is set when the vertex is outside planes[i]
+static uint32_t get_outside_planes(const glm::vec4* planes, const glm::vec4& clip)
+{
+    uint32_t outside = 0;
+
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        if (glm::dot(planes[i], clip) < 0.0f) outside |= 1 << i;
+    }
+
+    return outside;
+}
+
+static uint32_t clip_polygon(glm::vec4* polygon, uint32_t count, glm::vec4* scratch)
+{
+    for (const glm::vec4& plane : CLIP_PLANES)
+    {
+        uint32_t clipped = 0;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const glm::vec4& a = polygon[i];
+            const glm::vec4& b = polygon[(i + 1) % count];
+
+            float distance_a = glm::dot(plane, a);
+            float distance_b = glm::dot(plane, b);
+
+            if (distance_a >= 0.0f) scratch[clipped++] = a;
+
+            if ((distance_a >= 0.0f) != (distance_b >= 0.0f))
+            {
+                scratch[clipped++] = a + (b - a) * (distance_a / (distance_a - distance_b));
+            }
+        }
+
+        std::copy(scratch, scratch + clipped, polygon);
+        count = clipped;
+
+        if (count < 3) return 0;
+    }
+
+    return count;
+}
+
+OcclusionCuller::OcclusionCuller(const OcclusionConfig& config) : config(config)
+{
+    if (config.band_height == 0 || config.band_height % BLOCK_SIZE != 0)
+    {
+        throw std::runtime_error("Occlusion bands have to be a multiple of " + std::to_string(BLOCK_SIZE) + " rows.");
+    }
+
+    width = (config.width + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    height = (config.height + config.band_height - 1) / config.band_height * config.band_height;
+    blocks_x = width / BLOCK_SIZE;
+
+    depth.assign(width * height, 0.0f);
+    block_depth.assign(blocks_x * (height / BLOCK_SIZE), 0.0f);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+    finish();
+}
+
+void OcclusionCuller::begin_frame(const glm::mat4& projection, const glm::dmat4& view)
+{
+    finish();
+
+    // Only the rotation, occluders and bounds are made camera relative first
+    camera_position = glm::dvec3(glm::inverse(view)[3]);
+    view_projection = glm::mat4(glm::dmat4(projection) * glm::dmat4(glm::dmat3(view)));
+
+    vertices.clear();
+    indices.clear();
+    rasterized = false;
+
+    stats = OcclusionStats();
+}
+
+void OcclusionCuller::add_triangles(const glm::vec3* new_vertices, uint32_t vertex_count, const uint32_t* new_indices, uint32_t index_count)
+{
+    if (running || rasterized) throw std::runtime_error("Tried adding occluders to a frame that is already rasterized.");
+
+    uint32_t first = vertices.size();
+
+    vertices.insert(vertices.end(), new_vertices, new_vertices + vertex_count);
+    for (uint32_t i = 0; i < index_count; i++) indices.push_back(first + new_indices[i]);
+
+    stats.occluder_triangles += index_count / 3;
+}
+
+void OcclusionCuller::add_box(const AABB& box, const glm::dmat4& world)
+{
+    glm::vec3 corners[8];
+
+    for (uint32_t c = 0; c < 8; c++)
+    {
+        glm::dvec3 local((c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y, (c & 4) ? box.max.z : box.min.z);
+        corners[c] = glm::vec3(glm::dvec3(world * glm::dvec4(local, 1.0)) - camera_position);
+    }
+
+    // Mirroring turns the faces inside out
+    if (glm::determinant(glm::dmat3(world)) < 0.0)
+    {
+        uint32_t mirrored[36];
+
+        for (uint32_t i = 0; i < 36; i += 3)
+        {
+            mirrored[i] = BOX_INDICES[i];
+            mirrored[i + 1] = BOX_INDICES[i + 2];
+            mirrored[i + 2] = BOX_INDICES[i + 1];
+        }
+
+        add_triangles(corners, 8, mirrored, 36);
+        return;
+    }
+
+    add_triangles(corners, 8, BOX_INDICES, 36);
+}
+
+void OcclusionCuller::rasterize()
+{
+    if (running || rasterized) throw std::runtime_error("Tried rasterizing the occluders of a frame twice.");
+
+    running = true;
+    rasterized = true;
+
+    jobs::run([this]() { rasterize_all(); }, &rasterizing);
+}
+
+void OcclusionCuller::finish()
+{
+    if (!running) return;
+
+    Clock::time_point start = Clock::now();
+
+    // Only helps with ordinary jobs, chunk builds and file loads are background jobs and
+    // stay with the workers
+    running = false;
+    jobs::wait(rasterizing);
+
+    stats.wait_ms = milliseconds_since(start);
+}
+
+void OcclusionCuller::rasterize_all()
+{
+    Clock::time_point start = Clock::now();
+
+    std::fill(depth.begin(), depth.end(), 0.0f);
+    setups.clear();
+
+    // Vertices are shared by several triangles, they are transformed once
+    clip_vertices.resize(vertices.size());
+
+    jobs::parallel_for(vertices.size(), SETUP_GRAIN, [this](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) clip_vertices[i] = view_projection * glm::vec4(vertices[i], 1.0f);
+    });
+
+    jobs::parallel_for(indices.size() / 3, SETUP_GRAIN, [this](uint32_t begin, uint32_t end) {
+        std::vector<TriangleSetup> setup;
+        setup_triangles(begin, end, setup);
+
+        std::lock_guard<std::mutex> lock(setups_mutex);
+        setups.insert(setups.end(), setup.begin(), setup.end());
+    });
+
+    jobs::parallel_for(height / config.band_height, 1, [this](uint32_t begin, uint32_t end) {
+        for (uint32_t band = begin; band < end; band++) rasterize_band(band);
+    });
+
+    stats.rasterized_triangles = setups.size();
+    stats.rasterize_ms = milliseconds_since(start);
+}
+
+void OcclusionCuller::setup_triangles(uint32_t begin, uint32_t end, std::vector<TriangleSetup>& out) const
+{
+    glm::vec4 polygon[MAX_CLIPPED], scratch[MAX_CLIPPED];
+
+    for (uint32_t triangle = begin; triangle < end; triangle++)
+    {
+        uint32_t outside_all = ~0u, outside_any = 0;
+
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            polygon[i] = clip_vertices[indices[triangle * 3 + i]];
+
+            outside_all &= get_outside_planes(SCREEN_PLANES, polygon[i]);
+            outside_any |= get_outside_planes(CLIP_PLANES, polygon[i]);
+        }
+
+        // Off screen beyond one side, or within the guard band and nothing to clip
+        if (outside_all != 0) continue;
+
+        uint32_t count = outside_any == 0 ? 3 : clip_polygon(polygon, 3, scratch);
+
+        // The clipped polygon is convex, a fan splits it
+        for (uint32_t i = 1; i + 1 < count; i++)
+        {
+            glm::vec4 clip[3] = { polygon[0], polygon[i], polygon[i + 1] };
+            add_setup(clip, out);
+        }
+    }
+}
+
+void OcclusionCuller::add_setup(const glm::vec4* clip, std::vector<TriangleSetup>& out) const
+{
+    // Screen space with rows from the top, and 1 / w as depth
+    glm::vec3 screen[3];
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        float inverse_w = 1.0f / clip[i].w;
+        screen[i] = glm::vec3((clip[i].x * inverse_w * 0.5f + 0.5f) * width, (0.5f - clip[i].y * inverse_w * 0.5f) * height, inverse_w);
+    }
+
+    float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+
+    // Rows going down mirror the winding, front faces have a negative area here. Back
+    // faces are always behind a front face of the same occluder.
+    if (!(area < 0.0f)) return;
+
+    std::swap(screen[1], screen[2]);
+    area = -area;
+
+    TriangleSetup setup;
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        const glm::vec3& a = screen[i];
+        const glm::vec3& b = screen[(i + 1) % 3];
+
+        setup.edges[i] = glm::vec3(a.y - b.y, b.x - a.x, (b.y - a.y) * a.x - (b.x - a.x) * a.y);
+    }
+
+    glm::vec3 d1 = screen[1] - screen[0], d2 = screen[2] - screen[0];
+    float depth_x = (d1.z * d2.y - d2.z * d1.y) / area;
+    float depth_y = (d2.z * d1.x - d1.z * d2.x) / area;
+    setup.depth = glm::vec3(depth_x, depth_y, screen[0].z - depth_x * screen[0].x - depth_y * screen[0].y);
+
+    // Pixels whose centre can be inside
+    float min_x = std::min({ screen[0].x, screen[1].x, screen[2].x }), max_x = std::max({ screen[0].x, screen[1].x, screen[2].x });
+    float min_y = std::min({ screen[0].y, screen[1].y, screen[2].y }), max_y = std::max({ screen[0].y, screen[1].y, screen[2].y });
+
+    setup.min_x = std::max((int32_t) std::ceil(min_x - 0.5f), 0);
+    setup.min_y = std::max((int32_t) std::ceil(min_y - 0.5f), 0);
+    setup.max_x = std::min((int32_t) std::floor(max_x - 0.5f), (int32_t) width - 1);
+    setup.max_y = std::min((int32_t) std::floor(max_y - 0.5f), (int32_t) height - 1);
+
+    if (setup.min_x > setup.max_x || setup.min_y > setup.max_y) return;
+
+    out.push_back(setup);
+}
+
+void OcclusionCuller::rasterize_band(uint32_t band)
+{
+    int32_t first_row = band * config.band_height;
+    int32_t last_row = first_row + config.band_height - 1;
+
+    for (const TriangleSetup& setup : setups)
+    {
+        if (setup.max_y < first_row || setup.min_y > last_row) continue;
+
+        int32_t start_y = std::max(setup.min_y, first_row);
+        int32_t end_y = std::min(setup.max_y, last_row);
+
+        // Four pixels at a time, the width is a multiple of four so the last group fits
+        int32_t start_x = setup.min_x & ~3;
+
+        for (int32_t y = start_y; y <= end_y; y++)
+        {
+            float center_x = start_x + 0.5f, center_y = y + 0.5f;
+            float* row = depth.data() + y * width;
+
+            float edge0 = setup.edges[0].x * center_x + setup.edges[0].y * center_y + setup.edges[0].z;
+            float edge1 = setup.edges[1].x * center_x + setup.edges[1].y * center_y + setup.edges[1].z;
+            float edge2 = setup.edges[2].x * center_x + setup.edges[2].y * center_y + setup.edges[2].z;
+            float z = setup.depth.x * center_x + setup.depth.y * center_y + setup.depth.z;
+
+#ifdef OCCLUSION_SSE
+            __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+            __m128 zero = _mm_setzero_ps();
+
+            __m128 e0 = _mm_add_ps(_mm_set1_ps(edge0), _mm_mul_ps(_mm_set1_ps(setup.edges[0].x), lanes));
+            __m128 e1 = _mm_add_ps(_mm_set1_ps(edge1), _mm_mul_ps(_mm_set1_ps(setup.edges[1].x), lanes));
+            __m128 e2 = _mm_add_ps(_mm_set1_ps(edge2), _mm_mul_ps(_mm_set1_ps(setup.edges[2].x), lanes));
+            __m128 zs = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(_mm_set1_ps(setup.depth.x), lanes));
+
+            __m128 step0 = _mm_set1_ps(setup.edges[0].x * 4.0f);
+            __m128 step1 = _mm_set1_ps(setup.edges[1].x * 4.0f);
+            __m128 step2 = _mm_set1_ps(setup.edges[2].x * 4.0f);
+            __m128 step_z = _mm_set1_ps(setup.depth.x * 4.0f);
+
+            for (int32_t x = start_x; x <= setup.max_x; x += 4)
+            {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+
+                if (_mm_movemask_ps(inside) != 0)
+                {
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_max_ps(old, zs);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+                }
+
+                e0 = _mm_add_ps(e0, step0);
+                e1 = _mm_add_ps(e1, step1);
+                e2 = _mm_add_ps(e2, step2);
+                zs = _mm_add_ps(zs, step_z);
+            }
+#else
+            for (int32_t x = start_x; x <= setup.max_x; x++)
+            {
+                if (edge0 >= 0.0f && edge1 >= 0.0f && edge2 >= 0.0f) row[x] = std::max(row[x], z);
+
+                edge0 += setup.edges[0].x;
+                edge1 += setup.edges[1].x;
+                edge2 += setup.edges[2].x;
+                z += setup.depth.x;
+            }
+#endif
+        }
+    }
+
+    // Farthest depth of every block, a test closer than that is occluded by the whole block
+    for (uint32_t block_y = first_row / BLOCK_SIZE; block_y <= (uint32_t) last_row / BLOCK_SIZE; block_y++)
+    {
+        for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+        {
+            float farthest = INFINITY;
+
+            for (uint32_t y = block_y * BLOCK_SIZE; y < (block_y + 1) * BLOCK_SIZE; y++)
+            {
+                const float* row = depth.data() + y * width + block_x * BLOCK_SIZE;
+                for (uint32_t x = 0; x < BLOCK_SIZE; x++) farthest = std::min(farthest, row[x]);
+            }
+
+            block_depth[block_y * blocks_x + block_x] = farthest;
+        }
+    }
+}
+
+bool OcclusionCuller::is_occluded(const AABB& world_bounds)
+{
+    finish();
+
+    if (!rasterized) return false;
+
+    Clock::time_point start = Clock::now();
+    stats.tested++;
+
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    float nearest = 0.0f;
+
+    for (uint32_t c = 0; c < 8; c++)
+    {
+        glm::dvec3 corner((c & 1) ? world_bounds.max.x : world_bounds.min.x, (c & 2) ? world_bounds.max.y : world_bounds.min.y, (c & 4) ? world_bounds.max.z : world_bounds.min.z);
+        glm::vec4 clip = view_projection * glm::vec4(glm::vec3(corner - camera_position), 1.0f);
+
+        if (clip.z < -clip.w)
+        {
+            stats.test_ms += milliseconds_since(start);
+            return false;
+        }
+
+        float inverse_w = 1.0f / clip.w;
+        float x = (clip.x * inverse_w * 0.5f + 0.5f) * width;
+        float y = (0.5f - clip.y * inverse_w * 0.5f) * height;
+
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        nearest = std::max(nearest, inverse_w);
+    }
+
+    // Every pixel the bounds touch, not just the ones whose centre they cover
+    int32_t first_x = std::max((int32_t) std::floor(min_x), 0);
+    int32_t first_y = std::max((int32_t) std::floor(min_y), 0);
+    int32_t last_x = std::min((int32_t) std::floor(max_x), (int32_t) width - 1);
+    int32_t last_y = std::min((int32_t) std::floor(max_y), (int32_t) height - 1);
+
+    bool occluded = first_x <= last_x && first_y <= last_y;
+
+    for (int32_t block_y = first_y / BLOCK_SIZE; occluded && block_y <= last_y / (int32_t) BLOCK_SIZE; block_y++)
+    {
+        for (int32_t block_x = first_x / BLOCK_SIZE; occluded && block_x <= last_x / (int32_t) BLOCK_SIZE; block_x++)
+        {
+            if (block_depth[block_y * blocks_x + block_x] > nearest) continue;
+
+            int32_t end_y = std::min(last_y, (block_y + 1) * (int32_t) BLOCK_SIZE - 1);
+            int32_t end_x = std::min(last_x, (block_x + 1) * (int32_t) BLOCK_SIZE - 1);
+
+            for (int32_t y = std::max(first_y, block_y * (int32_t) BLOCK_SIZE); occluded && y <= end_y; y++)
+            {
+                for (int32_t x = std::max(first_x, block_x * (int32_t) BLOCK_SIZE); x <= end_x; x++)
+                {
+                    if (depth[y * width + x] <= nearest)
+                    {
+                        occluded = false;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (occluded) stats.occluded++;
+    stats.test_ms += milliseconds_since(start);
+
+    return occluded;
+}
+
+const glm::dvec3& OcclusionCuller::get_camera_position() const
+{
+    return camera_position;
+}
+
+uint32_t OcclusionCuller::get_width() const
+{
+    return width;
+}
+
+uint32_t OcclusionCuller::get_height() const
+{
+    return height;
+}
+
+const float* OcclusionCuller::get_depth()
+{
+    finish();
+    return depth.data();
+}
+
+const OcclusionStats& OcclusionCuller::get_stats() const
+{
+    return stats;
+}
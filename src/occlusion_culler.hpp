@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <vec3.hpp>
+#include <vec4.hpp>
+#include <mat4x4.hpp>
+
+#include "bounds.hpp"
+#include "jobs.hpp"
+
+struct OcclusionConfig
+{
+    // Of the depth buffer, independent of the window. The width is rounded up to a
+    // multiple of 8 and the height to a multiple of band_height.
+    uint32_t width = 320;
+    uint32_t height = 160;
+
+    // Rows rasterized by one job, a multiple of 8
+    uint32_t band_height = 16;
+};
+
+struct OcclusionStats
+{
+    // During the last frame
+    uint32_t occluder_triangles = 0;
+
+    // Left after clipping and back face culling, a clipped triangle can become several
+    uint32_t rasterized_triangles = 0;
+
+    uint32_t tested = 0;
+    uint32_t occluded = 0;
+
+    // Rasterizing runs on the job system while the frame goes on, waiting is what the
+    // frame still paid for it
+    double rasterize_ms = 0.0;
+    double wait_ms = 0.0;
+    double test_ms = 0.0;
+};
+
+// Software occlusion culling. Simplified occluders, solid shapes that lie inside what
+// they stand in for, are rasterized into a small depth buffer on the CPU, and bounds
+// are tested against it before anything is submitted. Only bounds that are behind the
+// occluders at every pixel they cover are occluded, so a missing occluder costs
+// draws, never holes.
+//
+// The buffer stores 1 / view depth, which is linear across a triangle on screen, of
+// the nearest occluder at each pixel. Every 8x8 block keeps its farthest value too, so
+// most tests only look at a few blocks. Pixels are filled four at a time with SSE2
+// where the compiler has it.
+//
+// Occluders are added in world space and kept camera relative, so precision doesn't
+// depend on how far the camera is from the origin.
+class OcclusionCuller
+{
+public:
+    explicit OcclusionCuller(const OcclusionConfig& config = OcclusionConfig());
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator = (const OcclusionCuller&) = delete;
+
+    // Starts collecting the occluders of a frame seen through `projection` and `view`.
+    // Waits for the previous frame's rasterization if nothing did yet.
+    void begin_frame(const glm::mat4& projection, const glm::dmat4& view);
+
+    // Triangles with their vertices relative to get_camera_position(), counter
+    // clockwise seen from outside like everything GL draws
+    void add_triangles(const glm::vec3* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count);
+
+    // A solid box in the space of `world`
+    void add_box(const AABB& box, const glm::dmat4& world);
+
+    // Queues rasterizing everything added on the job system and returns. Occluders
+    // can't be added to this frame anymore.
+    void rasterize();
+
+    // Waits for rasterize(). Tests call it themselves.
+    void finish();
+
+    // Whether `world_bounds` are hidden behind the occluders. Bounds reaching the near
+    // plane or outside the buffer are never occluded, that is left to frustum culling.
+    bool is_occluded(const AABB& world_bounds);
+
+    const glm::dvec3& get_camera_position() const;
+    uint32_t get_width() const;
+    uint32_t get_height() const;
+
+    // 1 / view depth of the nearest occluder at each pixel, 0 where there is none, rows
+    // from the top of the screen. Waits for rasterize().
+    const float* get_depth();
+
+    const OcclusionStats& get_stats() const;
+
+private:
+    // A triangle on screen: edge functions that are positive inside, 1 / depth as a
+    // plane, and the pixels it can cover
+    struct TriangleSetup
+    {
+        glm::vec3 edges[3];
+        glm::vec3 depth;
+        int32_t min_x, min_y, max_x, max_y;
+    };
+
+    OcclusionConfig config;
+    uint32_t width, height;
+
+    std::vector<float> depth;
+    std::vector<float> block_depth;
+    uint32_t blocks_x;
+
+    glm::dvec3 camera_position = glm::dvec3(0.0);
+    glm::mat4 view_projection = glm::mat4(1.0f);
+
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<glm::vec4> clip_vertices;
+
+    std::vector<TriangleSetup> setups;
+    std::mutex setups_mutex;
+
+    JobCounter rasterizing;
+    bool running = false;
+    bool rasterized = false;
+
+    OcclusionStats stats;
+
+    void rasterize_all();
+    void setup_triangles(uint32_t begin, uint32_t end, std::vector<TriangleSetup>& out) const;
+    void add_setup(const glm::vec4* clip, std::vector<TriangleSetup>& out) const;
+    void rasterize_band(uint32_t band);
+};
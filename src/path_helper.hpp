@@ -8,5 +8,6 @@ const std::string RESOURCES_PATH = get_process_path() + "resources/";
 const std::string TEXTURES_PATH = RESOURCES_PATH + "texture/";
 const std::string OBJ_PATH = RESOURCES_PATH + "model/obj/";
 const std::string MTL_PATH = OBJ_PATH;
+const std::string LEVEL_PATH = RESOURCES_PATH + "level/";
 
 
@@ -4,12 +4,15 @@
 #include <vec3.hpp>
 
 // Camera variables
-static glm::vec3 camera_pos;
+static glm::dvec3 camera_pos;
+static glm::dvec3 previous_camera_pos;
+static glm::dvec3 view_pos;
+static glm::vec3 camera_velocity;
 static glm::vec3 camera_rot;
 static glm::vec3 campera_front;
 static glm::vec3 camera_up;
 
-static glm::mat4 view_matrix;
+static glm::dmat4 view_matrix;
 
 static float movement_speed;
 static float camera_sensitivity;
@@ -18,7 +21,10 @@ static float camera_last_x, camera_last_y;
 
 void player::init(int swidth, int sheight)
 {
-    camera_pos = glm::vec3(0.0f, 0.0f, 3.0f);
+    camera_pos = glm::dvec3(0.0, 0.0, 3.0);
+    previous_camera_pos = camera_pos;
+    view_pos = camera_pos;
+    camera_velocity = glm::vec3(0.0f, 0.0f, 0.0f);
     camera_rot = glm::vec3(0.0f, -90.0f, 0.0f);
     campera_front = glm::vec3(0.0f, 0.0f, -1.0f);
     camera_up = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -32,15 +38,26 @@ void player::init(int swidth, int sheight)
     regenerate_view_matrix();
 }
 
-const glm::mat4& player::get_view_matrix()
+const glm::dmat4& player::get_view_matrix()
 {
     return view_matrix;
 }
 
+const glm::dvec3& player::get_position()
+{
+    return camera_pos;
+}
+
+const glm::vec3& player::get_velocity()
+{
+    return camera_velocity;
+}
+
 void player::handle_movement(GLFWwindow *window, float delta_time)
 {
     // Get movement direction
     glm::vec3 movement_direction = glm::vec3(0.0f, 0.0f, 0.0f);
+    camera_velocity = glm::vec3(0.0f, 0.0f, 0.0f);
 
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
     {
@@ -74,9 +91,8 @@ void player::handle_movement(GLFWwindow *window, float delta_time)
         movement_direction = glm::normalize(movement_direction);
 
         // Apply the movement
-        camera_pos += movement_direction * movement_speed * delta_time;
-        
-        regenerate_view_matrix();
+        camera_velocity = movement_direction * movement_speed;
+        camera_pos += glm::dvec3(camera_velocity * delta_time);
     }
 }
 
@@ -122,12 +138,20 @@ void player::handle_mouse(GLFWwindow* window, double xpos, double ypos)
 
 void player::update(GLFWwindow *window, float delta_time)
 {
+    previous_camera_pos = camera_pos;
+
     // Handle Input
     handle_movement(window, delta_time);
 }
 
+void player::interpolate(float alpha)
+{
+    view_pos = previous_camera_pos + (camera_pos - previous_camera_pos) * (double) alpha;
+    regenerate_view_matrix();
+}
+
 void player::regenerate_view_matrix()
 {
-    view_matrix = glm::lookAt(camera_pos, camera_pos + campera_front, camera_up);
+    view_matrix = glm::lookAt(view_pos, view_pos + glm::dvec3(campera_front), glm::dvec3(camera_up));
 }
 
@@ -1,18 +1,30 @@
 #pragma once
 
 #include <GLFW/glfw3.h>
+#include <vec3.hpp>
 #include <mat4x4.hpp>
 
 namespace player
 {
     void init(int swidth, int sheight);
 
-    const glm::mat4& get_view_matrix();
+    // Double precision, so it can be taken relative to models far from the origin
+    // before anything is turned into floats for the GPU.
+    const glm::dmat4& get_view_matrix();
+
+    // Position after the last simulation tick, the view is interpolated towards it.
+    const glm::dvec3& get_position();
+    const glm::vec3& get_velocity();
 
     void handle_movement(GLFWwindow *window, float delta_time);
     void handle_mouse(GLFWwindow* window, double xpos, double ypos);
 
+    // Runs once per simulation tick.
     void update(GLFWwindow *window, float delta_time);
 
+    // Places the view `alpha` of the way from the position before the last tick to the
+    // current one. Looking around isn't simulated and always uses the latest mouse input.
+    void interpolate(float alpha);
+
     void regenerate_view_matrix();
 }
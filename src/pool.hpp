@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+template<typename T>
+struct Handle
+{
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool is_null() const { return index == UINT32_MAX; }
+
+    bool operator == (const Handle& h) const { return index == h.index && generation == h.generation; }
+    bool operator != (const Handle& h) const { return !(*this == h); }
+};
+
+// Fixed-size chunks of slots, so objects never move once created and neighbours
+// share cache lines. Freed slots are reused through an intrusive free list and
+// every reuse bumps the slot's generation, which invalidates stale handles.
+template<typename T, uint32_t CHUNK_SIZE = 64>
+class Pool
+{
+public:
+    Pool() = default;
+    ~Pool() { clear(); }
+
+    Pool(const Pool&) = delete;
+    Pool& operator = (const Pool&) = delete;
+
+    template<typename... Args> Handle<T> create(Args&&... args);
+    void destroy(Handle<T> handle);
+
+    bool is_alive(Handle<T> handle) const;
+    T* get(Handle<T> handle) const;
+
+    // Handle of whatever currently lives in the slot at `index`.
+    Handle<T> get_handle(uint32_t index) const { return Handle<T> { index, generations[index] }; }
+
+    // Calls function(Handle<T>, T&) for every live object, in memory order.
+    template<typename F> void for_each(F function);
+
+    // Destroys every object and releases all chunks. Generations are kept, so
+    // handles from before the clear stay invalid.
+    void clear();
+
+    size_t size() const { return count; }
+
+private:
+    struct Slot
+    {
+        alignas(T) unsigned char storage[sizeof(T)];
+        uint32_t next_free = UINT32_MAX;
+        bool alive = false;
+
+        T* get() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    std::vector<uint32_t> generations;
+
+    uint32_t first_free = UINT32_MAX;
+    size_t count = 0;
+
+    Slot& get_slot(uint32_t index) const { return chunks[index / CHUNK_SIZE][index % CHUNK_SIZE]; }
+    uint32_t acquire_slot();
+};
+
+template<typename T, uint32_t CHUNK_SIZE>
+uint32_t Pool<T, CHUNK_SIZE>::acquire_slot()
+{
+    if (first_free == UINT32_MAX)
+    {
+        uint32_t base = chunks.size() * CHUNK_SIZE;
+        chunks.push_back(std::unique_ptr<Slot[]>(new Slot[CHUNK_SIZE]));
+
+        if (generations.size() < base + CHUNK_SIZE)
+        {
+            generations.resize(base + CHUNK_SIZE, 0);
+        }
+
+        // Link the new slots in ascending order so allocation stays sequential
+        for (uint32_t i = 0; i < CHUNK_SIZE; i++)
+        {
+            get_slot(base + i).next_free = (i + 1 < CHUNK_SIZE) ? base + i + 1 : UINT32_MAX;
+        }
+        first_free = base;
+    }
+
+    uint32_t index = first_free;
+    first_free = get_slot(index).next_free;
+
+    return index;
+}
+
+template<typename T, uint32_t CHUNK_SIZE>
+template<typename... Args>
+Handle<T> Pool<T, CHUNK_SIZE>::create(Args&&... args)
+{
+    uint32_t index = acquire_slot();
+    Slot& slot = get_slot(index);
+
+    try
+    {
+        new (slot.storage) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        slot.next_free = first_free;
+        first_free = index;
+        throw;
+    }
+
+    slot.alive = true;
+    count++;
+
+    return Handle<T> { index, generations[index] };
+}
+
+template<typename T, uint32_t CHUNK_SIZE>
+void Pool<T, CHUNK_SIZE>::destroy(Handle<T> handle)
+{
+    if (!is_alive(handle)) return;
+
+    Slot& slot = get_slot(handle.index);
+    slot.get()->~T();
+    slot.alive = false;
+
+    generations[handle.index]++;
+
+    slot.next_free = first_free;
+    first_free = handle.index;
+    count--;
+}
+
+template<typename T, uint32_t CHUNK_SIZE>
+bool Pool<T, CHUNK_SIZE>::is_alive(Handle<T> handle) const
+{
+    return handle.index < chunks.size() * CHUNK_SIZE
+        && generations[handle.index] == handle.generation
+        && get_slot(handle.index).alive;
+}
+
+template<typename T, uint32_t CHUNK_SIZE>
+T* Pool<T, CHUNK_SIZE>::get(Handle<T> handle) const
+{
+    if (!is_alive(handle)) return nullptr;
+
+    return get_slot(handle.index).get();
+}
+
+template<typename T, uint32_t CHUNK_SIZE>
+template<typename F>
+void Pool<T, CHUNK_SIZE>::for_each(F function)
+{
+    for (uint32_t index = 0; index < chunks.size() * CHUNK_SIZE; index++)
+    {
+        Slot& slot = get_slot(index);
+
+        if (slot.alive)
+        {
+            function(Handle<T> { index, generations[index] }, *slot.get());
+        }
+    }
+}
+
+template<typename T, uint32_t CHUNK_SIZE>
+void Pool<T, CHUNK_SIZE>::clear()
+{
+    for (uint32_t index = 0; index < chunks.size() * CHUNK_SIZE; index++)
+    {
+        Slot& slot = get_slot(index);
+
+        if (slot.alive)
+        {
+            slot.get()->~T();
+            generations[index]++;
+        }
+    }
+
+    chunks.clear();
+    first_free = UINT32_MAX;
+    count = 0;
+}
@@ -0,0 +1,203 @@
+#include "render_thread.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+typedef std::chrono::steady_clock Clock;
+
+RenderThread::RenderThread(GLFWwindow* window, const FramePacingConfig& pacing, DrawFunction draw)
+{
+    this->window = window;
+    this->pacing = pacing;
+    this->draw = draw;
+
+    // Monitors can only be asked about on the main thread
+    if (this->pacing.refresh_rate <= 0.0) this->pacing.refresh_rate = FramePacer::get_refresh_rate();
+
+    released = pacing.low_latency ? 1 : PACKET_COUNT;
+    latencies.reserve(FramePacer::FRAME_HISTORY);
+
+    glfwMakeContextCurrent(nullptr);
+    thread = std::thread(&RenderThread::loop, this);
+}
+
+RenderThread::~RenderThread()
+{
+    stop();
+}
+
+FramePacket& RenderThread::begin_packet()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]() { return begun < released || error; });
+
+    if (error) std::rethrow_exception(error);
+
+    FramePacket& packet = packets[begun % PACKET_COUNT];
+    packet.frame = begun++;
+    packet.draw_list.clear();
+
+    return packet;
+}
+
+void RenderThread::submit_packet()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (submitted == begun) throw std::runtime_error("Tried submitting a frame packet that wasn't begun.");
+
+    submitted++;
+    condition.notify_all();
+}
+
+void RenderThread::run_synchronized(const std::function<void()>& function)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (error) std::rethrow_exception(error);
+
+    synchronized = &function;
+    condition.notify_all();
+
+    condition.wait(lock, [this]() { return synchronized == nullptr || error; });
+
+    if (error) std::rethrow_exception(error);
+
+    if (synchronized_error)
+    {
+        std::exception_ptr rethrown = synchronized_error;
+        synchronized_error = nullptr;
+        std::rethrow_exception(rethrown);
+    }
+}
+
+void RenderThread::stop()
+{
+    if (!thread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        condition.notify_all();
+    }
+
+    thread.join();
+    glfwMakeContextCurrent(window);
+}
+
+RenderStats RenderThread::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void RenderThread::loop()
+{
+    glfwMakeContextCurrent(window);
+
+    try
+    {
+        FramePacer pacer(pacing);
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true)
+        {
+            condition.wait(lock, [this]() { return stopping || submitted > drawn || synchronized != nullptr; });
+
+            // Packets before synchronized work, they may point at things it destroys
+            if (submitted > drawn)
+            {
+                const FramePacket& packet = packets[drawn % PACKET_COUNT];
+
+                lock.unlock();
+                draw(packet);
+                lock.lock();
+
+                // Done with the packet's draw list already, so the main thread doesn't
+                // have to wait for the swap
+                if (submitted == drawn + 1) run_pending(lock);
+
+                lock.unlock();
+                glfwSwapBuffers(window);
+                pacer.end_frame();
+
+                Clock::time_point presented = Clock::now();
+
+                // Sleeps until the latest start in low latency mode
+                pacer.begin_frame();
+                lock.lock();
+
+                record_latency(packet, presented, pacer);
+
+                drawn++;
+                released = drawn + (pacing.low_latency ? 1 : PACKET_COUNT);
+                condition.notify_all();
+                continue;
+            }
+
+            if (synchronized != nullptr)
+            {
+                run_pending(lock);
+                continue;
+            }
+
+            if (stopping) break;
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = std::current_exception();
+        condition.notify_all();
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+void RenderThread::run_pending(std::unique_lock<std::mutex>& lock)
+{
+    if (synchronized == nullptr) return;
+
+    // The main thread is blocked until this is done, so the function can use whatever
+    // it likes
+    lock.unlock();
+
+    try
+    {
+        (*synchronized)();
+    }
+    catch (...)
+    {
+        synchronized_error = std::current_exception();
+    }
+
+    lock.lock();
+
+    synchronized = nullptr;
+    condition.notify_all();
+}
+
+void RenderThread::record_latency(const FramePacket& packet, std::chrono::steady_clock::time_point presented, const FramePacer& pacer)
+{
+    double latency = std::chrono::duration<double, std::milli>(presented - packet.input_time).count();
+
+    if (latencies.size() < FramePacer::FRAME_HISTORY) latencies.push_back(latency);
+    else latencies[next_latency] = latency;
+    next_latency = (next_latency + 1) % FramePacer::FRAME_HISTORY;
+
+    double sum = 0.0, worst = 0.0;
+    for (double l : latencies)
+    {
+        sum += l;
+        worst = std::max(worst, l);
+    }
+
+    stats.latency_mean_ms = sum / latencies.size();
+    stats.latency_worst_ms = worst;
+    stats.pacing = pacer.get_stats();
+    stats.present_mode = pacer.get_present_mode();
+}
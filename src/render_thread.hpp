@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <vec2.hpp>
+#include <mat4x4.hpp>
+
+#include "systems.hpp"
+#include "frame_pacer.hpp"
+
+// Declared here so the header can come before glad
+struct GLFWwindow;
+
+// Everything the render thread needs for one frame. The main thread fills it and doesn't
+// touch it again until it has been drawn.
+struct FramePacket
+{
+    uint64_t frame = 0;
+
+    glm::mat4 projection;
+    glm::dmat4 view;
+    glm::ivec2 screen_size;
+
+    DrawList draw_list;
+
+    // When the input the frame is based on was read
+    std::chrono::steady_clock::time_point input_time;
+};
+
+struct RenderStats
+{
+    FrameTimeStats pacing;
+    PresentMode present_mode = PRESENT_VSYNC;
+
+    // From reading input to the frame being presented, over the last
+    // FramePacer::FRAME_HISTORY frames
+    double latency_mean_ms = 0.0;
+    double latency_worst_ms = 0.0;
+};
+
+// Owns the GL context and submits frames on its own thread, so the main thread can
+// simulate and cull the next frame while the last one is drawn and presented. The two
+// exchange FramePackets: at most PACKET_COUNT frames are in flight, which bounds how far
+// presented frames trail the input. In low latency mode only one is, and frames aren't
+// pipelined.
+//
+// The render thread never reads the registry. Work that needs both GL and the registry,
+// like streaming, goes through run_synchronized() while the main thread waits.
+class RenderThread
+{
+public:
+    static const uint32_t PACKET_COUNT = 2;
+
+    typedef std::function<void(const FramePacket&)> DrawFunction;
+
+    // Takes over the window's context, which has to be current on the calling thread.
+    // `draw` runs on the render thread for every packet, before the buffers are swapped.
+    RenderThread(GLFWwindow* window, const FramePacingConfig& pacing, DrawFunction draw);
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator = (const RenderThread&) = delete;
+
+    // Blocks until a packet is free and the pacer lets the next frame start. Call
+    // before reading input.
+    FramePacket& begin_packet();
+    void submit_packet();
+
+    // Runs `function` on the render thread once every submitted packet has been drawn,
+    // and blocks until it is done. Rethrows what it throws.
+    void run_synchronized(const std::function<void()>& function);
+
+    // Drains the submitted packets, joins the thread and makes the context current on
+    // the calling thread again.
+    void stop();
+
+    RenderStats get_stats();
+
+private:
+    GLFWwindow* window;
+    FramePacingConfig pacing;
+    DrawFunction draw;
+
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    FramePacket packets[PACKET_COUNT];
+    uint64_t begun = 0;
+    uint64_t submitted = 0;
+    uint64_t drawn = 0;
+
+    // Packets the main thread may begin, moved on by the render thread after each frame
+    uint64_t released = 0;
+
+    const std::function<void()>* synchronized = nullptr;
+    std::exception_ptr synchronized_error;
+
+    std::vector<double> latencies;
+    uint32_t next_latency = 0;
+    RenderStats stats;
+
+    std::exception_ptr error;
+
+    void loop();
+    void run_pending(std::unique_lock<std::mutex>& lock);
+    void record_latency(const FramePacket& packet, std::chrono::steady_clock::time_point presented, const FramePacer& pacer);
+};
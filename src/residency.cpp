@@ -0,0 +1,147 @@
+#include "residency.hpp"
+
+#include <algorithm>
+#include <vector>
+
+struct ResidentAsset
+{
+    AssetKind kind;
+    size_t bytes = 0;
+    uint64_t last_used = 0;
+    bool resident = false;
+    bool alive = false;
+
+    std::function<void()> evict;
+};
+
+static std::vector<ResidentAsset> assets;
+static std::vector<AssetId> free_ids;
+
+static uint64_t frame = 1;
+static ResidencyStats stats = { 512 * 1024 * 1024 };
+
+static size_t& bytes_of(AssetKind kind)
+{
+    return kind == ASSET_TEXTURE ? stats.texture_bytes : stats.buffer_bytes;
+}
+
+static uint32_t& count_of(AssetKind kind)
+{
+    return kind == ASSET_TEXTURE ? stats.resident_textures : stats.resident_buffers;
+}
+
+static void set_resident(ResidentAsset& asset, bool resident)
+{
+    if (asset.resident == resident) return;
+
+    asset.resident = resident;
+
+    if (resident)
+    {
+        bytes_of(asset.kind) += asset.bytes;
+        count_of(asset.kind)++;
+    }
+    else
+    {
+        bytes_of(asset.kind) -= asset.bytes;
+        count_of(asset.kind)--;
+    }
+}
+
+AssetId residency::track(AssetKind kind, size_t bytes, std::function<void()> evict)
+{
+    AssetId id;
+
+    if (!free_ids.empty())
+    {
+        id = free_ids.back();
+        free_ids.pop_back();
+    }
+    else
+    {
+        id = assets.size();
+        assets.emplace_back();
+    }
+
+    ResidentAsset& asset = assets[id];
+    asset.kind = kind;
+    asset.bytes = bytes;
+    asset.last_used = frame;
+    asset.alive = true;
+    asset.evict = std::move(evict);
+
+    set_resident(asset, true);
+    if (!asset.evict) stats.pinned_bytes += bytes;
+
+    return id;
+}
+
+void residency::untrack(AssetId id)
+{
+    if (id == NO_ASSET || id >= assets.size() || !assets[id].alive) return;
+
+    ResidentAsset& asset = assets[id];
+    set_resident(asset, false);
+    if (!asset.evict) stats.pinned_bytes -= asset.bytes;
+
+    asset.alive = false;
+    asset.evict = nullptr;
+
+    free_ids.push_back(id);
+}
+
+bool residency::use(AssetId id)
+{
+    ResidentAsset& asset = assets[id];
+    asset.last_used = frame;
+
+    return asset.resident;
+}
+
+void residency::reloaded(AssetId id)
+{
+    ResidentAsset& asset = assets[id];
+    asset.last_used = frame;
+
+    set_resident(asset, true);
+    stats.reloads++;
+}
+
+void residency::set_budget(size_t bytes)
+{
+    stats.budget_bytes = bytes;
+}
+
+void residency::end_frame()
+{
+    if (stats.texture_bytes + stats.buffer_bytes > stats.budget_bytes)
+    {
+        std::vector<AssetId> candidates;
+
+        for (AssetId id = 0; id < assets.size(); id++)
+        {
+            const ResidentAsset& asset = assets[id];
+            if (asset.alive && asset.resident && asset.evict && asset.last_used < frame) candidates.push_back(id);
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](AssetId a, AssetId b) {
+            return assets[a].last_used < assets[b].last_used;
+        });
+
+        for (AssetId id : candidates)
+        {
+            if (stats.texture_bytes + stats.buffer_bytes <= stats.budget_bytes) break;
+
+            assets[id].evict();
+            set_resident(assets[id], false);
+            stats.evictions++;
+        }
+    }
+
+    frame++;
+}
+
+const ResidencyStats& residency::get_stats()
+{
+    return stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+enum AssetKind : uint32_t
+{
+    ASSET_TEXTURE,
+    ASSET_BUFFER,
+};
+
+typedef uint32_t AssetId;
+const AssetId NO_ASSET = UINT32_MAX;
+
+struct ResidencyStats
+{
+    size_t budget_bytes = 0;
+    size_t texture_bytes = 0;
+    size_t buffer_bytes = 0;
+
+    // Part of the above that can't be evicted
+    size_t pinned_bytes = 0;
+
+    uint32_t resident_textures = 0;
+    uint32_t resident_buffers = 0;
+
+    // Totals since startup
+    uint32_t evictions = 0;
+    uint32_t reloads = 0;
+};
+
+// Accounts the GPU memory of every texture and mesh buffer and keeps it under a budget.
+// When over budget, the assets drawn least recently have their storage released. Their
+// GL names stay valid, so whoever draws one next notices it through use() and uploads
+// its data again.
+namespace residency
+{
+    // `evict` frees the storage but has to keep the GL names alive. Assets without it
+    // are pinned, they count against the budget but are never evicted.
+    AssetId track(AssetKind kind, size_t bytes, std::function<void()> evict);
+
+    // For assets deleted by their owner, doesn't call evict.
+    void untrack(AssetId id);
+
+    // Marks the asset as drawn this frame. Returns false if it was evicted, the caller
+    // then uploads it again and calls reloaded().
+    bool use(AssetId id);
+    void reloaded(AssetId id);
+
+    void set_budget(size_t bytes);
+
+    // Call once at the end of every frame. Assets drawn during the frame are never evicted.
+    void end_frame();
+
+    const ResidencyStats& get_stats();
+}
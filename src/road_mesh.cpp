@@ -0,0 +1,92 @@
+#include "road_mesh.hpp"
+
+#include <cmath>
+
+#include <vec2.hpp>
+#include <geometric.hpp>
+
+const RoadProfile road_mesh::ROAD = {
+    "road.png",
+    {
+        { -2.5f, 0.0f, 0.0001f },
+        { -2.5f, 0.1f, 0.0455f },
+        { 2.5f, 0.1f, 0.9545f },
+        { 2.5f, 0.0f, 0.9999f },
+    },
+    10.0f,
+};
+
+const RoadProfile road_mesh::LEFT_VERGE = {
+    "grass_1.png",
+    {
+        { -25.0f, 0.0f, -2.5f },
+        { -2.5f, 0.0f, -0.25f },
+    },
+    10.0f,
+};
+
+const RoadProfile road_mesh::RIGHT_VERGE = {
+    "grass_1.png",
+    {
+        { 2.5f, 0.0f, 0.25f },
+        { 25.0f, 0.0f, 2.5f },
+    },
+    10.0f,
+};
+
+void road_mesh::extrude(const RoadProfile& profile, const RouteChunk& chunk, MeshData& mesh, AABB& bounds)
+{
+    const std::vector<ProfilePoint>& points = profile.points;
+    const glm::vec3 up(0.0f, 1.0f, 0.0f);
+
+    // Normals of the cross section, averaged over the edges on either side of a point
+    std::vector<glm::vec2> normals;
+    for (size_t j = 0; j < points.size(); j++)
+    {
+        glm::vec2 normal(0.0f, 0.0f);
+
+        if (j > 0) normal += glm::vec2(points[j - 1].y - points[j].y, points[j].x - points[j - 1].x);
+        if (j + 1 < points.size()) normal += glm::vec2(points[j].y - points[j + 1].y, points[j + 1].x - points[j].x);
+
+        normals.push_back(glm::normalize(normal));
+    }
+
+    // Whole repeats are dropped, keeping v small without moving the texture
+    float v_origin = std::floor(chunk.start_distance / profile.repeat_length) * profile.repeat_length;
+
+    uint32_t base = mesh.vertices.size();
+    uint32_t width = points.size();
+
+    for (size_t i = 0; i < chunk.centerline.size(); i++)
+    {
+        glm::vec3 center = chunk.centerline[i] - chunk.origin;
+        glm::vec3 direction = chunk.centerline_direction[i];
+        glm::vec3 right = glm::normalize(glm::vec3(-direction.z, 0.0f, direction.x));
+
+        float v = (chunk.centerline_distance[i] - v_origin) / profile.repeat_length;
+
+        for (size_t j = 0; j < points.size(); j++)
+        {
+            Vertex vertex;
+            vertex.position = center + right * points[j].x + up * points[j].y;
+            vertex.normal = right * normals[j].x + up * normals[j].y;
+            vertex.tex_coords = glm::vec2(points[j].u, v);
+
+            mesh.vertices.push_back(vertex);
+            bounds.expand(vertex.position);
+        }
+    }
+
+    for (uint32_t i = 0; i + 1 < chunk.centerline.size(); i++)
+    {
+        for (uint32_t j = 0; j + 1 < width; j++)
+        {
+            uint32_t a = base + i * width + j;
+            uint32_t b = a + width;
+
+            mesh.indices.insert(mesh.indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+        }
+    }
+
+    mesh.texture_name = profile.texture_name;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "route.hpp"
+#include "bounds.hpp"
+#include "mesh_registry.hpp"
+
+// A point of a cross section, x to the right of the direction of travel and y up
+struct ProfilePoint
+{
+    float x;
+    float y;
+
+    // Texture coordinate across the road, v runs along it
+    float u;
+};
+
+struct RoadProfile
+{
+    const char* texture_name;
+
+    // Left to right
+    std::vector<ProfilePoint> points;
+
+    // Metres of road per repeat of the texture along it
+    float repeat_length;
+};
+
+// Builds road meshes by sweeping cross sections along the centre line of spline routes.
+// Every chunk is extruded on its own, a chunk's vertices only exist while it's streamed in.
+namespace road_mesh
+{
+    // The cross section of road_straight.obj, 5m wide and 10cm high.
+    extern const RoadProfile ROAD;
+
+    // Grass from the road's edge out to where the trees end.
+    extern const RoadProfile LEFT_VERGE;
+    extern const RoadProfile RIGHT_VERGE;
+
+    // Appends the profile swept along the chunk's centre line to `mesh`, in the chunk's
+    // space. Texture coordinates along the road follow the route distance, so they line
+    // up across chunks.
+    void extrude(const RoadProfile& profile, const RouteChunk& chunk, MeshData& mesh, AABB& bounds);
+}
@@ -0,0 +1,368 @@
+#include "route.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <vec2.hpp>
+#include <common.hpp>
+#include <geometric.hpp>
+#include <trigonometric.hpp>
+#include <gtc/constants.hpp>
+
+// Where the road enters and leaves each tile in its own model space, and which way it
+// is heading there. A yaw of zero heads down -z.
+struct TileShape
+{
+    glm::vec3 entry;
+    float entry_yaw;
+    glm::vec3 exit;
+    float exit_yaw;
+    float length;
+};
+
+const float CURVE_RADIUS = 25.0f;
+const glm::vec3 CURVE_CENTER(15.0f, 0.0f, 15.0f);
+const uint32_t CURVE_SAMPLES = 8;
+
+// Spline control points are 30 to 60m apart and turn up to 25 degrees at a time, which
+// keeps the tightest bends well wider than the grass beside the road
+const float SPLINE_MIN_STEP = 30.0f;
+const float SPLINE_MAX_STEP = 60.0f;
+const float SPLINE_MAX_TURN = glm::radians(25.0f);
+const float SPLINE_MAX_HEADING_OFFSET = glm::radians(75.0f);
+
+// Centre line points are added until neighbours differ by at most this angle, or are
+// at most this far apart on straights
+const float SPLINE_MAX_ANGLE = glm::radians(2.0f);
+const float SPLINE_MAX_PIECE = 20.0f;
+const float SPLINE_MIN_PIECE = 0.5f;
+
+// The left curve is the right curve driven the other way round
+static const TileShape TILE_SHAPES[] = {
+    { glm::vec3(0.0f, 0.0f, 5.0f), 0.0f, glm::vec3(0.0f, 0.0f, -5.0f), 0.0f, 10.0f },
+    { glm::vec3(-10.0f, 0.0f, 15.0f), 0.0f, glm::vec3(15.0f, 0.0f, -10.0f), -glm::half_pi<float>(), CURVE_RADIUS * glm::half_pi<float>() },
+    { glm::vec3(15.0f, 0.0f, -10.0f), glm::half_pi<float>(), glm::vec3(-10.0f, 0.0f, 15.0f), glm::pi<float>(), CURVE_RADIUS * glm::half_pi<float>() },
+};
+
+static glm::vec3 rotate_y(const glm::vec3& v, float yaw)
+{
+    float c = std::cos(yaw), s = std::sin(yaw);
+    return glm::vec3(c * v.x + s * v.z, v.y, -s * v.x + c * v.z);
+}
+
+static glm::vec3 yaw_direction(float yaw)
+{
+    return rotate_y(glm::vec3(0.0f, 0.0f, -1.0f), yaw);
+}
+
+// Centripetal Catmull-Rom segment from p[1] to p[2], evaluated with the Barry-Goldman
+// pyramid so the derivative comes out of the same pass
+struct SplineSegment
+{
+    glm::vec3 p[4];
+    float knots[4];
+
+    SplineSegment(const glm::vec3* points)
+    {
+        knots[0] = 0.0f;
+
+        for (int i = 0; i < 4; i++)
+        {
+            p[i] = points[i];
+            if (i > 0) knots[i] = knots[i - 1] + std::max(std::sqrt(glm::length(p[i] - p[i - 1])), 0.001f);
+        }
+    }
+
+    void evaluate(float t, glm::vec3& position, glm::vec3& derivative) const
+    {
+        const float* k = knots;
+
+        glm::vec3 a1 = ((k[1] - t) * p[0] + (t - k[0]) * p[1]) / (k[1] - k[0]);
+        glm::vec3 a2 = ((k[2] - t) * p[1] + (t - k[1]) * p[2]) / (k[2] - k[1]);
+        glm::vec3 a3 = ((k[3] - t) * p[2] + (t - k[2]) * p[3]) / (k[3] - k[2]);
+
+        glm::vec3 da1 = (p[1] - p[0]) / (k[1] - k[0]);
+        glm::vec3 da2 = (p[2] - p[1]) / (k[2] - k[1]);
+        glm::vec3 da3 = (p[3] - p[2]) / (k[3] - k[2]);
+
+        glm::vec3 b1 = ((k[2] - t) * a1 + (t - k[0]) * a2) / (k[2] - k[0]);
+        glm::vec3 b2 = ((k[3] - t) * a2 + (t - k[1]) * a3) / (k[3] - k[1]);
+
+        glm::vec3 db1 = (a2 - a1 + (k[2] - t) * da1 + (t - k[0]) * da2) / (k[2] - k[0]);
+        glm::vec3 db2 = (a3 - a2 + (k[3] - t) * da2 + (t - k[1]) * da3) / (k[3] - k[1]);
+
+        position = ((k[2] - t) * b1 + (t - k[1]) * b2) / (k[2] - k[1]);
+        derivative = (b2 - b1 + (k[2] - t) * db1 + (t - k[1]) * db2) / (k[2] - k[1]);
+    }
+};
+
+// Appends the points of the segment between parameters `start` and `end`, without the
+// one at `start`, splitting it wherever the direction changes too much
+static void tessellate(const SplineSegment& segment, float start, float end, const glm::vec3& start_position, const glm::vec3& start_derivative,
+    std::vector<glm::vec3>& points, std::vector<glm::vec3>& directions, uint32_t depth)
+{
+    glm::vec3 end_position, end_derivative;
+    segment.evaluate(end, end_position, end_derivative);
+
+    float chord = glm::length(end_position - start_position);
+    float cos_angle = glm::dot(glm::normalize(start_derivative), glm::normalize(end_derivative));
+
+    bool bends = cos_angle < std::cos(SPLINE_MAX_ANGLE);
+    if (depth < 16 && chord > SPLINE_MIN_PIECE && (bends || chord > SPLINE_MAX_PIECE))
+    {
+        float middle = (start + end) * 0.5f;
+
+        glm::vec3 middle_position, middle_derivative;
+        segment.evaluate(middle, middle_position, middle_derivative);
+
+        tessellate(segment, start, middle, start_position, start_derivative, points, directions, depth + 1);
+        tessellate(segment, middle, end, middle_position, middle_derivative, points, directions, depth + 1);
+        return;
+    }
+
+    points.push_back(end_position);
+    directions.push_back(glm::normalize(end_derivative));
+}
+
+static uint32_t hash_chunk(uint32_t seed, uint32_t index)
+{
+    uint32_t h = seed ^ (index * 0x9E3779B9u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+Route::Route(const glm::vec3& origin, const glm::vec3& heading, uint32_t pieces_per_chunk, uint32_t seed, RouteStyle style)
+    : pieces_per_chunk(pieces_per_chunk), seed(seed), style(style), random(seed), end_position(origin)
+{
+    if (pieces_per_chunk == 0)
+    {
+        throw std::runtime_error("A route needs at least one tile or segment per chunk.");
+    }
+
+    end_yaw = std::atan2(-heading.x, -heading.z);
+    end_direction = yaw_direction(end_yaw);
+
+    start_yaw = end_yaw;
+    control_yaw = 0.0f;
+
+    if (style == ROUTE_SPLINE)
+    {
+        // Both sides of the origin on the heading, so the road leaves it straight
+        control_points.push_back(origin - end_direction * SPLINE_MIN_STEP);
+        control_points.push_back(origin);
+        control_points.push_back(origin + end_direction * SPLINE_MIN_STEP);
+    }
+}
+
+const RouteChunk& Route::get_chunk(uint32_t index)
+{
+    while (chunks.size() <= index)
+    {
+        generate_chunk();
+    }
+
+    return chunks[index];
+}
+
+std::vector<glm::vec3> Route::get_nearby_centerline(uint32_t index)
+{
+    std::vector<glm::vec3> centerline;
+
+    uint32_t first = index > 0 ? index - 1 : 0;
+
+    for (uint32_t c = first; c <= index + 1; c++)
+    {
+        const RouteChunk& chunk = get_chunk(c);
+        centerline.insert(centerline.end(), chunk.centerline.begin(), chunk.centerline.end());
+    }
+
+    return centerline;
+}
+
+const char* Route::get_tile_model(TileType type)
+{
+    return type == TILE_STRAIGHT ? "road_straight.obj" : "road_curve_90deg_20m.obj";
+}
+
+TileType Route::pick_tile()
+{
+    // Keep a few straights between curves so curve tiles don't overlap
+    if (tiles_since_curve < 3 || random() % 4 != 0)
+    {
+        tiles_since_curve++;
+        return TILE_STRAIGHT;
+    }
+
+    tiles_since_curve = 0;
+
+    bool right;
+    if (turns > 0) right = false;
+    else if (turns < 0) right = true;
+    else right = random() % 2 == 0;
+
+    turns += right ? 1 : -1;
+    return right ? TILE_CURVE_RIGHT : TILE_CURVE_LEFT;
+}
+
+void Route::generate_chunk()
+{
+    RouteChunk chunk;
+    chunk.index = chunks.size();
+    chunk.seed = hash_chunk(seed, chunk.index);
+    chunk.origin = end_position;
+    chunk.start_distance = end_distance;
+
+    chunk.centerline.push_back(end_position);
+    chunk.centerline_distance.push_back(end_distance);
+    chunk.centerline_direction.push_back(end_direction);
+
+    if (style == ROUTE_SPLINE)
+    {
+        generate_spline_chunk(chunk);
+        return;
+    }
+
+    for (uint32_t i = 0; i < pieces_per_chunk; i++)
+    {
+        TileType type = pick_tile();
+        const TileShape& shape = TILE_SHAPES[type];
+
+        RouteTile tile;
+        tile.type = type;
+        tile.yaw = end_yaw - shape.entry_yaw;
+        tile.position = end_position - rotate_y(shape.entry, tile.yaw);
+        tile.start_distance = end_distance;
+        tile.length = shape.length;
+
+        if (type == TILE_STRAIGHT)
+        {
+            chunk.centerline.push_back(tile.position + rotate_y(shape.exit, tile.yaw));
+            chunk.centerline_distance.push_back(end_distance + shape.length);
+            chunk.centerline_direction.push_back(yaw_direction(tile.yaw + shape.exit_yaw));
+        }
+        else
+        {
+            for (uint32_t s = 1; s <= CURVE_SAMPLES; s++)
+            {
+                float t = (float) s / CURVE_SAMPLES;
+
+                // The right curve sweeps from pointing -x to pointing -z around its centre
+                float angle = glm::pi<float>() + glm::half_pi<float>() * (type == TILE_CURVE_RIGHT ? t : 1.0f - t);
+                glm::vec3 local = CURVE_CENTER + CURVE_RADIUS * glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+
+                chunk.centerline.push_back(tile.position + rotate_y(local, tile.yaw));
+                chunk.centerline_distance.push_back(end_distance + shape.length * t);
+                chunk.centerline_direction.push_back(yaw_direction(tile.yaw + glm::mix(shape.entry_yaw, shape.exit_yaw, t)));
+            }
+        }
+
+        end_position = tile.position + rotate_y(shape.exit, tile.yaw);
+        end_yaw = tile.yaw + shape.exit_yaw;
+        end_direction = chunk.centerline_direction.back();
+        end_distance += shape.length;
+
+        chunk.tiles.push_back(tile);
+    }
+
+    chunk.length = end_distance - chunk.start_distance;
+    chunks.push_back(std::move(chunk));
+}
+
+float Route::random_unit()
+{
+    // Not std::uniform_real_distribution, its output differs between standard libraries
+    return (random() >> 8) / 16777216.0f;
+}
+
+void Route::add_control_point()
+{
+    // A third of the steps carry straight on, the others turn, without ever straying
+    // too far from the starting heading
+    if (random_unit() >= 1.0f / 3.0f)
+    {
+        float turn = (random_unit() * 2.0f - 1.0f) * SPLINE_MAX_TURN;
+        control_yaw = glm::clamp(control_yaw + turn, -SPLINE_MAX_HEADING_OFFSET, SPLINE_MAX_HEADING_OFFSET);
+    }
+
+    float step = glm::mix(SPLINE_MIN_STEP, SPLINE_MAX_STEP, random_unit());
+    control_points.push_back(control_points.back() + yaw_direction(start_yaw + control_yaw) * step);
+}
+
+void Route::generate_spline_chunk(RouteChunk& chunk)
+{
+    for (uint32_t i = 0; i < pieces_per_chunk; i++)
+    {
+        uint32_t segment_index = next_segment++;
+
+        while (control_points.size() < segment_index + 4)
+        {
+            add_control_point();
+        }
+
+        SplineSegment segment(&control_points[segment_index]);
+
+        glm::vec3 start_position, start_derivative;
+        segment.evaluate(segment.knots[1], start_position, start_derivative);
+
+        size_t first = chunk.centerline.size();
+        tessellate(segment, segment.knots[1], segment.knots[2], start_position, start_derivative, chunk.centerline, chunk.centerline_direction, 0);
+
+        for (size_t p = first; p < chunk.centerline.size(); p++)
+        {
+            end_distance += glm::length(chunk.centerline[p] - chunk.centerline[p - 1]);
+            chunk.centerline_distance.push_back(end_distance);
+        }
+    }
+
+    end_position = chunk.centerline.back();
+    end_direction = chunk.centerline_direction.back();
+
+    chunk.length = end_distance - chunk.start_distance;
+    chunks.push_back(std::move(chunk));
+}
+
+RouteLocation Route::locate(const glm::vec3& position, uint32_t hint_chunk)
+{
+    glm::vec2 point(position.x, position.z);
+
+    float best_distance_sq = INFINITY;
+
+    RouteLocation location;
+    location.chunk = hint_chunk;
+
+    uint32_t first = hint_chunk > 0 ? hint_chunk - 1 : 0;
+
+    for (uint32_t c = first; c <= hint_chunk + 1; c++)
+    {
+        const RouteChunk& chunk = get_chunk(c);
+
+        for (size_t i = 0; i + 1 < chunk.centerline.size(); i++)
+        {
+            glm::vec2 a(chunk.centerline[i].x, chunk.centerline[i].z);
+            glm::vec2 b(chunk.centerline[i + 1].x, chunk.centerline[i + 1].z);
+
+            glm::vec2 segment = b - a;
+            float length_sq = glm::dot(segment, segment);
+            float t = length_sq > 0.0f ? glm::clamp(glm::dot(point - a, segment) / length_sq, 0.0f, 1.0f) : 0.0f;
+
+            glm::vec2 offset = point - (a + segment * t);
+            float distance_sq = glm::dot(offset, offset);
+
+            if (distance_sq < best_distance_sq)
+            {
+                best_distance_sq = distance_sq;
+
+                location.chunk = c;
+                location.distance = chunk.centerline_distance[i] + (chunk.centerline_distance[i + 1] - chunk.centerline_distance[i]) * t;
+                if (length_sq > 0.0f) location.direction = glm::normalize(glm::vec3(segment.x, 0.0f, segment.y));
+            }
+        }
+    }
+
+    return location;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include <vec3.hpp>
+
+enum TileType : uint32_t
+{
+    TILE_STRAIGHT,
+    TILE_CURVE_RIGHT,
+    TILE_CURVE_LEFT,
+};
+
+enum RouteStyle : uint32_t
+{
+    // Road tile models laid out one after another
+    ROUTE_TILES,
+
+    // A Catmull-Rom spline through random control points, its road mesh is extruded
+    // along the centre line (see road_mesh.hpp)
+    ROUTE_SPLINE,
+};
+
+struct RouteTile
+{
+    TileType type;
+
+    // The tile mesh is placed at rotate_y(yaw) * vertex + position
+    glm::vec3 position;
+    float yaw;
+
+    float start_distance;
+    float length;
+};
+
+struct RouteChunk
+{
+    uint32_t index;
+    uint32_t seed;
+
+    // Start of the chunk's road, used as the origin of the chunk's scene
+    glm::vec3 origin;
+
+    float start_distance;
+    float length;
+
+    // Empty for spline routes
+    std::vector<RouteTile> tiles;
+
+    // Road centre line, with the route distance and direction of travel of every point.
+    // Spline routes place more points where the road bends more.
+    std::vector<glm::vec3> centerline;
+    std::vector<float> centerline_distance;
+    std::vector<glm::vec3> centerline_direction;
+};
+
+struct RouteLocation
+{
+    uint32_t chunk = 0;
+    float distance = 0.0f;
+
+    // Direction of travel along the road at that point
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+};
+
+// Lays the road out from a seed, either as tiles or as a spline. Chunks are generated
+// on demand and always come out the same for the same seed. Either way the road never
+// turns more than 90 degrees away from the starting heading, so it can't turn back on
+// itself.
+class Route
+{
+public:
+    // `pieces_per_chunk` counts tiles, or spline segments between control points.
+    Route(const glm::vec3& origin, const glm::vec3& heading, uint32_t pieces_per_chunk, uint32_t seed, RouteStyle style = ROUTE_TILES);
+
+    const RouteChunk& get_chunk(uint32_t index);
+
+    // Centre line of the chunk joined with the ones of the chunks before and after it.
+    std::vector<glm::vec3> get_nearby_centerline(uint32_t index);
+
+    // Finds the centre line point closest to `position`, only looking at the chunks
+    // around `hint_chunk`.
+    RouteLocation locate(const glm::vec3& position, uint32_t hint_chunk);
+
+    static const char* get_tile_model(TileType type);
+
+private:
+    uint32_t pieces_per_chunk;
+    uint32_t seed;
+    RouteStyle style;
+
+    std::mt19937 random;
+
+    glm::vec3 end_position;
+    float end_yaw;
+    float end_distance = 0.0f;
+
+    // Quarter turns relative to the starting heading, kept within one either way so the
+    // road never turns back on itself
+    int32_t turns = 0;
+    uint32_t tiles_since_curve = 0;
+
+    // Spline routes only. Segment n runs from control point n + 1 to n + 2, the first
+    // point lies behind the origin so the road leaves it along the heading.
+    std::vector<glm::vec3> control_points;
+    float start_yaw;
+    float control_yaw;
+    uint32_t next_segment = 0;
+    glm::vec3 end_direction;
+
+    // Deque so references to chunks stay valid while more are generated
+    std::deque<RouteChunk> chunks;
+
+    void generate_chunk();
+    TileType pick_tile();
+
+    void generate_spline_chunk(RouteChunk& chunk);
+    void add_control_point();
+    float random_unit();
+};
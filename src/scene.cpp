@@ -2,17 +2,56 @@
 
 #include <stdexcept>
 
+#include <mat3x3.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include "node_arena.hpp"
+
+Scene::Scene()
+    : Spatial(SCENE_COMPONENTS)
+{
+}
+
+Scene::~Scene()
+{
+    if (parent_scene != nullptr) parent_scene->remove_scene(this);
+
+    // Children outlive a scene that doesn't own them, they just lose their parent
+    for (size_t i = 0; i < child_models.size(); i++)
+    {
+        child_models[i]->parent_scene = nullptr;
+        child_models[i]->set_parent(nullptr);
+    }
+
+    for (size_t i = 0; i < child_scenes.size(); i++)
+    {
+        child_scenes[i]->parent_scene = nullptr;
+        child_scenes[i]->set_parent(nullptr);
+        child_scenes[i]->refresh_child_depths();
+    }
+
+    for (size_t i = 0; i < baked_meshes.size(); i++)
+    {
+        baked_meshes[i].destroy_mesh();
+    }
+
+    if (instance_batch) instance_batch->destroy_batch();
+}
+
 void Scene::add_scene(Scene* child_scene)
 {
     if (child_scene->has_parent())
         throw std::runtime_error("Tried adding a scene that already has a parent to another scene.");
 
-    child_scene->set_parent(&transform);
-    transform.children.push_back(&child_scene->get_transform());
+    if (child_scene == this || is_descendant_of(child_scene))
+        throw std::runtime_error("Tried adding a scene to one of its own descendants.");
 
-    child_scenes.push_back(child_scene);
+    child_scene->set_parent(this);
+    child_scene->parent_scene = this;
+    child_scene->index_in_parent = child_scenes.size();
+    child_scene->refresh_child_depths();
 
-    child_scene->get_transform().regenerate_transformation_matrix();
+    child_scenes.push_back(child_scene);
 }
 
 void Scene::add_model(Model* child_model)
@@ -20,24 +59,294 @@ void Scene::add_model(Model* child_model)
     if (child_model->has_parent())
         throw std::runtime_error("Tried adding a model that already has a parent to a scene.");
 
-    child_model->set_parent(&transform);
-    transform.children.push_back(&child_model->get_transform());
+    child_model->set_parent(this);
+    child_model->parent_scene = this;
+    child_model->index_in_parent = child_models.size();
 
     child_models.push_back(child_model);
+}
+
+void Scene::remove_scene(Scene* child_scene)
+{
+    if (child_scene->parent_scene != this)
+        throw std::runtime_error("Tried removing a scene from a scene that isn't its parent.");
+
+    uint32_t index = child_scene->index_in_parent;
+
+    child_scenes[index] = child_scenes.back();
+    child_scenes[index]->index_in_parent = index;
+    child_scenes.pop_back();
+
+    child_scene->parent_scene = nullptr;
+    child_scene->index_in_parent = UINT32_MAX;
+    child_scene->set_parent(nullptr);
+    child_scene->refresh_child_depths();
+}
+
+void Scene::remove_model(Model* child_model)
+{
+    if (child_model->parent_scene != this)
+        throw std::runtime_error("Tried removing a model from a scene that isn't its parent.");
+
+    uint32_t index = child_model->index_in_parent;
+
+    child_models[index] = child_models.back();
+    child_models[index]->index_in_parent = index;
+    child_models.pop_back();
+
+    child_model->parent_scene = nullptr;
+    child_model->index_in_parent = UINT32_MAX;
+    child_model->set_parent(nullptr);
+}
+
+void Scene::reparent(Scene* scene)
+{
+    if (scene == this || is_descendant_of(scene))
+        throw std::runtime_error("Tried reparenting a scene below one of its own descendants.");
+
+    glm::dmat4 world_matrix = scene->get_transformation_matrix();
+
+    if (scene->parent_scene != nullptr) scene->parent_scene->remove_scene(scene);
+
+    // Local matrices are multiplied by the parent matrix on the right
+    scene->set_transform(Transform::from_matrix(world_matrix * glm::inverse(get_transformation_matrix())));
+    add_scene(scene);
+}
+
+void Scene::reparent(Model* model)
+{
+    glm::dmat4 world_matrix = model->get_transformation_matrix();
+
+    if (model->parent_scene != nullptr) model->parent_scene->remove_model(model);
+
+    model->set_transform(Transform::from_matrix(world_matrix * glm::inverse(get_transformation_matrix())));
+    add_model(model);
+}
+
+bool Scene::is_descendant_of(const Scene* scene) const
+{
+    for (const Scene* s = parent_scene; s != nullptr; s = s->parent_scene)
+    {
+        if (s == scene) return true;
+    }
+
+    return false;
+}
+
+static void append_mesh(std::map<uint32_t, Mesh>& batches, const Mesh& mesh, uint32_t texture, const glm::mat4& matrix, AABB& bounds)
+{
+    Mesh& batch = batches[texture];
+    uint32_t base = batch.vertices.size();
+
+    glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(matrix)));
+
+    for (const Vertex& vertex : mesh.vertices)
+    {
+        Vertex baked = vertex;
+        baked.position = glm::vec3(matrix * glm::vec4(vertex.position, 1.0f));
+
+        glm::vec3 normal = normal_matrix * vertex.normal;
+        if (glm::length(normal) > 0.0f) baked.normal = glm::normalize(normal);
+
+        batch.vertices.push_back(baked);
+        bounds.expand(baked.position);
+    }
+
+    for (uint32_t index : mesh.indices)
+    {
+        batch.indices.push_back(base + index);
+    }
+}
+
+static void append_node(const Spatial* node, const glm::dmat4& inverse_root, std::map<uint32_t, Mesh>& batches, Shader*& shader, AABB& bounds)
+{
+    const MeshRef* mesh_ref = get_registry().try_get<MeshRef>(node->get_entity());
+    if (mesh_ref == nullptr) return;
+
+    if (shader != nullptr && mesh_ref->shader != shader)
+        throw std::runtime_error("Tried baking a scene whose models use different shaders.");
+
+    shader = mesh_ref->shader;
+
+    // Baked vertices are drawn with the root's matrix, so they are moved by whatever the
+    // node's matrix does beyond it. Relative to the root the matrix is small again, so it
+    // can go back to floats.
+    glm::mat4 matrix = glm::mat4(inverse_root * node->get_transformation_matrix());
+
+    for (uint32_t i = 0; i < mesh_ref->mesh_count; i++)
+    {
+        const Mesh& mesh = mesh_ref->meshes[i];
+        append_mesh(batches, mesh, mesh_ref->texture != 0 ? mesh_ref->texture : mesh.texture, matrix, bounds);
+    }
+}
 
-    child_model->get_transform().regenerate_transformation_matrix();
+void Scene::gather_static_geometry(const glm::dmat4& inverse_root, std::map<uint32_t, Mesh>& batches, Shader*& shader, AABB& bounds) const
+{
+    for (size_t i = 0; i < child_models.size(); i++)
+    {
+        append_node(child_models[i], inverse_root, batches, shader, bounds);
+    }
+
+    for (size_t i = 0; i < child_scenes.size(); i++)
+    {
+        append_node(child_scenes[i], inverse_root, batches, shader, bounds);
+        child_scenes[i]->gather_static_geometry(inverse_root, batches, shader, bounds);
+    }
+}
+
+void Scene::release_children()
+{
+    // Destroyed and removed children both take themselves out of the lists
+    for (size_t i = child_models.size(); i-- > 0;)
+    {
+        Model* model = child_models[i];
+
+        if (model->arena != nullptr) model->arena->destroy(model->arena->get_handle(model));
+        else remove_model(model);
+    }
+
+    for (size_t i = child_scenes.size(); i-- > 0;)
+    {
+        Scene* scene = child_scenes[i];
+
+        if (scene->arena != nullptr) scene->arena->destroy(scene->arena->get_handle(scene));
+        else remove_scene(scene);
+    }
+}
+
+void Scene::bake_static()
+{
+    std::map<uint32_t, Mesh> batches;
+    Shader* shader = nullptr;
+    DrawClass draw_class = DRAW_PROPS;
+    AABB bounds = AABB::empty();
+
+    // An earlier bake is already in this scene's space and gets merged into the new one
+    if (is_baked())
+    {
+        const MeshRef& mesh_ref = get_registry().get<MeshRef>(entity);
+        shader = mesh_ref.shader;
+        draw_class = mesh_ref.draw_class;
+
+        for (size_t i = 0; i < baked_meshes.size(); i++)
+        {
+            append_mesh(batches, baked_meshes[i], baked_meshes[i].texture, glm::mat4(1.0f), bounds);
+        }
+    }
+
+    // Gather everything first, so a failure leaves the subtree untouched
+    gather_static_geometry(glm::inverse(get_transformation_matrix()), batches, shader, bounds);
+
+    release_children();
+
+    std::unique_ptr<TriangleBVH> bvh = std::make_unique<TriangleBVH>();
+    for (auto& batch : batches)
+    {
+        bvh->add_mesh(batch.second.vertices, batch.second.indices);
+    }
+    bvh->build();
+
+    std::vector<Mesh> meshes;
+    for (auto& batch : batches)
+    {
+        batch.second.texture = batch.first;
+        batch.second.initialize_mesh();
+
+        meshes.push_back(std::move(batch.second));
+    }
+
+    set_static_batch(std::move(meshes), bounds, shader, draw_class);
+    set_collision(std::move(bvh));
 }
 
-void Scene::draw_scene() const
+void Scene::set_static_batch(std::vector<Mesh> meshes, const AABB& bounds, Shader* shader, DrawClass draw_class)
 {
-    for (int i = 0; i < child_scenes.size(); i++)
+    Registry& registry = get_registry();
+
+    if (instance_batch) throw std::runtime_error("Tried giving a scene with instances a static batch.");
+
+    for (size_t i = 0; i < baked_meshes.size(); i++)
     {
-        child_scenes[i]->draw_scene();
+        baked_meshes[i].destroy_mesh();
     }
+    baked_meshes = std::move(meshes);
 
-    for (int i = 0; i < child_models.size(); i++)
+    if (baked_meshes.empty())
     {
-        child_models[i]->draw();
+        registry.remove<MeshRef>(entity);
+        registry.remove<Bounds>(entity);
+        return;
     }
+
+    registry.add<MeshRef>(entity, MeshRef { baked_meshes.data(), (uint32_t) baked_meshes.size(), shader, 0, draw_class });
+    registry.add<Bounds>(entity, Bounds { bounds, AABB() });
 }
 
+void Scene::set_collision(std::unique_ptr<TriangleBVH> bvh)
+{
+    Registry& registry = get_registry();
+
+    collision = std::move(bvh);
+
+    if (!collision)
+    {
+        registry.remove<Collider>(entity);
+        return;
+    }
+
+    registry.add<Collider>(entity, Collider { collision.get() });
+}
+
+void Scene::set_occluders(std::vector<AABB> boxes, float distance)
+{
+    Registry& registry = get_registry();
+
+    occluder_boxes = std::move(boxes);
+
+    if (occluder_boxes.empty())
+    {
+        registry.remove<Occluder>(entity);
+        return;
+    }
+
+    registry.add<Occluder>(entity, Occluder { &occluder_boxes, distance });
+}
+
+void Scene::set_instance_batch(std::unique_ptr<InstanceBatch> batch, const AABB& bounds, Shader* shader)
+{
+    Registry& registry = get_registry();
+
+    if (is_baked()) throw std::runtime_error("Tried giving a baked scene instances.");
+
+    if (instance_batch) instance_batch->destroy_batch();
+    instance_batch = std::move(batch);
+
+    if (!instance_batch)
+    {
+        registry.remove<Instances>(entity);
+        registry.remove<Bounds>(entity);
+        return;
+    }
+
+    registry.add<Instances>(entity, Instances { instance_batch.get(), shader });
+    registry.add<Bounds>(entity, Bounds { bounds, AABB() });
+}
+
+bool Scene::is_baked() const
+{
+    return !baked_meshes.empty();
+}
+
+void Scene::refresh_child_depths()
+{
+    for (size_t i = 0; i < child_models.size(); i++)
+    {
+        child_models[i]->set_parent(this);
+    }
+
+    for (size_t i = 0; i < child_scenes.size(); i++)
+    {
+        child_scenes[i]->set_parent(this);
+        child_scenes[i]->refresh_child_depths();
+    }
+}
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <map>
+#include <memory>
 #include <vector>
 
 #include <vec3.hpp>
+#include <mat4x4.hpp>
 
 #include "spatial.hpp"
 #include "model.hpp"
+#include "systems.hpp"
+#include "bvh.hpp"
+
+const ComponentMask SCENE_COMPONENTS = SPATIAL_COMPONENTS;
 
 class Scene : public Spatial
 {
@@ -13,8 +20,55 @@ public:
     std::vector<Model *> child_models;
     std::vector<Scene *> child_scenes;
 
+    Scene();
+    ~Scene();
+
     void add_scene(Scene* child_scene);
     void add_model(Model* child_model);
 
-    void draw_scene() const;
+    // O(1), every child knows its own index in the list it is stored in.
+    // The child keeps existing, it just no longer has a parent.
+    void remove_scene(Scene* child_scene);
+    void remove_model(Model* child_model);
+
+    // Moves a node from wherever it is to this scene, keeping its world transform.
+    void reparent(Scene* scene);
+    void reparent(Model* model);
+
+    bool is_descendant_of(const Scene* scene) const;
+
+    // Replaces everything below this scene with one static batch. All child meshes are
+    // transformed into this scene's space and merged into one mesh per texture, so the
+    // subtree costs a draw call per texture and is culled by a single bound. Children
+    // owned by an arena are destroyed, others are only removed.
+    void bake_static();
+    bool is_baked() const;
+
+    // Takes ownership of already uploaded meshes as this scene's static batch,
+    // replacing any previous one.
+    void set_static_batch(std::vector<Mesh> meshes, const AABB& bounds, Shader* shader, DrawClass draw_class = DRAW_PROPS);
+
+    // Takes ownership of an instance batch drawn in this scene's space. A scene holds
+    // either a static batch or instances, as both need their own bounds.
+    void set_instance_batch(std::unique_ptr<InstanceBatch> batch, const AABB& bounds, Shader* shader);
+
+    // Takes ownership of a collision BVH in this scene's space, nullptr removes it.
+    // bake_static() builds one from the batch.
+    void set_collision(std::unique_ptr<TriangleBVH> bvh);
+
+    // Solid boxes in this scene's space that hide what is behind them up to `distance`
+    // from the camera, see OcclusionCuller. With an instance batch they are placed at
+    // every instance. No boxes removes them.
+    void set_occluders(std::vector<AABB> boxes, float distance);
+
+private:
+    std::vector<Mesh> baked_meshes;
+    std::unique_ptr<InstanceBatch> instance_batch;
+    std::unique_ptr<TriangleBVH> collision;
+    std::vector<AABB> occluder_boxes;
+
+    void refresh_child_depths();
+
+    void gather_static_geometry(const glm::dmat4& inverse_root, std::map<uint32_t, Mesh>& batches, Shader*& shader, AABB& bounds) const;
+    void release_children();
 };
@@ -86,6 +86,59 @@ Shader::Shader(const char* vertex_path, const char* fragment_path)
     glDeleteShader(f_id);
 }
 
+Shader::Shader(const char* compute_path)
+{
+    std::string c_code;
+    std::ifstream c_file;
+
+    c_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    try
+    {
+        c_file.open(compute_path);
+        std::stringstream ss;
+
+        ss << c_file.rdbuf();
+        c_code = ss.str();
+
+        c_file.close();
+    }
+    catch (std::ifstream::failure e)
+    {
+        throw std::runtime_error("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ");
+    }
+
+    const char* c_code_c = c_code.c_str();
+
+    uint32_t c_id;
+    int success;
+    char info_log[512];
+
+    c_id = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(c_id, 1, &c_code_c, NULL);
+    glCompileShader(c_id);
+
+    glGetShaderiv(c_id, GL_COMPILE_STATUS, &success);
+    if(!success)
+    {
+        glGetShaderInfoLog(c_id, 512, NULL, info_log);
+        throw std::runtime_error("ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" + std::string(info_log));
+    };
+
+    this->id = glCreateProgram();
+    glAttachShader(this->id, c_id);
+    glLinkProgram(this->id);
+
+    glGetProgramiv(this->id, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        glGetProgramInfoLog(this->id, 512, NULL, info_log);
+        throw std::runtime_error("ERROR::SHADER::PROGRAM::LINKING_FAILED\n" + std::string(info_log));
+    }
+
+    glDeleteShader(c_id);
+}
+
 void Shader::use() const
 {
     glUseProgram(this->id);
@@ -99,6 +152,10 @@ void Shader::set_int(const std::string &name, int value) const
 { 
     glUniform1i(glGetUniformLocation(this->id, name.c_str()), value); 
 }
+void Shader::set_uint(const std::string &name, uint32_t value) const
+{
+    glUniform1ui(glGetUniformLocation(this->id, name.c_str()), value);
+}
 void Shader::set_float(const std::string &name, float value) const
 { 
     glUniform1f(glGetUniformLocation(this->id, name.c_str()), value); 
@@ -109,7 +166,23 @@ void Shader::set_vec2(const std::string &name, const glm::vec2 &value) const
     glUniform2f(glGetUniformLocation(this->id, name.c_str()), value.x, value.y);
 }
 
+void Shader::set_vec3(const std::string &name, const glm::vec3 &value) const
+{
+    glUniform3f(glGetUniformLocation(this->id, name.c_str()), value.x, value.y, value.z);
+}
+
+void Shader::set_vec4_array(const std::string &name, const glm::vec4* values, uint32_t count) const
+{
+    glUniform4fv(glGetUniformLocation(this->id, name.c_str()), count, glm::value_ptr(values[0]));
+}
+
 void Shader::set_mat4(const std::string &name, const glm::mat4 &value) const
 {
     glUniformMatrix4fv(glGetUniformLocation(this->id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
 }
+
+void Shader::set_uniform_block(const std::string &name, uint32_t binding) const
+{
+    uint32_t index = glGetUniformBlockIndex(this->id, name.c_str());
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding(this->id, index, binding);
+}
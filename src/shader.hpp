@@ -11,13 +11,27 @@ public:
     
     uint32_t id;
 
+    // Takes model_view from the per instance attributes of the mesh pool instead of the
+    // DrawData block, for drawing pooled meshes with glMultiDrawElementsIndirect. Meshes
+    // drawn with a shader without one are drawn one at a time.
+    Shader* indirect_variant = nullptr;
+
     Shader(const char* vertex_path, const char* fragment_path);
 
+    // A compute program, needs GL 4.3
+    explicit Shader(const char* compute_path);
+
     void use() const;
 
     void set_bool(const std::string &name, bool value) const;
     void set_int(const std::string &name, int value) const;
+    void set_uint(const std::string &name, uint32_t value) const;
     void set_float(const std::string &name, float value) const;
     void set_vec2(const std::string &name, const glm::vec2 &value) const;
+    void set_vec3(const std::string &name, const glm::vec3 &value) const;
+    void set_vec4_array(const std::string &name, const glm::vec4* values, uint32_t count) const;
     void set_mat4(const std::string &name, const glm::mat4 &value) const;
+
+    // Points the uniform block `name` at a binding point, if the shader has one.
+    void set_uniform_block(const std::string &name, uint32_t binding) const;
 };
@@ -1,45 +1,80 @@
 #include "spatial.hpp"
 
-Spatial::Spatial()
+Spatial::Spatial(ComponentMask components)
 {
-    transform.regenerate_transformation_matrix();
+    entity = get_registry().create(components | SPATIAL_COMPONENTS);
+}
+
+Spatial::~Spatial()
+{
+    get_registry().destroy(entity);
 }
 
 bool Spatial::has_parent() const
 {
-    return transform.parent != nullptr;
+    return !get_parent().is_null();
+}
+
+Transform& Spatial::edit_transform()
+{
+    Registry& registry = get_registry();
+
+    registry.get<WorldTransform>(entity).dirty = true;
+    return registry.get<Transform>(entity);
+}
+
+void Spatial::snap_interpolation()
+{
+    Registry& registry = get_registry();
+
+    if (registry.has<Interpolation>(entity))
+    {
+        registry.get<Interpolation>(entity).previous = registry.get<Transform>(entity);
+    }
 }
 
 /* #region getters and setters */
 
 void Spatial::set_transform(const Transform& transform)
 {
-    this->transform = transform;
-    this->transform.regenerate_transformation_matrix();
+    edit_transform() = transform;
+    snap_interpolation();
 }
 
-void Spatial::set_parent(const Transform* parent)
+void Spatial::set_parent(const Spatial* parent)
 {
-    transform.parent = parent;
-    transform.regenerate_transformation_matrix();
+    Registry& registry = get_registry();
+    Hierarchy& hierarchy = registry.get<Hierarchy>(entity);
+
+    if (parent == nullptr)
+    {
+        hierarchy = Hierarchy {};
+    }
+    else
+    {
+        hierarchy.parent = parent->get_entity();
+        hierarchy.depth = parent->get_depth() + 1;
+    }
+
+    registry.get<WorldTransform>(entity).dirty = true;
 }
 
 void Spatial::set_scale(const glm::vec3 &scale)
 {
-    transform.scale = scale;
-    transform.regenerate_transformation_matrix();
+    edit_transform().scale = scale;
+    snap_interpolation();
 }
 
 void Spatial::set_rotation(const glm::vec3 &rotation)
 {
-    transform.rotation = rotation;
-    transform.regenerate_transformation_matrix();
+    edit_transform().rotation = rotation;
+    snap_interpolation();
 }
 
-void Spatial::set_position(const glm::vec3 &position)
+void Spatial::set_position(const glm::dvec3 &position)
 {
-    transform.position = position;
-    transform.regenerate_transformation_matrix();
+    edit_transform().position = position;
+    snap_interpolation();
 }
 
 void Spatial::set_scale(float x, float y, float z)
@@ -52,40 +87,76 @@ void Spatial::set_rotation(float x, float y, float z)
     set_rotation(glm::vec3(x, y, z));
 }
 
-void Spatial::set_position(float x, float y, float z)
+void Spatial::set_position(double x, double y, double z)
 {
-    set_position(glm::vec3(x, y, z));
+    set_position(glm::dvec3(x, y, z));
 }
 
+void Spatial::set_velocity(const glm::vec3 &linear, const glm::vec3 &angular)
+{
+    Registry& registry = get_registry();
+
+    registry.add<Velocity>(entity, Velocity { linear, angular });
+    registry.add<Interpolation>(entity, Interpolation { registry.get<Transform>(entity) });
+}
 
-Transform& Spatial::get_transform()
+Scene* Spatial::get_parent_scene() const
 {
-    return transform;
+    return parent_scene;
 }
 
-const Transform* Spatial::get_parent() const
+NodeArena* Spatial::get_arena() const
 {
-    return transform.parent;
+    return arena;
 }
 
-const glm::vec3& Spatial::get_scale() const
+Entity Spatial::get_entity() const
 {
-    return transform.scale;
+    return entity;
 }
 
-const glm::vec3& Spatial::get_rotation() const
+Transform Spatial::get_transform() const
 {
-    return transform.rotation;
+    return get_registry().get<Transform>(entity);
 }
 
-const glm::vec3& Spatial::get_position() const
+Entity Spatial::get_parent() const
 {
-    return transform.position;
+    return get_registry().get<Hierarchy>(entity).parent;
 }
 
-const glm::mat4& Spatial::get_transformation_matrix() const
+uint32_t Spatial::get_depth() const
 {
-    return transform.transformation_matrix;
+    return get_registry().get<Hierarchy>(entity).depth;
+}
+
+glm::vec3 Spatial::get_scale() const
+{
+    return get_transform().scale;
+}
+
+glm::vec3 Spatial::get_rotation() const
+{
+    return get_transform().rotation;
+}
+
+glm::dvec3 Spatial::get_position() const
+{
+    return get_transform().position;
+}
+
+glm::dmat4 Spatial::get_transformation_matrix() const
+{
+    Registry& registry = get_registry();
+
+    glm::dmat4 matrix = get_transform().get_local_matrix();
+
+    for (Entity parent = get_parent(); !parent.is_null(); parent = registry.get<Hierarchy>(parent).parent)
+    {
+        matrix *= registry.get<Transform>(parent).get_local_matrix();
+    }
+
+    return matrix;
 }
 
 /* #endregion */
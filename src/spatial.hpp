@@ -3,34 +3,67 @@
 #include <vec3.hpp>
 #include <mat4x4.hpp>
 
-#include "transform.hpp"
+#include "ecs.hpp"
 
+class Scene;
+class NodeArena;
+
+const ComponentMask SPATIAL_COMPONENTS = COMPONENT_TRANSFORM | COMPONENT_WORLD_TRANSFORM | COMPONENT_HIERARCHY;
+
+// Thin handle over an entity in the global registry. The transform data itself lives
+// in the registry's component arrays, this class only forwards to it.
 class Spatial
 {
 protected:
-    Spatial();
+    Spatial(ComponentMask components);
+    ~Spatial();
 
 public:
+    Spatial(const Spatial&) = delete;
+    Spatial& operator = (const Spatial&) = delete;
 
     bool has_parent() const;
 
     void set_transform(const Transform& transform);
-    void set_parent(const Transform* parent);
+    void set_parent(const Spatial* parent);
     void set_scale(const glm::vec3 &scale);
     void set_rotation(const glm::vec3 &rotation);
-    void set_position(const glm::vec3 &position);
+    void set_position(const glm::dvec3 &position);
     void set_scale(float x, float y, float z);
     void set_rotation(float x, float y, float z);
-    void set_position(float x, float y, float z);
+    void set_position(double x, double y, double z);
+    // Moves the node every simulation tick, drawn interpolated between ticks. The
+    // setters above teleport it, without interpolating from where it was.
+    void set_velocity(const glm::vec3 &linear, const glm::vec3 &angular);
+
+    Scene* get_parent_scene() const;
+    NodeArena* get_arena() const;
+
+    Entity get_entity() const;
+    Entity get_parent() const;
+    uint32_t get_depth() const;
 
-    Transform& get_transform();
-    const Transform* get_parent() const;
-    const glm::vec3& get_scale() const;
-    const glm::vec3& get_rotation() const;
-    const glm::vec3& get_position() const;
+    // Copies, the registry moves its columns when archetypes grow.
+    Transform get_transform() const;
+    glm::vec3 get_scale() const;
+    glm::vec3 get_rotation() const;
+    glm::dvec3 get_position() const;
 
-    const glm::mat4& get_transformation_matrix() const;
+    // Always up to date, even before the transform system has run this frame.
+    glm::dmat4 get_transformation_matrix() const;
 
 protected:
-    Transform transform;  
+    friend class Scene;
+    friend class NodeArena;
+
+    Entity entity;
+
+    // Set by the owning scene and arena, both stay null for free-standing nodes.
+    Scene* parent_scene = nullptr;
+    NodeArena* arena = nullptr;
+    uint32_t arena_slot = UINT32_MAX;
+    uint32_t index_in_parent = UINT32_MAX;
+
+    Transform& edit_transform();
+    void snap_interpolation();
 };
@@ -0,0 +1,60 @@
+#include "stats_overlay.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+const double REFRESH_INTERVAL = 0.5;
+
+static std::vector<std::pair<std::string, std::string>> entries;
+
+static double elapsed = 0.0;
+static uint32_t frames = 0;
+
+void stats_overlay::set(const std::string name, const std::string value)
+{
+    for (auto& entry : entries)
+    {
+        if (entry.first == name)
+        {
+            entry.second = value;
+            return;
+        }
+    }
+
+    entries.push_back(std::make_pair(name, value));
+}
+
+void stats_overlay::update(GLFWwindow* window, const std::string title, double delta_time)
+{
+    elapsed += delta_time;
+    frames++;
+
+    if (elapsed < REFRESH_INTERVAL) return;
+
+    char timing[64];
+    std::snprintf(timing, sizeof(timing), "%.0f fps %.2f ms", frames / elapsed, elapsed * 1000.0 / frames);
+
+    std::string text = title + " | " + timing;
+
+    for (auto& entry : entries)
+    {
+        text += " | " + entry.first + " " + entry.second;
+    }
+
+    glfwSetWindowTitle(window, text.c_str());
+
+    elapsed = 0.0;
+    frames = 0;
+}
+
+std::string stats_overlay::format_bytes(size_t bytes)
+{
+    char text[32];
+
+    if (bytes >= 1024 * 1024) std::snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+    else std::snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+
+    return text;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <GLFW/glfw3.h>
+
+// Shows frame timings and named counters in the window title.
+namespace stats_overlay
+{
+    // Entries are shown in the order they were first set.
+    void set(const std::string name, const std::string value);
+
+    // Call once per frame, the title is only rewritten a few times per second.
+    void update(GLFWwindow* window, const std::string title, double delta_time);
+
+    std::string format_bytes(size_t bytes);
+}
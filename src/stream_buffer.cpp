@@ -0,0 +1,207 @@
+#include "stream_buffer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+#include <glad/gl.h>
+
+typedef std::chrono::steady_clock Clock;
+
+StreamBuffer::StreamBuffer(uint32_t target, size_t region_bytes, bool allow_persistent)
+{
+    this->target = target;
+    this->region_bytes = region_bytes;
+
+    // Core since 4.4, glad only loads it when the context has it
+    persistent = allow_persistent && glBufferStorage != nullptr;
+
+    stats.persistent = persistent;
+    stats.region_bytes = region_bytes;
+
+    create_storage();
+}
+
+void StreamBuffer::create_storage()
+{
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+
+    if (persistent)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, region_bytes * REGION_COUNT, nullptr, flags);
+        mapped = (unsigned char*) glMapBufferRange(target, 0, region_bytes * REGION_COUNT, flags);
+
+        if (mapped == nullptr) throw std::runtime_error("Failed to map a persistent stream buffer.");
+    }
+    else
+    {
+        glBufferData(target, region_bytes, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(target, 0);
+}
+
+void StreamBuffer::release_storage()
+{
+    if (buffer == 0) return;
+
+    for (void*& fence : fences)
+    {
+        if (fence != nullptr) glDeleteSync(static_cast<GLsync>(fence));
+        fence = nullptr;
+    }
+
+    if (mapped != nullptr)
+    {
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        glBindBuffer(target, 0);
+        mapped = nullptr;
+    }
+
+    // Draws already issued keep their storage alive until they are done
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void StreamBuffer::begin_frame(size_t max_bytes)
+{
+    if (in_frame) throw std::runtime_error("Tried beginning a stream buffer frame twice.");
+
+    if (max_bytes > region_bytes)
+    {
+        release_storage();
+
+        region_bytes = std::max(max_bytes, region_bytes * 2);
+        region = 0;
+        stats.region_bytes = region_bytes;
+        stats.grows++;
+
+        create_storage();
+    }
+
+    stats.wait_ms = 0.0;
+
+    if (persistent)
+    {
+        region = (region + 1) % REGION_COUNT;
+
+        // Only waits when the GPU is REGION_COUNT frames behind
+        if (fences[region] != nullptr)
+        {
+            Clock::time_point start = Clock::now();
+            GLsync fence = static_cast<GLsync>(fences[region]);
+
+            while (true)
+            {
+                GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+                if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) break;
+                if (status == GL_WAIT_FAILED) throw std::runtime_error("Failed waiting for a stream buffer region.");
+            }
+
+            glDeleteSync(fence);
+            fences[region] = nullptr;
+
+            stats.wait_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+
+        head = region * region_bytes;
+    }
+    else
+    {
+        // Orphaning, the driver keeps the old storage for the draws still reading it
+        glBindBuffer(target, buffer);
+        glBufferData(target, region_bytes, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(target, 0);
+
+        head = 0;
+    }
+
+    region_end = head + region_bytes;
+    stats.used_bytes = 0;
+    in_frame = true;
+}
+
+StreamAllocation StreamBuffer::allocate(size_t size, size_t alignment)
+{
+    if (!in_frame) throw std::runtime_error("Tried allocating from a stream buffer outside of a frame.");
+
+    size_t offset = (head + alignment - 1) / alignment * alignment;
+
+    if (offset + size > region_end)
+    {
+        throw std::runtime_error("Stream buffer region of " + std::to_string(region_bytes) + " bytes is full.");
+    }
+
+    // The fallback maps whatever is left of the buffer, unsynchronized, since nothing
+    // drew from it since it was orphaned
+    if (!persistent && mapped == nullptr)
+    {
+        glBindBuffer(target, buffer);
+        mapped = (unsigned char*) glMapBufferRange(target, offset, region_end - offset, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        glBindBuffer(target, 0);
+
+        if (mapped == nullptr) throw std::runtime_error("Failed to map a stream buffer.");
+        mapped_offset = offset;
+    }
+
+    head = offset + size;
+    stats.used_bytes = head - (region_end - region_bytes);
+
+    return StreamAllocation { mapped + (offset - mapped_offset), offset };
+}
+
+void StreamBuffer::flush()
+{
+    // Coherent persistent mappings are visible to the GPU as they are written
+    if (persistent || mapped == nullptr) return;
+
+    glBindBuffer(target, buffer);
+    glUnmapBuffer(target);
+    glBindBuffer(target, 0);
+
+    mapped = nullptr;
+}
+
+void StreamBuffer::end_frame()
+{
+    if (!in_frame) throw std::runtime_error("Tried ending a stream buffer frame that wasn't begun.");
+
+    flush();
+
+    if (persistent) fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    in_frame = false;
+}
+
+void StreamBuffer::destroy()
+{
+    release_storage();
+    in_frame = false;
+}
+
+uint32_t StreamBuffer::get_buffer() const
+{
+    return buffer;
+}
+
+bool StreamBuffer::is_persistent() const
+{
+    return persistent;
+}
+
+const StreamBufferStats& StreamBuffer::get_stats() const
+{
+    return stats;
+}
+
+size_t StreamBuffer::get_uniform_alignment()
+{
+    int alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    return (size_t) std::max(alignment, 1);
+}
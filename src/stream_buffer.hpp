@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct StreamAllocation
+{
+    // Write-only, valid until flush()
+    void* data;
+
+    // In the buffer, for binding ranges and attribute pointers
+    size_t offset;
+};
+
+struct StreamBufferStats
+{
+    bool persistent = false;
+    size_t region_bytes = 0;
+
+    // During the last frame
+    size_t used_bytes = 0;
+    double wait_ms = 0.0;
+
+    uint32_t grows = 0;
+};
+
+// Buffer for data that is rewritten every frame, like per draw uniforms or instance
+// attributes. The CPU writes straight into mapped buffer memory, so there is no copy
+// in the driver as with glBufferSubData.
+//
+// With ARB_buffer_storage the buffer is mapped once, persistently and coherently, and
+// split into REGION_COUNT regions used round robin. Each frame writes into its own
+// region and a fence after its draws tells when the GPU is done reading it, so the CPU
+// only waits if it gets REGION_COUNT frames ahead. Without it, every frame orphans the
+// buffer and maps it unsynchronized, which leaves keeping frames apart to the driver.
+class StreamBuffer
+{
+public:
+    static const uint32_t REGION_COUNT = 3;
+
+    // `target` is only used for mapping, the buffer can be bound anywhere afterwards.
+    // Needs the GL context.
+    StreamBuffer(uint32_t target, size_t region_bytes, bool allow_persistent = true);
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator = (const StreamBuffer&) = delete;
+
+    // Moves on to the next region, waiting until the GPU is done with it. The buffer
+    // grows first if `max_bytes`, allocations plus their alignment, don't fit a region.
+    void begin_frame(size_t max_bytes);
+
+    // Throws when the frame's region is full, begin_frame() has to be told enough.
+    StreamAllocation allocate(size_t size, size_t alignment);
+
+    // Call between writing and drawing from what was written. Allocating again
+    // afterwards is fine.
+    void flush();
+
+    // Call after the last draw that reads this frame's data.
+    void end_frame();
+
+    // Frees the buffer. Has to run while the GL context exists.
+    void destroy();
+
+    uint32_t get_buffer() const;
+    bool is_persistent() const;
+    const StreamBufferStats& get_stats() const;
+
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, for allocations bound as uniform blocks
+    static size_t get_uniform_alignment();
+
+private:
+    uint32_t target;
+    bool persistent;
+
+    uint32_t buffer = 0;
+    size_t region_bytes;
+
+    // Persistent mapping of all regions, or the current mapping of the fallback
+    unsigned char* mapped = nullptr;
+    size_t mapped_offset = 0;
+
+    uint32_t region = 0;
+    size_t head = 0;
+    size_t region_end = 0;
+    bool in_frame = false;
+
+    // GLsync of the last frame drawn from each region
+    void* fences[REGION_COUNT] = {};
+
+    StreamBufferStats stats;
+
+    void create_storage();
+    void release_storage();
+};
@@ -0,0 +1,379 @@
+#include "systems.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <glad/gl.h>
+#include <gtc/matrix_transform.hpp>
+
+#include "mesh_pool.hpp"
+#include "image_registry.hpp"
+#include "occlusion_culler.hpp"
+
+void systems::simulate(Registry& registry, float delta_time)
+{
+    registry.for_each_archetype(COMPONENT_TRANSFORM | COMPONENT_WORLD_TRANSFORM | COMPONENT_VELOCITY, [&](Archetype& archetype) {
+        bool has_interpolation = archetype.has(COMPONENT_INTERPOLATION);
+
+        for (size_t i = 0; i < archetype.size(); i++)
+        {
+            const Velocity& velocity = archetype.velocities[i];
+            Transform& transform = archetype.transforms[i];
+
+            if (has_interpolation) archetype.interpolations[i].previous = transform;
+
+            transform.position += glm::dvec3(velocity.linear * delta_time);
+            transform.rotation += velocity.angular * delta_time;
+
+            archetype.world_transforms[i].dirty = true;
+        }
+    });
+}
+
+void systems::interpolate(Registry& registry, float alpha)
+{
+    registry.for_each_archetype(COMPONENT_WORLD_TRANSFORM | COMPONENT_INTERPOLATION, [&](Archetype& archetype) {
+        for (size_t i = 0; i < archetype.size(); i++)
+        {
+            archetype.interpolations[i].alpha = alpha;
+            archetype.world_transforms[i].dirty = true;
+        }
+    });
+}
+
+// Local matrix the entity is drawn with, between ticks for interpolated entities
+static glm::dmat4 get_drawn_matrix(const Archetype& archetype, size_t i)
+{
+    if (!archetype.has(COMPONENT_INTERPOLATION)) return archetype.transforms[i].get_local_matrix();
+
+    const Interpolation& interpolation = archetype.interpolations[i];
+    return Transform::interpolate(interpolation.previous, archetype.transforms[i], interpolation.alpha).get_local_matrix();
+}
+
+void systems::update_transforms(Registry& registry)
+{
+    registry.advance_tick();
+    uint64_t tick = registry.get_tick();
+
+    uint32_t max_depth = 0;
+
+    // Roots
+    registry.for_each_archetype(COMPONENT_TRANSFORM | COMPONENT_WORLD_TRANSFORM, [&](Archetype& archetype) {
+        bool has_hierarchy = archetype.has(COMPONENT_HIERARCHY);
+
+        for (size_t i = 0; i < archetype.size(); i++)
+        {
+            if (has_hierarchy && archetype.hierarchies[i].depth > 0)
+            {
+                max_depth = std::max(max_depth, archetype.hierarchies[i].depth);
+                continue;
+            }
+
+            WorldTransform& world = archetype.world_transforms[i];
+            if (!world.dirty) continue;
+
+            world.matrix = get_drawn_matrix(archetype, i);
+            world.updated_tick = tick;
+            world.dirty = false;
+        }
+    });
+
+    // Every following depth only reads matrices that were finished in the pass before it
+    for (uint32_t depth = 1; depth <= max_depth; depth++)
+    {
+        registry.for_each_archetype(COMPONENT_TRANSFORM | COMPONENT_WORLD_TRANSFORM | COMPONENT_HIERARCHY, [&](Archetype& archetype) {
+            for (size_t i = 0; i < archetype.size(); i++)
+            {
+                const Hierarchy& hierarchy = archetype.hierarchies[i];
+                if (hierarchy.depth != depth) continue;
+
+                const WorldTransform& parent = registry.get<WorldTransform>(hierarchy.parent);
+                WorldTransform& world = archetype.world_transforms[i];
+
+                if (!world.dirty && parent.updated_tick != tick) continue;
+
+                world.matrix = get_drawn_matrix(archetype, i) * parent.matrix;
+                world.updated_tick = tick;
+                world.dirty = false;
+            }
+        });
+    }
+}
+
+const AABB& systems::get_world_bounds(Bounds& bounds, const WorldTransform& world)
+{
+    if (bounds.updated_tick != world.updated_tick)
+    {
+        bounds.world = bounds.local.transformed(glm::mat4(world.matrix));
+        bounds.updated_tick = world.updated_tick;
+    }
+
+    return bounds.world;
+}
+
+// Without a camera position nothing is culled by distance and instances aren't thinned
+static void gather_draws(Registry& registry, const glm::dmat4& view, const Frustum* frustum, const glm::vec3* camera_position, const DrawDistances* distances, OcclusionCuller* occlusion, DrawList& draw_list)
+{
+    registry.for_each_archetype(COMPONENT_WORLD_TRANSFORM | COMPONENT_MESH_REF, [&](Archetype& archetype) {
+        bool has_bounds = archetype.has(COMPONENT_BOUNDS);
+
+        for (size_t i = 0; i < archetype.size(); i++)
+        {
+            const WorldTransform& world = archetype.world_transforms[i];
+
+            if (has_bounds)
+            {
+                const AABB& bounds = systems::get_world_bounds(archetype.bounds[i], world);
+
+                if (frustum != nullptr && !frustum->intersects(bounds)) continue;
+
+                if (camera_position != nullptr && bounds.distance_to(*camera_position) > distances->get(archetype.mesh_refs[i].draw_class)) continue;
+
+                if (occlusion != nullptr && occlusion->is_occluded(bounds)) continue;
+            }
+
+            draw_list.push_back(DrawItem { archetype.mesh_refs[i], glm::mat4(view * world.matrix) });
+        }
+    });
+
+    registry.for_each_archetype(COMPONENT_WORLD_TRANSFORM | COMPONENT_INSTANCES | COMPONENT_BOUNDS, [&](Archetype& archetype) {
+        for (size_t i = 0; i < archetype.size(); i++)
+        {
+            const WorldTransform& world = archetype.world_transforms[i];
+            const Instances& instances = archetype.instances[i];
+
+            const AABB& bounds = systems::get_world_bounds(archetype.bounds[i], world);
+
+            if (frustum != nullptr && !frustum->intersects(bounds)) continue;
+
+            uint32_t count = instances.batch->get_instance_count();
+            uint32_t layers = INSTANCE_MESHES | INSTANCE_IMPOSTORS;
+
+            if (camera_position != nullptr)
+            {
+                float near_distance = bounds.distance_to(*camera_position);
+                float draw_distance = distances->get(instances.draw_class);
+
+                if (near_distance > draw_distance) continue;
+
+                count = instances.batch->get_visible_count(near_distance, draw_distance);
+                layers = instances.batch->get_layers(near_distance, bounds.farthest_distance_to(*camera_position));
+            }
+
+            if (count == 0 || layers == 0) continue;
+
+            if (occlusion != nullptr && occlusion->is_occluded(bounds)) continue;
+
+            draw_list.push_back(DrawItem { MeshRef { nullptr, 0, instances.shader }, glm::mat4(view * world.matrix), instances.batch, count, layers });
+        }
+    });
+}
+
+void systems::cull(Registry& registry, const glm::mat4& projection, const glm::dmat4& view, const DrawDistances& distances, DrawList& draw_list, OcclusionCuller* occlusion)
+{
+    Frustum frustum = Frustum::from_matrix(glm::mat4(glm::dmat4(projection) * view));
+    glm::vec3 camera_position = glm::vec3(glm::inverse(view)[3]);
+
+    gather_draws(registry, view, &frustum, &camera_position, &distances, occlusion, draw_list);
+}
+
+void systems::collect(Registry& registry, const glm::dmat4& view, DrawList& draw_list)
+{
+    gather_draws(registry, view, nullptr, nullptr, nullptr, nullptr, draw_list);
+}
+
+void systems::add_occluders(Registry& registry, const DrawDistances& distances, OcclusionCuller& culler)
+{
+    const glm::dvec3& camera = culler.get_camera_position();
+
+    registry.for_each_archetype(COMPONENT_WORLD_TRANSFORM | COMPONENT_OCCLUDER | COMPONENT_BOUNDS, [&](Archetype& archetype) {
+        bool has_instances = archetype.has(COMPONENT_INSTANCES);
+
+        for (size_t i = 0; i < archetype.size(); i++)
+        {
+            const WorldTransform& world = archetype.world_transforms[i];
+            const Occluder& occluder = archetype.occluders[i];
+
+            float near_distance = get_world_bounds(archetype.bounds[i], world).distance_to(glm::vec3(camera));
+            if (near_distance > occluder.distance) continue;
+
+            if (!has_instances)
+            {
+                for (const AABB& box : *occluder.boxes) culler.add_box(box, world.matrix);
+                continue;
+            }
+
+            // Instances that are thinned out aren't drawn and can't hide anything
+            const Instances& instances = archetype.instances[i];
+            uint32_t count = instances.batch->get_visible_count(near_distance, distances.get(instances.draw_class));
+
+            for (uint32_t j = 0; j < count; j++)
+            {
+                const Instance& instance = instances.batch->get_instances()[j];
+
+                glm::dmat4 placed = glm::translate(world.matrix, glm::dvec3(instance.position));
+                if (glm::length(glm::dvec3(placed[3]) - camera) > occluder.distance) continue;
+
+                placed = glm::rotate(placed, (double) instance.yaw, glm::dvec3(0.0, 1.0, 0.0));
+                placed = glm::scale(placed, glm::dvec3(instance.scale));
+
+                for (const AABB& box : *occluder.boxes) culler.add_box(box, placed);
+            }
+        }
+    });
+}
+
+// A mesh drawn through glMultiDrawElementsIndirect, grouped with the others of its bucket
+struct IndirectDraw
+{
+    const Shader* shader;
+    uint32_t texture;
+    DrawElementsIndirectCommand command;
+};
+
+static SubmitStats submit_stats;
+
+static bool is_indirect(const DrawItem& item)
+{
+    if (!mesh_pool::is_enabled() || item.instances != nullptr || item.mesh_ref.shader->indirect_variant == nullptr) return false;
+
+    for (uint32_t i = 0; i < item.mesh_ref.mesh_count; i++)
+    {
+        if (!item.mesh_ref.meshes[i].is_pooled()) return false;
+    }
+
+    return true;
+}
+
+void systems::submit(const DrawList& draw_list, StreamBuffer& draw_data)
+{
+    // Each DrawData starts at a uniform buffer offset the block can be bound at
+    static const size_t stride = std::max(StreamBuffer::get_uniform_alignment(), sizeof(DrawData));
+    static std::vector<size_t> offsets;
+    static std::vector<bool> indirect;
+    static std::vector<IndirectDraw> indirect_draws;
+
+    submit_stats = SubmitStats();
+
+    offsets.resize(draw_list.size());
+    indirect.resize(draw_list.size());
+    indirect_draws.clear();
+
+    // Every indirect item has one model_view, which base_instance picks for all its meshes
+    uint32_t indirect_items = 0;
+
+    for (size_t i = 0; i < draw_list.size(); i++)
+    {
+        const DrawItem& item = draw_list[i];
+        indirect[i] = is_indirect(item);
+
+        if (!indirect[i]) continue;
+
+        for (uint32_t j = 0; j < item.mesh_ref.mesh_count; j++)
+        {
+            const Mesh& mesh = item.mesh_ref.meshes[j];
+            const PoolRange& range = mesh.get_pool_range();
+
+            DrawElementsIndirectCommand command { range.index_count, 1, range.first_index, (int32_t) range.first_vertex, indirect_items };
+            indirect_draws.push_back(IndirectDraw { item.mesh_ref.shader->indirect_variant, item.mesh_ref.texture != 0 ? item.mesh_ref.texture : mesh.texture, command });
+        }
+
+        indirect_items++;
+    }
+
+    // One bucket per shader and texture, stable keeps the list's order within them
+    std::stable_sort(indirect_draws.begin(), indirect_draws.end(), [](const IndirectDraw& a, const IndirectDraw& b) {
+        return a.shader != b.shader ? a.shader < b.shader : a.texture < b.texture;
+    });
+
+    size_t matrix_bytes = indirect_items * sizeof(glm::mat4);
+    size_t command_bytes = indirect_draws.size() * sizeof(DrawElementsIndirectCommand);
+    draw_data.begin_frame((draw_list.size() - indirect_items + 1) * stride + matrix_bytes + command_bytes + 2 * stride);
+
+    // Everything is written before the first draw, the fallback unmaps to draw
+    StreamAllocation matrices = draw_data.allocate(matrix_bytes, sizeof(glm::vec4));
+    StreamAllocation commands = draw_data.allocate(command_bytes, sizeof(uint32_t));
+
+    for (size_t i = 0, matrix = 0; i < draw_list.size(); i++)
+    {
+        if (draw_list[i].instances != nullptr) continue;
+
+        if (indirect[i])
+        {
+            std::memcpy((glm::mat4*) matrices.data + matrix++, &draw_list[i].model_view, sizeof(glm::mat4));
+            continue;
+        }
+
+        StreamAllocation allocation = draw_data.allocate(sizeof(DrawData), stride);
+        std::memcpy(allocation.data, &draw_list[i].model_view, sizeof(glm::mat4));
+        offsets[i] = allocation.offset;
+    }
+
+    for (size_t i = 0; i < indirect_draws.size(); i++)
+    {
+        std::memcpy((DrawElementsIndirectCommand*) commands.data + i, &indirect_draws[i].command, sizeof(DrawElementsIndirectCommand));
+    }
+
+    draw_data.flush();
+
+    for (size_t i = 0; i < draw_list.size(); i++)
+    {
+        const DrawItem& item = draw_list[i];
+        Shader* shader = item.mesh_ref.shader;
+
+        if (indirect[i]) continue;
+
+        if (item.instances != nullptr)
+        {
+            item.instances->draw(shader, item.model_view, item.instance_count, item.instance_layers);
+            submit_stats.single_draws++;
+            continue;
+        }
+
+        glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, draw_data.get_buffer(), offsets[i], sizeof(DrawData));
+        shader->use();
+
+        for (uint32_t mesh = 0; mesh < item.mesh_ref.mesh_count; mesh++)
+        {
+            item.mesh_ref.meshes[mesh].draw(shader, item.mesh_ref.texture);
+        }
+
+        submit_stats.single_draws += item.mesh_ref.mesh_count;
+    }
+
+    if (!indirect_draws.empty())
+    {
+        mesh_pool::bind(draw_data.get_buffer(), matrices.offset);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draw_data.get_buffer());
+        glActiveTexture(GL_TEXTURE0);
+
+        for (size_t first = 0; first < indirect_draws.size();)
+        {
+            const IndirectDraw& draw = indirect_draws[first];
+
+            size_t last = first + 1;
+            while (last < indirect_draws.size() && indirect_draws[last].shader == draw.shader && indirect_draws[last].texture == draw.texture) last++;
+
+            draw.shader->use();
+            draw.shader->set_int("our_texture", 0);
+            image_registry::bind_texture(draw.texture);
+
+            void* offset = (void*) (commands.offset + first * sizeof(DrawElementsIndirectCommand));
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, offset, (GLsizei) (last - first), 0);
+
+            submit_stats.multi_draws++;
+            submit_stats.indirect_meshes += last - first;
+            first = last;
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    draw_data.end_frame();
+}
+
+const SubmitStats& systems::get_submit_stats()
+{
+    return submit_stats;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+
+#include <vec3.hpp>
+#include <mat4x4.hpp>
+
+#include "ecs.hpp"
+#include "draw_distance.hpp"
+#include "stream_buffer.hpp"
+
+class OcclusionCuller;
+
+struct DrawItem
+{
+    MeshRef mesh_ref;
+
+    // Model matrix followed by the view, made on the CPU from the double precision world
+    // matrix and view. Relative to the camera it is small enough for floats anywhere.
+    glm::mat4 model_view;
+
+    // Set for instanced draws, which only use the shader of mesh_ref
+    const InstanceBatch* instances = nullptr;
+    uint32_t instance_count = 0;
+    uint32_t instance_layers = INSTANCE_MESHES;
+};
+
+typedef std::vector<DrawItem> DrawList;
+
+// The DrawData uniform block of the mesh shaders, std140
+struct DrawData
+{
+    glm::mat4 model_view;
+};
+
+const uint32_t DRAW_DATA_BINDING = 0;
+
+// Of the last systems::submit()
+struct SubmitStats
+{
+    // glMultiDrawElementsIndirect calls and the meshes they drew
+    uint32_t multi_draws = 0;
+    uint32_t indirect_meshes = 0;
+
+    // Draw calls of single meshes and instance batches
+    uint32_t single_draws = 0;
+};
+
+namespace systems
+{
+    // Integrates Velocity into Transform over one simulation tick. Entities with
+    // Interpolation keep their transform from before the tick.
+    void simulate(Registry& registry, float delta_time);
+
+    // Places every entity with Interpolation `alpha` of the way from its previous to its
+    // current transform, for drawing a frame that falls between two ticks.
+    void interpolate(Registry& registry, float alpha);
+
+    // Rebuilds the world matrix of every dirty entity, parents before children.
+    void update_transforms(Registry& registry);
+
+    // Appends every entity with a mesh or instances whose world bounds touch the frustum
+    // and are within the draw distance of their class, and with `occlusion` aren't
+    // hidden behind its occluders. Instance batches are thinned out and switched to
+    // impostors by their distance to the camera.
+    void cull(Registry& registry, const glm::mat4& projection, const glm::dmat4& view, const DrawDistances& distances, DrawList& draw_list, OcclusionCuller* occlusion = nullptr);
+
+    // Adds the Occluder boxes of every entity within their distance of the culler's
+    // camera. Instanced ones are placed at each instance that is drawn.
+    void add_occluders(Registry& registry, const DrawDistances& distances, OcclusionCuller& culler);
+
+    // Appends every entity with a mesh or instances, without testing visibility.
+    void collect(Registry& registry, const glm::dmat4& view, DrawList& draw_list);
+
+    // Draws the list, with the DrawData of every mesh draw written into `draw_data` first
+    // and bound at DRAW_DATA_BINDING. Instanced draws still set their own uniforms.
+    //
+    // Pooled meshes whose shader has an indirect variant are grouped by shader and
+    // texture instead, and every group is one glMultiDrawElementsIndirect. Their
+    // commands and model_view go into `draw_data` as well.
+    void submit(const DrawList& draw_list, StreamBuffer& draw_data);
+
+    const SubmitStats& get_submit_stats();
+
+    // World bounds of an entity, recomputed if its world matrix changed since.
+    const AABB& get_world_bounds(Bounds& bounds, const WorldTransform& world);
+}
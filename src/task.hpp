@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "jobs.hpp"
+
+template<typename T>
+class Task;
+
+// Shared by the promises of every Task. Finishing resumes whoever awaited the task,
+// on the thread the task finished on.
+struct TaskPromiseBase
+{
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+template<typename T>
+struct TaskPromise : TaskPromiseBase
+{
+    // T doesn't have to be default constructible
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    void return_value(T result) { value = std::move(result); }
+
+    T result()
+    {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template<>
+struct TaskPromise<void> : TaskPromiseBase
+{
+    Task<void> get_return_object();
+    void return_void() {}
+
+    void result()
+    {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+// Coroutine that only starts once it is awaited, then runs until its first co_await of
+// something that isn't ready. Awaiting it gives the co_returned value, or rethrows what
+// the coroutine threw.
+//
+// Tasks don't pick a thread on their own, they move between threads by awaiting
+// resume_on(), so one coroutine can read a file on a job worker and upload it on the
+// GL thread.
+template<typename T>
+class Task
+{
+public:
+    typedef TaskPromise<T> promise_type;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task& operator = (Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator = (const Task&) = delete;
+
+    ~Task()
+    {
+        if (handle) handle.destroy();
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() { return handle.promise().result(); }
+        };
+
+        return Awaiter { handle };
+    }
+
+    // Like co_await, but leaves the result or error in the task for get_result()
+    auto when_ready() noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        return Awaiter { handle };
+    }
+
+    // Only after the task finished
+    T get_result() { return handle.promise().result(); }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// Coroutine that starts right away and frees itself once it finishes, for the outermost
+// coroutine of a chain that nobody awaits. Must not throw.
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Awaiting it continues the coroutine as a job, on a worker for JOB_ANY_THREAD and
+// JOB_BACKGROUND or in jobs::run_gl_jobs() for JOB_GL_THREAD.
+inline auto resume_on(JobAffinity affinity)
+{
+    struct Awaiter
+    {
+        JobAffinity affinity;
+
+        bool await_ready() noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            jobs::run([handle]() { handle.resume(); }, nullptr, affinity);
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    return Awaiter { affinity };
+}
+
+namespace task_detail
+{
+    struct WhenAllState
+    {
+        // One more than the tasks, the awaiting coroutine holds the last one until it
+        // has started all of them
+        std::atomic<size_t> remaining;
+        std::coroutine_handle<> continuation;
+    };
+
+    template<typename T>
+    DetachedTask run_counted(Task<T>& task, WhenAllState& state)
+    {
+        co_await task.when_ready();
+
+        if (state.remaining.fetch_sub(1) == 1) state.continuation.resume();
+    }
+}
+
+// Runs every task at once and gives their results in order, once all of them finished.
+// Rethrows the error of the first task that failed, in order, after all of them finished.
+template<typename T>
+Task<std::vector<T>> when_all(std::vector<Task<T>> tasks)
+{
+    struct Awaiter
+    {
+        std::vector<Task<T>>& tasks;
+        task_detail::WhenAllState state;
+
+        bool await_ready() noexcept { return tasks.empty(); }
+
+        bool await_suspend(std::coroutine_handle<> awaiting)
+        {
+            state.remaining = tasks.size() + 1;
+            state.continuation = awaiting;
+
+            for (Task<T>& task : tasks) task_detail::run_counted(task, state);
+
+            // Carry on right here if they all finished already
+            return state.remaining.fetch_sub(1) != 1;
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    co_await Awaiter { tasks, {} };
+
+    std::vector<T> results;
+    results.reserve(tasks.size());
+
+    for (Task<T>& task : tasks) results.push_back(task.get_result());
+
+    co_return results;
+}
@@ -0,0 +1,659 @@
+#include "terrain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include <glad/gl.h>
+#include <common.hpp>
+#include <geometric.hpp>
+#include <matrix.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include "image_registry.hpp"
+#include "occlusion_culler.hpp"
+
+const uint32_t HILL_OCTAVES = 4;
+
+static float hash_lattice(int32_t x, int32_t z, uint32_t seed)
+{
+    uint32_t h = seed ^ ((uint32_t) x * 0x8DA6B343u) ^ ((uint32_t) z * 0xD8163841u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return (h & 0xFFFFFF) / (float) 0x1000000;
+}
+
+static float value_noise(const glm::vec2& position, uint32_t seed)
+{
+    glm::vec2 cell = glm::floor(position);
+    glm::vec2 t = position - cell;
+    t = t * t * (3.0f - 2.0f * t);
+
+    int32_t x = (int32_t) cell.x, z = (int32_t) cell.y;
+
+    float a = hash_lattice(x, z, seed), b = hash_lattice(x + 1, z, seed);
+    float c = hash_lattice(x, z + 1, seed), d = hash_lattice(x + 1, z + 1, seed);
+
+    return glm::mix(glm::mix(a, b, t.x), glm::mix(c, d, t.x), t.y);
+}
+
+static float segment_distance(const glm::vec2& point, const glm::vec2& a, const glm::vec2& b)
+{
+    glm::vec2 segment = b - a;
+    float length_sq = glm::dot(segment, segment);
+    float t = length_sq > 0.0f ? glm::clamp(glm::dot(point - a, segment) / length_sq, 0.0f, 1.0f) : 0.0f;
+
+    return glm::length(point - (a + segment * t));
+}
+
+Terrain::Terrain(Scene* world, Shader* shader, Route& route, const TerrainConfig& config)
+    : world(world), shader(shader), route(route), config(config)
+{
+    if (config.lod_levels == 0 || config.grid_size % 4 != 0 || config.height_resolution < 2)
+    {
+        throw std::runtime_error("Invalid terrain config, it needs a LOD level, a grid size divisible by 4 and two heights per side.");
+    }
+
+    if (config.occluder_resolution < 2 || (config.height_resolution - 1) % (config.occluder_resolution - 1) != 0)
+    {
+        throw std::runtime_error("Invalid terrain config, the occluder grid has to line up with the heights.");
+    }
+
+    // The first tiles of the route are always straight
+    const RouteChunk& first = route.get_chunk(0);
+    clearing = glm::vec2(first.origin.x, first.origin.z);
+    heading = glm::normalize(glm::vec2(first.centerline[1].x, first.centerline[1].z) - clearing);
+
+    float leaf_size = config.tile_size / (float) (1 << (config.lod_levels - 1));
+    for (uint32_t level = 0; level < config.lod_levels; level++)
+    {
+        lod_ranges.push_back(leaf_size * (float) (1 << level) * config.lod_range_factor);
+    }
+
+    draw_distance = lod_ranges.back();
+
+    create_grid();
+
+    // Two counter clockwise triangles per cell seen from above
+    uint32_t side = config.occluder_resolution;
+    for (uint32_t z = 0; z + 1 < side; z++)
+    {
+        for (uint32_t x = 0; x + 1 < side; x++)
+        {
+            uint32_t corner = z * side + x;
+            occluder_indices.insert(occluder_indices.end(), { corner, corner + side, corner + 1, corner + 1, corner + side, corner + side + 1 });
+        }
+    }
+
+    ground_texture = image_registry::get_or_load_texture(config.texture);
+}
+
+Terrain::~Terrain()
+{
+    shutdown();
+}
+
+void Terrain::create_grid()
+{
+    uint32_t side = config.grid_size + 1;
+
+    std::vector<glm::vec2> vertices;
+    for (uint32_t z = 0; z < side; z++)
+    {
+        for (uint32_t x = 0; x < side; x++)
+        {
+            vertices.push_back(glm::vec2(x, z) / (float) config.grid_size);
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    for (uint32_t z = 0; z < config.grid_size; z++)
+    {
+        for (uint32_t x = 0; x < config.grid_size; x++)
+        {
+            uint32_t i = z * side + x;
+            indices.insert(indices.end(), { i, i + side, i + 1, i + 1, i + side, i + side + 1 });
+        }
+    }
+
+    index_count = indices.size();
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &grid_VBO);
+    glGenBuffers(1, &grid_EBO);
+
+    // Sized for a few hundred nodes, grows when more are selected
+    instance_stream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, 512 * sizeof(NodeInstance));
+
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, grid_VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid_EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*) 0);
+
+    // The instance attributes are pointed at each tile's nodes when drawing
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+
+    glBindVertexArray(0);
+}
+
+/* #region builds */
+
+void Terrain::build_requests()
+{
+    while (true)
+    {
+        TileRequest request;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (stopping || requests.empty())
+            {
+                running_builds--;
+                return;
+            }
+
+            request = std::move(requests.front());
+            requests.pop_front();
+        }
+
+        try
+        {
+            TileBuild build = build_tile(request, config, clearing);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(std::move(build));
+        }
+        catch (const std::exception& e)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            worker_error = e.what();
+        }
+    }
+}
+
+// Call with the mutex held
+void Terrain::start_builds()
+{
+    while (running_builds < std::max(config.parallel_builds, 1u) && running_builds < requests.size())
+    {
+        running_builds++;
+        jobs::run([this]() { build_requests(); }, &builds, JOB_BACKGROUND);
+    }
+}
+
+float Terrain::get_height(const glm::vec2& position, const TerrainConfig& config, const std::vector<std::vector<glm::vec2>>& roads, const glm::vec2& clearing)
+{
+    // Only distances up to the end of the rise matter
+    float road_distance = std::min(glm::length(position - clearing) - config.clearing_radius, config.flat_width + config.rise_width);
+
+    for (const std::vector<glm::vec2>& road : roads)
+    {
+        for (size_t i = 0; i + 1 < road.size(); i++)
+        {
+            road_distance = std::min(road_distance, segment_distance(position, road[i], road[i + 1]));
+        }
+    }
+
+    float hills = 0.0f, amplitude = 0.5f, frequency = 1.0f / config.hill_scale;
+    for (uint32_t octave = 0; octave < HILL_OCTAVES; octave++)
+    {
+        hills += value_noise(position * frequency, config.seed + octave) * amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+
+    // Squaring keeps most of the land low with the odd steep hill
+    hills = hills * hills * config.hill_height;
+
+    float t = glm::clamp((road_distance - config.flat_width) / config.rise_width, 0.0f, 1.0f);
+    float rise = t * t * (3.0f - 2.0f * t);
+
+    return glm::mix(config.flat_height, std::max(hills, config.flat_height), rise);
+}
+
+Terrain::TileBuild Terrain::build_tile(const TileRequest& request, const TerrainConfig& config, const glm::vec2& clearing)
+{
+    TileBuild build;
+    build.key = request.key;
+    build.min_height = INFINITY;
+    build.max_height = -INFINITY;
+
+    glm::vec2 origin = glm::vec2(request.key.first, request.key.second) * config.tile_size;
+    float spacing = config.tile_size / (config.height_resolution - 1);
+
+    build.heights.resize(config.height_resolution * config.height_resolution);
+
+    for (uint32_t z = 0; z < config.height_resolution; z++)
+    {
+        for (uint32_t x = 0; x < config.height_resolution; x++)
+        {
+            float height = get_height(origin + glm::vec2(x, z) * spacing, config, request.roads, clearing);
+
+            build.heights[z * config.height_resolution + x] = height;
+            build.min_height = std::min(build.min_height, height);
+            build.max_height = std::max(build.max_height, height);
+        }
+    }
+
+    // Lowest height of the cells around each occluder vertex. Triangles between them
+    // stay below every height of their cell, whatever the shape in between.
+    uint32_t side = config.occluder_resolution;
+    uint32_t step = (config.height_resolution - 1) / (side - 1);
+
+    build.occluder_heights.resize(side * side);
+
+    for (uint32_t z = 0; z < side; z++)
+    {
+        for (uint32_t x = 0; x < side; x++)
+        {
+            uint32_t first_x = x > 0 ? (x - 1) * step : 0, last_x = std::min((x + 1) * step, config.height_resolution - 1);
+            uint32_t first_z = z > 0 ? (z - 1) * step : 0, last_z = std::min((z + 1) * step, config.height_resolution - 1);
+
+            float lowest = INFINITY;
+            for (uint32_t height_z = first_z; height_z <= last_z; height_z++)
+            {
+                for (uint32_t height_x = first_x; height_x <= last_x; height_x++)
+                {
+                    lowest = std::min(lowest, build.heights[height_z * config.height_resolution + height_x]);
+                }
+            }
+
+            build.occluder_heights[z * side + x] = lowest;
+        }
+    }
+
+    return build;
+}
+
+/* #endregion */
+
+std::vector<std::vector<glm::vec2>> Terrain::gather_roads(const TileKey& key)
+{
+    float reach = config.flat_width + config.rise_width;
+
+    glm::vec2 min = glm::vec2(key.first, key.second) * config.tile_size - reach;
+    glm::vec2 max = glm::vec2(key.first + 1, key.second + 1) * config.tile_size + reach;
+
+    // How far along the start heading the route has to be generated to be past the tile
+    float last_progress = -INFINITY;
+    for (const glm::vec2& corner : { min, max, glm::vec2(min.x, max.y), glm::vec2(max.x, min.y) })
+    {
+        last_progress = std::max(last_progress, glm::dot(corner - clearing, heading));
+    }
+
+    std::vector<std::vector<glm::vec2>> roads;
+
+    for (uint32_t index = 0; ; index++)
+    {
+        const RouteChunk& chunk = route.get_chunk(index);
+        if (glm::dot(glm::vec2(chunk.origin.x, chunk.origin.z) - clearing, heading) > last_progress) break;
+
+        std::vector<glm::vec2> road;
+        glm::vec2 road_min(INFINITY), road_max(-INFINITY);
+
+        for (const glm::vec3& point : chunk.centerline)
+        {
+            road.push_back(glm::vec2(point.x, point.z));
+            road_min = glm::min(road_min, road.back());
+            road_max = glm::max(road_max, road.back());
+        }
+
+        if (road_max.x < min.x || road_min.x > max.x || road_max.y < min.y || road_min.y > max.y) continue;
+
+        roads.push_back(std::move(road));
+    }
+
+    return roads;
+}
+
+void Terrain::update(const glm::dvec3& player_position)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!worker_error.empty()) throw std::runtime_error("Terrain worker failed: " + worker_error);
+    }
+
+    world_matrix = world->get_transformation_matrix();
+    glm::vec3 position = glm::vec3(glm::inverse(world_matrix) * glm::dvec4(player_position, 1.0));
+    glm::vec2 player(position.x, position.z);
+
+    float view_range = std::min(lod_ranges.back(), draw_distance);
+    float keep_range = view_range + config.tile_size * 0.5f;
+
+    auto tile_distance = [&](const TileKey& key) {
+        glm::vec2 min = glm::vec2(key.first, key.second) * config.tile_size;
+        return glm::length(player - glm::clamp(player, min, min + config.tile_size));
+    };
+
+    for (auto it = tiles.begin(); it != tiles.end();)
+    {
+        if (tile_distance(it->first) <= keep_range)
+        {
+            it++;
+            continue;
+        }
+
+        release_tile(it->second);
+        it = tiles.erase(it);
+    }
+
+    // Tiles that finished after they went out of range are dropped here
+    std::deque<TileBuild> builds;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        builds.swap(finished);
+
+        for (auto it = requests.begin(); it != requests.end();)
+        {
+            if (tile_distance(it->key) <= keep_range)
+            {
+                it++;
+                continue;
+            }
+
+            pending.erase(it->key);
+            it = requests.erase(it);
+        }
+    }
+
+    for (TileBuild& build : builds)
+    {
+        pending.erase(build.key);
+        if (tile_distance(build.key) <= keep_range) upload_tile(build);
+    }
+
+    std::vector<TileRequest> new_requests;
+
+    int32_t first_x = (int32_t) std::floor((player.x - view_range) / config.tile_size);
+    int32_t last_x = (int32_t) std::floor((player.x + view_range) / config.tile_size);
+    int32_t first_z = (int32_t) std::floor((player.y - view_range) / config.tile_size);
+    int32_t last_z = (int32_t) std::floor((player.y + view_range) / config.tile_size);
+
+    for (int32_t z = first_z; z <= last_z; z++)
+    {
+        for (int32_t x = first_x; x <= last_x; x++)
+        {
+            TileKey key(x, z);
+            float distance = tile_distance(key);
+
+            if (distance > view_range || tiles.count(key) || pending.count(key)) continue;
+
+            new_requests.push_back(TileRequest { key, distance, gather_roads(key) });
+            pending.insert(key);
+        }
+    }
+
+    if (!new_requests.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (TileRequest& request : new_requests) requests.push_back(std::move(request));
+
+            for (TileRequest& request : requests) request.distance = tile_distance(request.key);
+            std::sort(requests.begin(), requests.end(), [](const TileRequest& a, const TileRequest& b) {
+                return a.distance < b.distance;
+            });
+
+            start_builds();
+        }
+    }
+
+    stats.resident_tiles = tiles.size();
+    stats.pending_tiles = pending.size();
+}
+
+void Terrain::upload_tile(TileBuild& build)
+{
+    Tile tile;
+    tile.heights = std::move(build.heights);
+    tile.occluder_heights = std::move(build.occluder_heights);
+    tile.min_height = build.min_height;
+    tile.max_height = build.max_height;
+
+    uint32_t resolution = config.height_resolution;
+
+    glGenTextures(1, &tile.texture);
+    glBindTexture(GL_TEXTURE_2D, tile.texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, resolution, resolution, 0, GL_RED, GL_FLOAT, tile.heights.data());
+
+    // The heights stay on the CPU, so an evicted tile is uploaded again when drawn
+    uint32_t texture = tile.texture;
+    tile.asset = residency::track(ASSET_TEXTURE, tile.heights.size() * sizeof(float), [texture]() {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, 1, 1, 0, GL_RED, GL_FLOAT, nullptr);
+    });
+
+    tiles[build.key] = std::move(tile);
+}
+
+void Terrain::add_occluders(OcclusionCuller& culler) const
+{
+    glm::dvec3 camera = glm::dvec3(glm::inverse(world_matrix) * glm::dvec4(culler.get_camera_position(), 1.0));
+    glm::vec2 player(camera.x, camera.z);
+
+    uint32_t side = config.occluder_resolution;
+    float spacing = config.tile_size / (side - 1);
+
+    std::vector<glm::vec3> vertices(side * side);
+
+    for (const auto& entry : tiles)
+    {
+        glm::vec2 origin = glm::vec2(entry.first.first, entry.first.second) * config.tile_size;
+        if (glm::length(player - glm::clamp(player, origin, origin + config.tile_size)) > config.occluder_distance) continue;
+
+        for (uint32_t z = 0; z < side; z++)
+        {
+            for (uint32_t x = 0; x < side; x++)
+            {
+                glm::dvec3 position(origin.x + x * spacing, entry.second.occluder_heights[z * side + x], origin.y + z * spacing);
+                vertices[z * side + x] = glm::vec3(glm::dvec3(world_matrix * glm::dvec4(position, 1.0)) - culler.get_camera_position());
+            }
+        }
+
+        culler.add_triangles(vertices.data(), vertices.size(), occluder_indices.data(), occluder_indices.size());
+    }
+}
+
+void Terrain::release_tile(Tile& tile)
+{
+    glDeleteTextures(1, &tile.texture);
+    residency::untrack(tile.asset);
+    tile.asset = NO_ASSET;
+}
+
+/* #region drawing */
+
+bool Terrain::select_node(const glm::vec2& origin, float size, uint32_t level, const Tile& tile, const glm::vec3& camera, const Frustum& frustum)
+{
+    AABB box { glm::vec3(origin.x, tile.min_height, origin.y), glm::vec3(origin.x + size, tile.max_height, origin.y + size) };
+    float distance = box.distance_to(camera);
+
+    if (distance > lod_ranges[level]) return false;
+
+    // Nothing to draw, but the area is taken care of
+    if (distance > draw_distance || !frustum.intersects(box)) return true;
+
+    if (level == 0 || distance > lod_ranges[level - 1])
+    {
+        add_node(origin, size, level, 1.0f);
+        return true;
+    }
+
+    float half = size * 0.5f;
+
+    for (const glm::vec2& offset : { glm::vec2(0.0f, 0.0f), glm::vec2(half, 0.0f), glm::vec2(0.0f, half), glm::vec2(half, half) })
+    {
+        if (!select_node(origin + offset, half, level - 1, tile, camera, frustum))
+        {
+            add_node(origin + offset, half, level, 2.0f);
+        }
+    }
+
+    return true;
+}
+
+void Terrain::add_node(const glm::vec2& origin, float size, uint32_t level, float subdivision)
+{
+    float range = lod_ranges[level];
+    node_instances.push_back(NodeInstance { origin, size, subdivision, glm::vec2(range * (1.0f - config.morph_fraction), range) });
+}
+
+void Terrain::draw(const glm::mat4& projection, const glm::dmat4& view)
+{
+    if (tiles.empty()) return;
+
+    // Selection runs in terrain space, drawing relative to each tile, so the shader
+    // never sees coordinates larger than a tile
+    glm::dmat4 view_transform = view * world_matrix;
+    glm::dvec3 camera_exact = glm::dvec3(glm::inverse(view_transform)[3]);
+    glm::vec3 camera = glm::vec3(camera_exact);
+    Frustum frustum = Frustum::from_matrix(glm::mat4(glm::dmat4(projection) * view_transform));
+
+    struct TileDraw
+    {
+        const Tile* tile;
+        glm::vec2 origin;
+        size_t first;
+        size_t count;
+    };
+
+    std::vector<TileDraw> draws;
+    node_instances.clear();
+
+    for (const auto& entry : tiles)
+    {
+        glm::vec2 origin = glm::vec2(entry.first.first, entry.first.second) * config.tile_size;
+        size_t first = node_instances.size();
+
+        select_node(origin, config.tile_size, config.lod_levels - 1, entry.second, camera, frustum);
+
+        if (node_instances.size() > first)
+        {
+            for (size_t i = first; i < node_instances.size(); i++)
+            {
+                node_instances[i].origin -= origin;
+            }
+
+            draws.push_back(TileDraw { &entry.second, origin, first, node_instances.size() - first });
+        }
+    }
+
+    stats.nodes = node_instances.size();
+    stats.triangles = stats.nodes * config.grid_size * config.grid_size * 2;
+
+    if (draws.empty()) return;
+
+    shader->use();
+    shader->set_float("grid_size", (float) config.grid_size);
+    shader->set_float("height_resolution", (float) config.height_resolution);
+    shader->set_float("tile_size", config.tile_size);
+    shader->set_float("texture_scale", config.texture_scale);
+    shader->set_int("our_texture", 0);
+    shader->set_int("height_map", 1);
+
+    glActiveTexture(GL_TEXTURE0);
+    image_registry::bind_texture(ground_texture);
+
+    glBindVertexArray(VAO);
+
+    // Rewritten every frame, straight into the mapped stream buffer
+    size_t instance_bytes = node_instances.size() * sizeof(NodeInstance);
+    instance_stream->begin_frame(instance_bytes + sizeof(NodeInstance));
+
+    StreamAllocation instances = instance_stream->allocate(instance_bytes, sizeof(NodeInstance));
+    std::memcpy(instances.data, node_instances.data(), instance_bytes);
+    instance_stream->flush();
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_stream->get_buffer());
+
+    for (const TileDraw& draw : draws)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, draw.tile->texture);
+
+        if (!residency::use(draw.tile->asset))
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, config.height_resolution, config.height_resolution, 0, GL_RED, GL_FLOAT, draw.tile->heights.data());
+            residency::reloaded(draw.tile->asset);
+        }
+
+        glm::dvec3 tile_origin = glm::dvec3(draw.origin.x, 0.0, draw.origin.y);
+
+        shader->set_mat4("model_view", glm::mat4(glm::translate(view_transform, tile_origin)));
+        shader->set_vec3("camera_position", glm::vec3(camera_exact - tile_origin));
+        shader->set_vec2("texture_offset", glm::mod(draw.origin, glm::vec2(config.texture_scale)));
+
+        // GL 3.3 has no base instance, so the attributes point at the tile's first node instead
+        size_t offset = instances.offset + draw.first * sizeof(NodeInstance);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(NodeInstance), (void*) (offset + offsetof(NodeInstance, origin)));
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(NodeInstance), (void*) (offset + offsetof(NodeInstance, morph)));
+
+        glDrawElementsInstanced(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, 0, draw.count);
+    }
+
+    instance_stream->end_frame();
+
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+/* #endregion */
+
+void Terrain::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        requests.clear();
+    }
+
+    jobs::wait(builds);
+
+    finished.clear();
+    pending.clear();
+
+    for (auto& entry : tiles) release_tile(entry.second);
+    tiles.clear();
+
+    if (VAO != 0)
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &grid_VBO);
+        glDeleteBuffers(1, &grid_EBO);
+        instance_stream->destroy();
+        VAO = 0;
+    }
+
+    stats = TerrainStats();
+}
+
+void Terrain::set_draw_distance(float distance)
+{
+    draw_distance = distance;
+}
+
+const TerrainStats& Terrain::get_stats() const
+{
+    return stats;
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vec2.hpp>
+#include <vec3.hpp>
+#include <vec4.hpp>
+#include <mat4x4.hpp>
+
+#include "route.hpp"
+#include "scene.hpp"
+#include "bounds.hpp"
+#include "shader.hpp"
+#include "residency.hpp"
+#include "jobs.hpp"
+#include "stream_buffer.hpp"
+
+class OcclusionCuller;
+
+struct TerrainConfig
+{
+    uint32_t seed = 31;
+
+    // Every tile has its own height map and is the root of a quadtree of lod_levels
+    // levels, whose leaves are drawn with the same grid as the root
+    float tile_size = 256.0f;
+    uint32_t height_resolution = 257;
+    uint32_t lod_levels = 5;
+    uint32_t grid_size = 16;
+
+    // A level is drawn up to leaf size * 2^level * lod_range_factor from the camera,
+    // and morphs into the next coarser level over the last morph_fraction of that range
+    float lod_range_factor = 2.5f;
+    float morph_fraction = 0.3f;
+
+    // Heights in metres. The road and its grass planes stay on top of the flat part,
+    // which ends flat_width from the road and rises to the hills over rise_width.
+    float hill_height = 45.0f;
+    float hill_scale = 300.0f;
+    float flat_height = -0.3f;
+    float flat_width = 35.0f;
+    float rise_width = 80.0f;
+
+    // The start level sits around the route origin
+    float clearing_radius = 45.0f;
+
+    // World space size of one repeat of the ground texture
+    float texture_scale = 10.0f;
+
+    const char* texture = "grass_1.png";
+
+    // Tiles built at the same time on the job system
+    uint32_t parallel_builds = 2;
+
+    // Tiles closer than this are occluders, as a coarser grid of this many heights per
+    // side. height_resolution - 1 has to be a multiple of occluder_resolution - 1.
+    float occluder_distance = 400.0f;
+    uint32_t occluder_resolution = 17;
+};
+
+struct TerrainStats
+{
+    uint32_t resident_tiles = 0;
+    uint32_t pending_tiles = 0;
+    uint32_t nodes = 0;
+    uint32_t triangles = 0;
+};
+
+// Height map terrain drawn with continuous distance based LOD (CDLOD). The whole terrain
+// is drawn with a single grid mesh: every selected quadtree node is an instance of it,
+// scaled to the node, and the vertex shader reads the heights from the node's tile
+// and morphs vertices into the next coarser grid with distance, so levels meet without
+// cracks and the triangle count only depends on the LOD ranges, not on how far the
+// camera can see.
+//
+// Tiles are built by jobs around the player. The terrain is flattened next
+// to the road, so it needs the route: the route never turns back on itself, so every
+// chunk that can pass through a tile is known once the route is generated past it.
+class Terrain
+{
+public:
+    // The terrain lies in the space of `world`, like the streamed road.
+    Terrain(Scene* world, Shader* shader, Route& route, const TerrainConfig& config);
+    ~Terrain();
+
+    Terrain(const Terrain&) = delete;
+    Terrain& operator = (const Terrain&) = delete;
+
+    // Call once per frame on the GL thread, with the player position in world space.
+    void update(const glm::dvec3& player_position);
+
+    // Only reads what update() left behind, so it can run on the render thread.
+    void draw(const glm::mat4& projection, const glm::dmat4& view);
+
+    // Adds a coarse grid of every tile within occluder_distance of the culler's camera.
+    // Every height is the lowest one around it, so the grid lies below the terrain and
+    // never hides anything the terrain doesn't. Only reads what update() left behind.
+    void add_occluders(OcclusionCuller& culler) const;
+
+    // Tiles and nodes further away than this are neither built nor drawn, when it is
+    // shorter than the range of the coarsest level.
+    void set_draw_distance(float distance);
+
+    // Waits for the build jobs and drops every tile. Has to run while the GL context exists.
+    void shutdown();
+
+    const TerrainStats& get_stats() const;
+
+    // Height of the terrain in the space of the world scene, the same function the
+    // tiles are built from.
+    static float get_height(const glm::vec2& position, const TerrainConfig& config, const std::vector<std::vector<glm::vec2>>& roads, const glm::vec2& clearing);
+
+private:
+    typedef std::pair<int32_t, int32_t> TileKey;
+
+    struct TileRequest
+    {
+        TileKey key;
+        float distance;
+
+        // Centre lines of the route chunks that can reach the tile
+        std::vector<std::vector<glm::vec2>> roads;
+    };
+
+    struct TileBuild
+    {
+        TileKey key;
+        std::vector<float> heights;
+        std::vector<float> occluder_heights;
+        float min_height;
+        float max_height;
+    };
+
+    struct Tile
+    {
+        std::vector<float> heights;
+        std::vector<float> occluder_heights;
+        float min_height;
+        float max_height;
+
+        uint32_t texture;
+        AssetId asset = NO_ASSET;
+    };
+
+    // Per instance data of a selected node, attributes 3 (xz origin in the tile, size, subdivision)
+    // and 4 (morph range). Nodes standing in for their parent's quarter are drawn with
+    // their own grid, subdivided twice as fine as their parent's level.
+    struct NodeInstance
+    {
+        glm::vec2 origin;
+        float size;
+        float subdivision;
+        glm::vec2 morph;
+    };
+
+    Scene* world;
+    Shader* shader;
+
+    // Of the world scene as of the last update()
+    glm::dmat4 world_matrix = glm::dmat4(1.0);
+    Route& route;
+    TerrainConfig config;
+
+    glm::vec2 clearing;
+    glm::vec2 heading;
+    std::vector<float> lod_ranges;
+    float draw_distance;
+
+    uint32_t VAO = 0, grid_VBO, grid_EBO;
+    std::unique_ptr<StreamBuffer> instance_stream;
+    uint32_t index_count;
+    uint32_t ground_texture;
+
+    // Of the occluder grid, the same for every tile
+    std::vector<uint32_t> occluder_indices;
+
+    // Jobs building tiles, each takes the nearest request until none are left
+    JobCounter builds;
+
+    // Shared with the build jobs
+    std::mutex mutex;
+    bool stopping = false;
+    uint32_t running_builds = 0;
+    std::deque<TileRequest> requests;     // nearest first
+    std::deque<TileBuild> finished;
+    std::string worker_error;
+
+    // GL thread only
+    std::set<TileKey> pending;
+    std::map<TileKey, Tile> tiles;
+    std::vector<NodeInstance> node_instances;
+    TerrainStats stats;
+
+    void build_requests();
+    void start_builds();
+    static TileBuild build_tile(const TileRequest& request, const TerrainConfig& config, const glm::vec2& clearing);
+
+    void create_grid();
+    std::vector<std::vector<glm::vec2>> gather_roads(const TileKey& key);
+    void upload_tile(TileBuild& build);
+    void release_tile(Tile& tile);
+
+    // Appends the nodes below (origin, size) to draw. Returns false when the node is out
+    // of range of its level, so the parent has to cover its area.
+    bool select_node(const glm::vec2& origin, float size, uint32_t level, const Tile& tile, const glm::vec3& camera, const Frustum& frustum);
+    void add_node(const glm::vec2& origin, float size, uint32_t level, float subdivision);
+};
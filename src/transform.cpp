@@ -1,31 +1,73 @@
 #include "transform.hpp"
 
+#include <cmath>
+
+#include <mat3x3.hpp>
 #include <gtc/matrix_transform.hpp>
 
-void Transform::regenerate_transformation_matrix()
+glm::dmat4 Transform::get_local_matrix() const
+{
+    glm::dmat4 matrix = glm::dmat4(1.0);
+
+    matrix = glm::scale(matrix, glm::dvec3(scale));
+
+    matrix = glm::rotate(matrix, (double) rotation.x, glm::dvec3(1.0, 0.0, 0.0));
+    matrix = glm::rotate(matrix, (double) rotation.y, glm::dvec3(0.0, 1.0, 0.0));
+    matrix = glm::rotate(matrix, (double) rotation.z, glm::dvec3(0.0, 0.0, 1.0));
+
+    matrix = glm::translate(matrix, position);
+
+    return matrix;
+}
+
+Transform Transform::from_matrix(const glm::dmat4& matrix)
 {
-    transformation_matrix = glm::mat4(1.0f);
+    Transform transform;
 
-    transformation_matrix = glm::scale(transformation_matrix, scale);
+    // The upper 3x3 is scale * rotation, so every row carries one scale factor
+    glm::mat3 basis = glm::mat3(glm::dmat3(matrix));
+    for (int row = 0; row < 3; row++)
+    {
+        transform.scale[row] = glm::length(glm::vec3(basis[0][row], basis[1][row], basis[2][row]));
+    }
 
-    transformation_matrix = glm::rotate(transformation_matrix, rotation.x, glm::vec3(1.0, 0.0, 0.0));
-    transformation_matrix = glm::rotate(transformation_matrix, rotation.y, glm::vec3(0.0, 1.0, 0.0));
-    transformation_matrix = glm::rotate(transformation_matrix, rotation.z, glm::vec3(0.0, 0.0, 1.0));
+    glm::mat3 rotation = basis;
+    for (int column = 0; column < 3; column++)
+    {
+        rotation[column] /= transform.scale;
+    }
 
-    transformation_matrix = glm::translate(transformation_matrix, position);
+    // Rotation is Rx * Ry * Rz, rotation[column][row]
+    float sin_y = glm::clamp(rotation[2][0], -1.0f, 1.0f);
+    transform.rotation.y = asin(sin_y);
 
-    if (parent != nullptr) 
+    if (glm::abs(sin_y) < 0.99999f)
     {
-        transformation_matrix *= parent->transformation_matrix;
+        transform.rotation.x = atan2(-rotation[2][1], rotation[2][2]);
+        transform.rotation.z = atan2(-rotation[1][0], rotation[0][0]);
     }
-    
-    if (children.size() > 0)
+    else
     {
-        for (size_t i = 0; i < children.size(); i++)
-        {
-            children[i]->regenerate_transformation_matrix();
-        }
+        // Gimbal lock, only x + z is defined
+        transform.rotation.x = atan2(rotation[1][2], rotation[1][1]);
+        transform.rotation.z = 0.0f;
     }
+
+    // The translation is applied before scale and rotation
+    transform.position = glm::inverse(glm::dmat3(matrix)) * glm::dvec3(matrix[3]);
+
+    return transform;
+}
+
+Transform Transform::interpolate(const Transform& from, const Transform& to, float alpha)
+{
+    Transform transform;
+
+    transform.scale = from.scale + (to.scale - from.scale) * alpha;
+    transform.rotation = from.rotation + (to.rotation - from.rotation) * alpha;
+    transform.position = from.position + (to.position - from.position) * (double) alpha;
+
+    return transform;
 }
 
 Transform Transform::operator + (const Transform& t) const
@@ -38,4 +80,4 @@ Transform Transform::operator + (const Transform& t) const
     ret.scale += t.scale + scale;
 
     return ret;
-}
\ No newline at end of file
+}
@@ -1,22 +1,27 @@
 #pragma once
 
-#include <vector>
-
 #include <vec3.hpp>
 #include <mat4x4.hpp>
 
 struct Transform
 {
-    const Transform* parent = nullptr;
-    std::vector<Transform*> children;
-
     glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
     glm::vec3 rotation = glm::vec3(0.0f, 0.0f, 0.0f);
-    glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
 
-    glm::mat4 transformation_matrix;
+    // Double, so the streamed world stays exact to well below a millimetre hundreds
+    // of kilometres from the origin. Only camera relative matrices are turned back into
+    // floats for the GPU.
+    glm::dvec3 position = glm::dvec3(0.0, 0.0, 0.0);
+
+    // Local matrix only, the parent is applied by the transform system.
+    glm::dmat4 get_local_matrix() const;
+
+    // Inverse of get_local_matrix(). Shear can't be represented and is dropped.
+    static Transform from_matrix(const glm::dmat4& matrix);
 
-    void regenerate_transformation_matrix();  
+    // Componentwise blend, alpha 0 is `from` and 1 is `to`. Rotations are blended as
+    // angles, which is fine between the nearby states of two simulation ticks.
+    static Transform interpolate(const Transform& from, const Transform& to, float alpha);
 
     Transform operator + (const Transform& t) const;
 };
@@ -0,0 +1,148 @@
+#include "upload_thread.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+typedef std::chrono::steady_clock Clock;
+
+UploadThread::UploadThread(GLFWwindow* shared_with)
+{
+    // Keeps the context version hints of the main window, contexts only share objects
+    // with compatible ones
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window = glfwCreateWindow(1, 1, "uploads", NULL, shared_with);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    if (window == NULL)
+    {
+        throw std::runtime_error("Failed to create the shared upload context");
+    }
+
+    thread = std::thread(&UploadThread::loop, this);
+}
+
+UploadThread::~UploadThread()
+{
+    stop();
+}
+
+void UploadThread::submit(std::function<void()> upload, std::function<void()> on_visible)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (stopping) throw std::runtime_error("Tried submitting an upload after the upload thread stopped.");
+
+    queued.push_back(Upload { std::move(upload), std::move(on_visible), nullptr, nullptr });
+    stats.pending++;
+    condition.notify_all();
+}
+
+uint32_t UploadThread::publish()
+{
+    uint32_t published = 0;
+
+    while (true)
+    {
+        Upload upload;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (fenced.empty()) return published;
+
+            // Fences signal in the order the uploads were flushed, so the first one
+            // that isn't done yet ends the search
+            GLsync fence = static_cast<GLsync>(fenced.front().fence);
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return published;
+
+            glDeleteSync(fence);
+
+            upload = std::move(fenced.front());
+            fenced.pop_front();
+            stats.pending--;
+        }
+
+        // Outside the lock, on_visible may submit the next upload
+        if (upload.error) std::rethrow_exception(upload.error);
+        upload.on_visible();
+
+        published++;
+    }
+}
+
+void UploadThread::stop()
+{
+    if (!thread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        condition.notify_all();
+    }
+
+    thread.join();
+
+    for (Upload& upload : fenced) glDeleteSync(static_cast<GLsync>(upload.fence));
+    fenced.clear();
+    stats.pending = 0;
+
+    glfwDestroyWindow(window);
+}
+
+UploadStats UploadThread::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void UploadThread::loop()
+{
+    glfwMakeContextCurrent(window);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        condition.wait(lock, [this]() { return stopping || !queued.empty(); });
+
+        // What was submitted still goes up, whoever submitted it may hold its names
+        if (queued.empty()) break;
+
+        Upload upload = std::move(queued.front());
+        queued.pop_front();
+
+        lock.unlock();
+
+        Clock::time_point start = Clock::now();
+
+        try
+        {
+            upload.upload();
+        }
+        catch (...)
+        {
+            upload.error = std::current_exception();
+        }
+
+        // Flushed, or the fence might never reach the GPU for the other context to see
+        upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        lock.lock();
+
+        stats.uploads++;
+        stats.upload_ms += elapsed;
+        stats.worst_upload_ms = std::max(stats.worst_upload_ms, elapsed);
+
+        fenced.push_back(std::move(upload));
+    }
+
+    lock.unlock();
+    glfwMakeContextCurrent(nullptr);
+}
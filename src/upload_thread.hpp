@@ -0,0 +1,120 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Declared here so the header can come before glad
+struct GLFWwindow;
+
+struct UploadStats
+{
+    uint64_t uploads = 0;
+
+    // Time the upload thread spent in uploads, over all of them and the longest one
+    double upload_ms = 0.0;
+    double worst_upload_ms = 0.0;
+
+    // Submitted, but not published yet
+    uint32_t pending = 0;
+};
+
+// Uploads buffers and textures on its own thread, through the context of a hidden window
+// that shares its objects with the main one, so glBufferData and glTexImage2D don't
+// stall the thread that draws.
+//
+// Another context may only use an object once the commands that filled it completed,
+// so every upload is followed by a fence, and publish() hands results over only once
+// their fence signalled. Vertex arrays aren't shared between contexts, those still have
+// to be created on the thread that draws.
+class UploadThread
+{
+public:
+    // Creates the hidden window, which GLFW only allows on the main thread, and starts
+    // the thread. The window's context doesn't have to be current.
+    explicit UploadThread(GLFWwindow* shared_with);
+    ~UploadThread();
+
+    UploadThread(const UploadThread&) = delete;
+    UploadThread& operator = (const UploadThread&) = delete;
+
+    // `upload` runs on the upload thread, `on_visible` in publish() once the GPU has
+    // finished what `upload` did. publish() rethrows what `upload` throws.
+    void submit(std::function<void()> upload, std::function<void()> on_visible);
+
+    // Runs on_visible of every finished upload, in the order they were submitted. Call
+    // on the thread that draws. Returns how many were published.
+    uint32_t publish();
+
+    // Awaiting it runs `upload` on the upload thread and continues the coroutine in
+    // publish() once the result is visible. Rethrows what `upload` throws.
+    auto upload(std::function<void()> upload)
+    {
+        struct Awaiter
+        {
+            UploadThread& thread;
+            std::function<void()> upload;
+            std::exception_ptr error;
+
+            bool await_ready() noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                thread.submit([this]() {
+                    try
+                    {
+                        upload();
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+                }, [handle]() { handle.resume(); });
+            }
+
+            void await_resume()
+            {
+                if (error) std::rethrow_exception(error);
+            }
+        };
+
+        return Awaiter { *this, std::move(upload), nullptr };
+    }
+
+    // Finishes the submitted uploads, joins the thread and destroys the hidden window.
+    // Uploads that weren't published are dropped. Call on the main thread, with a
+    // context of the share group current.
+    void stop();
+
+    UploadStats get_stats();
+
+private:
+    struct Upload
+    {
+        std::function<void()> upload;
+        std::function<void()> on_visible;
+
+        // GLsync, created once the upload ran
+        void* fence = nullptr;
+        std::exception_ptr error;
+    };
+
+    GLFWwindow* window;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    std::deque<Upload> queued;
+    std::deque<Upload> fenced;
+
+    UploadStats stats;
+
+    void loop();
+};
@@ -0,0 +1,676 @@
+#include "world_streamer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+
+#include <matrix.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/constants.hpp>
+
+#include "road_mesh.hpp"
+
+// Lateral offsets of the 10m grass planes beside a straight road tile
+const float GROUND_OFFSETS[] = { -20.0f, -10.0f, 10.0f, 20.0f };
+
+typedef std::chrono::steady_clock Clock;
+
+static double milliseconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static glm::mat4 placement_matrix(const glm::vec3& position, float yaw)
+{
+    return glm::rotate(glm::translate(glm::mat4(1.0f), position), yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+static void append_model(std::map<std::string, MeshData>& batches, const ModelSource& source, const glm::mat4& matrix, AABB& bounds)
+{
+    // Placements only rotate around y, so normals don't need the inverse transpose
+    glm::mat3 normal_matrix(matrix);
+
+    for (const MeshData& mesh : source.meshes)
+    {
+        MeshData& batch = batches[mesh.texture_name];
+        batch.texture_name = mesh.texture_name;
+
+        uint32_t base = batch.vertices.size();
+
+        for (const Vertex& vertex : mesh.vertices)
+        {
+            Vertex placed = vertex;
+            placed.position = glm::vec3(matrix * glm::vec4(vertex.position, 1.0f));
+            placed.normal = normal_matrix * vertex.normal;
+
+            batch.vertices.push_back(placed);
+            bounds.expand(placed.position);
+        }
+
+        for (uint32_t index : mesh.indices)
+        {
+            batch.indices.push_back(base + index);
+        }
+    }
+}
+
+WorldStreamer::WorldStreamer(Scene* world, Shader* shader, const FoliageShaders& foliage_shaders, const StreamingConfig& config)
+    : world(world), shader(shader), foliage_shaders(foliage_shaders), config(config), route(config.origin, config.heading, config.route_style == ROUTE_SPLINE ? config.segments_per_chunk : config.tiles_per_chunk, config.seed, config.route_style)
+{
+}
+
+WorldStreamer::~WorldStreamer()
+{
+    shutdown();
+}
+
+/* #region builds */
+
+void WorldStreamer::build_requests()
+{
+    while (true)
+    {
+        RouteChunk chunk;
+        std::vector<glm::vec3> nearby_centerline;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (stopping || requests.empty())
+            {
+                running_builds--;
+                return;
+            }
+
+            chunk = std::move(requests.front().chunk);
+            nearby_centerline = std::move(requests.front().nearby_centerline);
+            requests.pop_front();
+        }
+
+        try
+        {
+            ChunkBuild build = build_chunk(chunk, nearby_centerline);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(std::move(build));
+        }
+        catch (const std::exception& e)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            worker_error = e.what();
+        }
+    }
+}
+
+// Call with the mutex held
+void WorldStreamer::start_builds()
+{
+    while (running_builds < std::max(config.parallel_builds, 1u) && running_builds < requests.size())
+    {
+        running_builds++;
+        jobs::run([this]() { build_requests(); }, &builds, JOB_BACKGROUND);
+    }
+}
+
+WorldStreamer::ChunkBuild WorldStreamer::build_chunk(const RouteChunk& chunk, const std::vector<glm::vec3>& nearby_centerline)
+{
+    ChunkBuild build;
+    build.index = chunk.index;
+    build.origin = chunk.origin;
+    build.bounds = AABB::empty();
+
+    std::map<std::string, MeshData> batches;
+
+    // Spline routes have no tiles, their road and grass are swept along the centre line
+    if (chunk.tiles.empty())
+    {
+        for (const RoadProfile* profile : { &road_mesh::ROAD, &road_mesh::LEFT_VERGE, &road_mesh::RIGHT_VERGE })
+        {
+            road_mesh::extrude(*profile, chunk, batches[profile->texture_name], build.bounds);
+        }
+    }
+
+    for (const RouteTile& tile : chunk.tiles)
+    {
+        std::shared_ptr<const ModelSource> source = mesh_registry::decode_model(Route::get_tile_model(tile.type));
+        append_model(batches, *source, placement_matrix(tile.position - chunk.origin, tile.yaw), build.bounds);
+    }
+
+    // Grass beside the straights, the curve tiles already have their own
+    std::shared_ptr<const ModelSource> foliage_source = mesh_registry::decode_model(foliage::SOURCE_MODEL);
+    ModelSource ground = foliage::extract_ground(*foliage_source);
+
+    for (const RouteTile& tile : chunk.tiles)
+    {
+        if (tile.type != TILE_STRAIGHT) continue;
+
+        for (float offset : GROUND_OFFSETS)
+        {
+            glm::mat4 placement = placement_matrix(tile.position - chunk.origin, tile.yaw)
+                * placement_matrix(glm::vec3(offset, 0.0f, 0.0f), 0.0f);
+
+            append_model(batches, ground, placement, build.bounds);
+        }
+    }
+
+    ModelSource tree = foliage::extract_tree(*foliage_source);
+
+    build.foliage_bounds = AABB::empty();
+    build.foliage = foliage::scatter(chunk, nearby_centerline, config.foliage, tree.bounds, build.foliage_bounds);
+    build.bytes += build.foliage.size() * sizeof(Instance);
+
+    std::set<std::string> texture_names;
+    build.collision = std::make_unique<TriangleBVH>();
+
+    for (auto& batch : batches)
+    {
+        texture_names.insert(batch.first);
+        build.collision->add_mesh(batch.second.vertices, batch.second.indices);
+
+        build.bytes += batch.second.vertices.size() * sizeof(Vertex) + batch.second.indices.size() * sizeof(uint32_t);
+        build.batches.push_back(std::move(batch.second));
+    }
+
+    build.collision->build();
+    build.bytes += build.collision->get_memory_bytes();
+
+    for (const MeshData& mesh : tree.meshes)
+    {
+        texture_names.insert(mesh.texture_name);
+    }
+
+    for (const std::string& texture_name : texture_names)
+    {
+        if (texture_name.empty()) continue;
+
+        // The first chunk that needs a texture decodes it, later ones wait for its upload
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!claimed_textures.insert(texture_name).second) continue;
+        }
+
+        build.images.push_back(image_registry::decode_texture(texture_name));
+    }
+
+    return build;
+}
+
+/* #endregion */
+
+void WorldStreamer::update(const glm::dvec3& player_position, const glm::vec3& player_velocity)
+{
+    glm::dmat4 inverse_world = glm::inverse(world->get_transformation_matrix());
+    glm::vec3 position = glm::vec3(inverse_world * glm::dvec4(player_position, 1.0));
+    glm::vec3 velocity = glm::mat3(glm::dmat3(inverse_world)) * player_velocity;
+
+    RouteLocation location = route.locate(position, stats.player_chunk);
+    stats.player_chunk = location.chunk;
+    stats.route_distance = location.distance;
+    stats.route_speed = glm::dot(velocity, location.direction);
+
+    select_chunks();
+
+    for (auto it = resident.begin(); it != resident.end();)
+    {
+        if (wanted.count(it->first))
+        {
+            it++;
+            continue;
+        }
+
+        stats.resident_bytes -= it->second.bytes;
+        it = resident.erase(it);
+    }
+
+    request_chunks();
+    upload_ready();
+    evict_over_budget();
+    count_misses();
+
+    stats.resident_chunks = resident.size();
+    stats.pending_chunks = pending.size();
+    stats.ready_chunks = ready.size();
+}
+
+float WorldStreamer::get_time_to_visible(const RouteChunk& chunk) const
+{
+    float visible_start = stats.route_distance - config.view_distance;
+    float visible_end = stats.route_distance + config.view_distance;
+    float chunk_end = chunk.start_distance + chunk.length;
+
+    if (chunk_end >= visible_start && chunk.start_distance <= visible_end) return 0.0f;
+
+    // Chunks ahead come closer with forward speed, chunks behind with backward speed
+    float gap, speed;
+    if (chunk.start_distance > visible_end)
+    {
+        gap = chunk.start_distance - visible_end;
+        speed = stats.route_speed;
+    }
+    else
+    {
+        gap = visible_start - chunk_end;
+        speed = -stats.route_speed;
+    }
+
+    return gap / std::max(speed, config.min_prefetch_speed);
+}
+
+void WorldStreamer::select_chunks()
+{
+    wanted.clear();
+
+    uint32_t first = stats.player_chunk - std::min(config.chunks_behind, stats.player_chunk);
+    uint32_t last = stats.player_chunk + config.max_chunks_ahead;
+
+    for (uint32_t index = first; index <= last; index++)
+    {
+        float time_to_visible = get_time_to_visible(route.get_chunk(index));
+
+        // Resident chunks stay while in range, so a speed change doesn't drop and
+        // refetch them
+        bool near = index >= stats.player_chunk && index <= stats.player_chunk + config.chunks_ahead;
+
+        if (near || time_to_visible <= config.prefetch_seconds || resident.count(index))
+        {
+            wanted[index] = time_to_visible;
+        }
+    }
+}
+
+void WorldStreamer::count_misses()
+{
+    for (auto it = missed.begin(); it != missed.end();)
+    {
+        if (wanted.count(*it) && !resident.count(*it)) it++;
+        else it = missed.erase(it);
+    }
+
+    stats.missing_chunks = 0;
+
+    for (auto& chunk : wanted)
+    {
+        if (chunk.second > 0.0f || resident.count(chunk.first)) continue;
+
+        stats.missing_chunks++;
+        if (missed.insert(chunk.first).second) stats.misses++;
+    }
+}
+
+void WorldStreamer::request_chunks()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!worker_error.empty())
+    {
+        throw std::runtime_error("Failed to build a world chunk: " + worker_error);
+    }
+
+    // Requests that fell behind the player before a job picked them up are cancelled,
+    // the rest get their priority refreshed
+    for (auto it = requests.begin(); it != requests.end();)
+    {
+        auto chunk = wanted.find(it->chunk.index);
+
+        if (chunk != wanted.end())
+        {
+            it->time_to_visible = chunk->second;
+            it++;
+            continue;
+        }
+
+        pending.erase(it->chunk.index);
+        it = requests.erase(it);
+    }
+
+    while (!finished.empty())
+    {
+        ready.push_back(std::move(finished.front()));
+        finished.pop_front();
+    }
+
+    std::vector<std::pair<float, uint32_t>> order;
+    for (auto& chunk : wanted)
+    {
+        order.push_back(std::make_pair(chunk.second, chunk.first));
+    }
+    std::sort(order.begin(), order.end());
+
+    // Chunks in flight are assumed to be as big as the ones already resident
+    size_t average_bytes = resident.empty() ? 0 : stats.resident_bytes / resident.size();
+    size_t projected_bytes = stats.resident_bytes + pending.size() * average_bytes;
+
+    for (auto& chunk : order)
+    {
+        float time_to_visible = chunk.first;
+        uint32_t index = chunk.second;
+
+        if (resident.count(index) || pending.count(index)) continue;
+
+        // Visible chunks are always requested, the memory budget only limits prefetching
+        if (time_to_visible > 0.0f && projected_bytes + average_bytes > config.max_resident_bytes) continue;
+
+        pending.insert(index);
+        requests.push_back(ChunkRequest { route.get_chunk(index), route.get_nearby_centerline(index), time_to_visible });
+        projected_bytes += average_bytes;
+    }
+
+    std::stable_sort(requests.begin(), requests.end(), [](const ChunkRequest& a, const ChunkRequest& b) {
+        return a.time_to_visible < b.time_to_visible;
+    });
+
+    start_builds();
+}
+
+void WorldStreamer::upload_ready()
+{
+    Clock::time_point start = Clock::now();
+
+    // Soonest visible first, chunks nobody wants anymore last
+    auto time_to_visible = [this](const ChunkBuild& build) {
+        auto chunk = wanted.find(build.index);
+        return chunk != wanted.end() ? chunk->second : INFINITY;
+    };
+
+    std::stable_sort(ready.begin(), ready.end(), [&](const ChunkBuild& a, const ChunkBuild& b) {
+        return time_to_visible(a) < time_to_visible(b);
+    });
+
+    // Chunks waiting on a texture another chunk carries go to the back of the queue
+    size_t blocked_count = 0;
+
+    while (!ready.empty() && blocked_count < ready.size() && milliseconds_since(start) < config.upload_budget_ms)
+    {
+        ChunkBuild& build = ready.front();
+
+        bool blocked = false;
+        if (!upload_chunk(build, start, blocked))
+        {
+            if (!blocked) break;
+
+            ready.push_back(std::move(build));
+            ready.pop_front();
+            blocked_count++;
+            continue;
+        }
+
+        if (wanted.count(build.index))
+        {
+            attach_chunk(build);
+        }
+        else
+        {
+            for (Mesh& mesh : build.meshes) mesh.destroy_mesh();
+        }
+
+        pending.erase(build.index);
+        ready.pop_front();
+        blocked_count = 0;
+    }
+
+    stats.upload_ms = milliseconds_since(start);
+}
+
+bool WorldStreamer::upload_chunk(ChunkBuild& build, Clock::time_point start, bool& blocked)
+{
+    if (uploads != nullptr) return upload_chunk_async(build, blocked);
+
+    // Textures go up even for chunks that aren't wanted anymore, other chunks may rely on them
+    while (build.uploaded_images < build.images.size())
+    {
+        if (milliseconds_since(start) >= config.upload_budget_ms) return false;
+
+        const ImageData& image = build.images[build.uploaded_images++];
+        if (!image_registry::is_loaded(image.file_name)) image_registry::upload_texture(image);
+    }
+
+    build.images.clear();
+
+    if (!wanted.count(build.index)) return true;
+
+    while (build.meshes.size() < build.batches.size())
+    {
+        if (milliseconds_since(start) >= config.upload_budget_ms) return false;
+
+        MeshData& batch = build.batches[build.meshes.size()];
+
+        uint32_t texture = 0;
+        if (!batch.texture_name.empty())
+        {
+            if (!image_registry::is_loaded(batch.texture_name))
+            {
+                blocked = true;
+                return false;
+            }
+
+            texture = image_registry::get_texture(batch.texture_name);
+        }
+
+        build.meshes.push_back(Mesh(std::move(batch.vertices), std::move(batch.indices), texture));
+    }
+
+    if (!build.foliage.empty() && tree_meshes.empty() && !create_tree_prototype())
+    {
+        blocked = true;
+        return false;
+    }
+
+    return true;
+}
+
+// Waiting for the upload thread counts as blocked, so the chunks behind it carry on
+bool WorldStreamer::upload_chunk_async(ChunkBuild& build, bool& blocked)
+{
+    if (!build.upload)
+    {
+        std::shared_ptr<ChunkUpload> upload = std::make_shared<ChunkUpload>();
+        upload->images = std::move(build.images);
+
+        // Only wanted chunks get buffers, the textures may be needed by others
+        upload->has_meshes = wanted.count(build.index) > 0;
+        if (upload->has_meshes)
+        {
+            for (MeshData& batch : build.batches)
+            {
+                Mesh mesh;
+                mesh.vertices = std::move(batch.vertices);
+                mesh.indices = std::move(batch.indices);
+                mesh.texture = 0;
+
+                upload->meshes.push_back(std::move(mesh));
+            }
+        }
+
+        uploads->submit([upload]() {
+            for (const ImageData& image : upload->images) upload->textures.push_back(image_registry::create_texture(image));
+            for (Mesh& mesh : upload->meshes) mesh.create_buffers();
+        }, [upload]() {
+            upload->visible = true;
+        });
+
+        build.upload = upload;
+        blocked = true;
+        return false;
+    }
+
+    ChunkUpload& upload = *build.upload;
+    if (!upload.visible)
+    {
+        blocked = true;
+        return false;
+    }
+
+    for (size_t i = 0; i < upload.images.size(); i++)
+    {
+        image_registry::register_texture(upload.images[i], upload.textures[i]);
+    }
+    upload.images.clear();
+    upload.textures.clear();
+
+    if (!wanted.count(build.index))
+    {
+        for (Mesh& mesh : upload.meshes) mesh.destroy_mesh();
+        upload.meshes.clear();
+        return true;
+    }
+
+    if (!upload.has_meshes)
+    {
+        // Came back into view while its textures were on the way, the meshes go up now
+        build.upload.reset();
+        return upload_chunk_async(build, blocked);
+    }
+
+    for (size_t i = 0; i < upload.meshes.size(); i++)
+    {
+        const std::string& texture_name = build.batches[i].texture_name;
+        if (texture_name.empty()) continue;
+
+        if (!image_registry::is_loaded(texture_name))
+        {
+            blocked = true;
+            return false;
+        }
+
+        upload.meshes[i].texture = image_registry::get_texture(texture_name);
+    }
+
+    if (!build.foliage.empty() && tree_meshes.empty() && !create_tree_prototype())
+    {
+        blocked = true;
+        return false;
+    }
+
+    for (Mesh& mesh : upload.meshes) mesh.create_vertex_array();
+    build.meshes = std::move(upload.meshes);
+    build.upload.reset();
+
+    return true;
+}
+
+bool WorldStreamer::create_tree_prototype()
+{
+    // Workers parsed the model already, this only hits the cache
+    ModelSource tree = foliage::extract_tree(*mesh_registry::decode_model(foliage::SOURCE_MODEL));
+
+    for (const MeshData& mesh : tree.meshes)
+    {
+        if (!image_registry::is_loaded(mesh.texture_name)) return false;
+    }
+
+    tree_occluders = foliage::get_occluders(tree);
+
+    for (MeshData& mesh : tree.meshes)
+    {
+        tree_meshes.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), image_registry::get_texture(mesh.texture_name)));
+    }
+
+    tree_impostor = std::make_unique<Impostor>(tree_meshes.data(), tree_meshes.size(), tree.bounds, foliage_shaders.impostor_bake);
+
+    return true;
+}
+
+void WorldStreamer::attach_chunk(ChunkBuild& build)
+{
+    ResidentChunk chunk;
+    chunk.arena = std::make_unique<NodeArena>();
+    chunk.bytes = build.bytes;
+
+    Scene* scene = chunk.arena->get(chunk.arena->create_scene());
+    scene->set_position(glm::dvec3(build.origin));
+    scene->set_static_batch(std::move(build.meshes), build.bounds, shader, DRAW_ROAD);
+    scene->set_collision(std::move(build.collision));
+
+    if (!build.foliage.empty())
+    {
+        std::unique_ptr<InstanceBatch> batch = std::make_unique<InstanceBatch>(tree_meshes.data(), tree_meshes.size(), std::move(build.foliage));
+        batch->thin_start = config.foliage.thin_start;
+        batch->thin_end = config.foliage.thin_end;
+        batch->min_fraction = config.foliage.min_fraction;
+        batch->set_impostor(tree_impostor.get(), foliage_shaders.impostors, config.foliage.impostor_start, config.foliage.impostor_end);
+
+        Scene* trees = chunk.arena->get(chunk.arena->create_scene());
+        scene->add_scene(trees);
+        trees->set_instance_batch(std::move(batch), build.foliage_bounds, foliage_shaders.meshes);
+        trees->set_occluders(tree_occluders, config.foliage.occluder_distance);
+    }
+
+    world->add_scene(scene);
+
+    stats.resident_bytes += chunk.bytes;
+    resident[build.index] = std::move(chunk);
+}
+
+void WorldStreamer::evict_over_budget()
+{
+    // The chunks that would come into view last go first, visible chunks always stay
+    while (stats.resident_bytes > config.max_resident_bytes)
+    {
+        auto latest = resident.end();
+        float latest_time = 0.0f;
+
+        for (auto it = resident.begin(); it != resident.end(); it++)
+        {
+            float time_to_visible = wanted[it->first];
+
+            if (time_to_visible > latest_time)
+            {
+                latest = it;
+                latest_time = time_to_visible;
+            }
+        }
+
+        if (latest == resident.end()) break;
+
+        stats.resident_bytes -= latest->second.bytes;
+        resident.erase(latest);
+    }
+}
+
+void WorldStreamer::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        requests.clear();
+    }
+
+    jobs::wait(builds);
+
+    finished.clear();
+
+    for (ChunkBuild& build : ready)
+    {
+        for (Mesh& mesh : build.meshes) mesh.destroy_mesh();
+        if (build.upload) for (Mesh& mesh : build.upload->meshes) mesh.destroy_mesh();
+    }
+    ready.clear();
+
+    pending.clear();
+    resident.clear();
+
+    // Only after the chunks, their instance batches use these
+    for (Mesh& mesh : tree_meshes) mesh.destroy_mesh();
+    tree_meshes.clear();
+
+    if (tree_impostor) tree_impostor->destroy_impostor();
+    tree_impostor.reset();
+
+    stats = StreamingStats();
+}
+
+void WorldStreamer::set_upload_thread(UploadThread* uploads)
+{
+    this->uploads = uploads;
+}
+
+const StreamingStats& WorldStreamer::get_stats() const
+{
+    return stats;
+}
+
+Route& WorldStreamer::get_route()
+{
+    return route;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <vec3.hpp>
+
+#include "route.hpp"
+#include "node_arena.hpp"
+#include "mesh_registry.hpp"
+#include "image_registry.hpp"
+#include "foliage.hpp"
+#include "impostor.hpp"
+#include "jobs.hpp"
+#include "upload_thread.hpp"
+
+struct StreamingConfig
+{
+    RouteStyle route_style = ROUTE_SPLINE;
+    uint32_t tiles_per_chunk = 8;
+    uint32_t segments_per_chunk = 4;
+
+    // Chunks up to chunks_ahead past the player are always kept. Further ones are
+    // prefetched, up to max_chunks_ahead, once the player's speed along the road would
+    // bring them into view within prefetch_seconds.
+    uint32_t chunks_behind = 1;
+    uint32_t chunks_ahead = 2;
+    uint32_t max_chunks_ahead = 12;
+    float prefetch_seconds = 10.0f;
+
+    // Route distance at which a chunk counts as visible
+    float view_distance = 100.0f;
+
+    // Speed assumed when the player stands still or moves away, so chunks still get
+    // a time to visible that orders them by distance
+    float min_prefetch_speed = 1.0f;
+
+    // No further chunks are requested once this much geometry is resident
+    size_t max_resident_bytes = 256 * 1024 * 1024;
+
+    // Time the GL thread may spend per update uploading finished chunks
+    double upload_budget_ms = 2.0;
+
+    // Chunks built at the same time on the job system
+    uint32_t parallel_builds = 2;
+    uint32_t seed = 100;
+
+    FoliageConfig foliage;
+
+    // Start of the route in the space of the world scene
+    glm::vec3 origin = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 heading = glm::vec3(0.0f, 0.0f, -1.0f);
+};
+
+struct StreamingStats
+{
+    uint32_t player_chunk = 0;
+    float route_distance = 0.0f;
+    float route_speed = 0.0f;       // player speed along the road, negative when driving back
+
+    uint32_t resident_chunks = 0;
+    uint32_t pending_chunks = 0;    // requested, not attached yet
+    uint32_t ready_chunks = 0;      // built, waiting for or halfway through upload
+    size_t resident_bytes = 0;
+
+    double upload_ms = 0.0;         // spent uploading during the last update
+
+    // Chunks that came into view before they were attached, counted once per chunk
+    uint32_t misses = 0;
+    uint32_t missing_chunks = 0;    // visible right now but not attached
+};
+
+// Streams the road in chunks around the player. Jobs parse the tiles or
+// extrude the spline road, merge them per texture into chunk space, scatter the chunk's
+// foliage instances and decode new textures. The GL
+// thread only uploads the results, within a time budget per frame, or hands them to the
+// upload thread and only creates vertex arrays once they are visible. A chunk is
+// attached to the world scene once all of its meshes are on the GPU. Requests and
+// uploads are ordered by the estimated time until a chunk comes into view.
+class WorldStreamer
+{
+public:
+    WorldStreamer(Scene* world, Shader* shader, const FoliageShaders& foliage_shaders, const StreamingConfig& config);
+    ~WorldStreamer();
+
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator = (const WorldStreamer&) = delete;
+
+    // Call once per frame on the GL thread, with the player position and velocity in world space.
+    void update(const glm::dvec3& player_position, const glm::vec3& player_velocity);
+
+    // Waits for the build jobs and drops every chunk. Has to run while the GL context
+    // exists, and after the upload thread stopped.
+    void shutdown();
+
+    // Uploads whole chunks on `uploads` instead of the GL thread. Set before the first update.
+    void set_upload_thread(UploadThread* uploads);
+
+    const StreamingStats& get_stats() const;
+    Route& get_route();
+
+private:
+    // What the upload thread fills in for a chunk, the GL thread only reads it once it is visible
+    struct ChunkUpload
+    {
+        std::vector<ImageData> images;
+        std::vector<uint32_t> textures;
+        std::vector<Mesh> meshes;
+        bool has_meshes = false;
+        bool visible = false;
+    };
+
+    struct ChunkBuild
+    {
+        uint32_t index;
+        glm::vec3 origin;
+
+        // Merged per texture, in chunk space
+        std::vector<MeshData> batches;
+        std::vector<ImageData> images;
+        AABB bounds;
+        size_t bytes = 0;
+
+        // Over every batch, in chunk space
+        std::unique_ptr<TriangleBVH> collision;
+
+        std::vector<Instance> foliage;
+        AABB foliage_bounds;
+
+        // Upload progress on the GL thread
+        std::vector<Mesh> meshes;
+        size_t uploaded_images = 0;
+
+        // Set once the chunk went to the upload thread
+        std::shared_ptr<ChunkUpload> upload;
+    };
+
+    struct ChunkRequest
+    {
+        RouteChunk chunk;
+        std::vector<glm::vec3> nearby_centerline;
+        float time_to_visible;
+    };
+
+    struct ResidentChunk
+    {
+        std::unique_ptr<NodeArena> arena;
+        size_t bytes;
+    };
+
+    Scene* world;
+    Shader* shader;
+    FoliageShaders foliage_shaders;
+    StreamingConfig config;
+    Route route;
+    UploadThread* uploads = nullptr;
+
+    // Shared by the foliage of every chunk, created on the GL thread once the jobs
+    // decoded its textures
+    std::vector<Mesh> tree_meshes;
+    std::unique_ptr<Impostor> tree_impostor;
+    std::vector<AABB> tree_occluders;
+
+    // Jobs building chunks, each takes the most urgent request until none are left
+    JobCounter builds;
+
+    // Shared with the build jobs
+    std::mutex mutex;
+    bool stopping = false;
+    uint32_t running_builds = 0;
+    std::deque<ChunkRequest> requests;     // soonest visible first
+    std::deque<ChunkBuild> finished;
+    std::set<std::string> claimed_textures;
+    std::string worker_error;
+
+    // GL thread only
+    std::map<uint32_t, float> wanted;       // chunk index to time to visible
+    std::set<uint32_t> pending;
+    std::set<uint32_t> missed;
+    std::deque<ChunkBuild> ready;
+    std::map<uint32_t, ResidentChunk> resident;
+    StreamingStats stats;
+
+    void build_requests();
+    void start_builds();
+    ChunkBuild build_chunk(const RouteChunk& chunk, const std::vector<glm::vec3>& nearby_centerline);
+
+    float get_time_to_visible(const RouteChunk& chunk) const;
+    void select_chunks();
+    void count_misses();
+    void request_chunks();
+    void upload_ready();
+
+    // Returns false when the budget ran out before the chunk was complete.
+    bool upload_chunk(ChunkBuild& build, std::chrono::steady_clock::time_point start, bool& blocked);
+    bool upload_chunk_async(ChunkBuild& build, bool& blocked);
+    bool create_tree_prototype();
+    void attach_chunk(ChunkBuild& build);
+    void evict_over_budget();
+};